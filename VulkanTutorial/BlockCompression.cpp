@@ -0,0 +1,289 @@
+#include <VulkanTutorial/BlockCompression.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <execution>
+#include <limits>
+
+namespace
+{
+constexpr std::uint32_t BlockDimension = 4U;
+constexpr std::uint32_t BlockTexels    = BlockDimension * BlockDimension;
+constexpr std::uint32_t Bc1BlockSize   = 8U;
+
+using Rgb      = std::array<std::int32_t, 3>;
+using Bc1Block = std::array<std::byte, Bc1BlockSize>;
+
+[[nodiscard]] std::uint16_t To565(const Rgb& color)
+{
+	const auto scale = [](const std::int32_t value, const std::int32_t max) {
+		return static_cast<std::uint16_t>((value * max + 127) / 255);
+	};
+	return static_cast<std::uint16_t>(scale(color[0], 31) << 11U |
+	                                  scale(color[1], 63) << 5U |
+	                                  scale(color[2], 31));
+}
+
+[[nodiscard]] Rgb From565(const std::uint16_t color)
+{
+	const auto red   = static_cast<std::int32_t>(color >> 11U & 0x1FU);
+	const auto green = static_cast<std::int32_t>(color >> 5U & 0x3FU);
+	const auto blue  = static_cast<std::int32_t>(color & 0x1FU);
+	return Rgb{
+		red << 3 | red >> 2,
+		green << 2 | green >> 4,
+		blue << 3 | blue >> 2,
+	};
+}
+
+// Bounding box fit, the endpoints are the corners of the box inset by 1/16 of
+// its size. Much faster than a least squares fit and close enough for albedo
+[[nodiscard]] Bc1Block EncodeBc1Block(const std::array<Rgb, BlockTexels>& texels)
+{
+	Rgb minColor{ 255, 255, 255 };
+	Rgb maxColor{ 0, 0, 0 };
+	for (const Rgb& texel : texels)
+	{
+		for (std::size_t channel{ 0U }; channel < 3U; ++channel)
+		{
+			minColor[channel] = std::min(minColor[channel], texel[channel]);
+			maxColor[channel] = std::max(maxColor[channel], texel[channel]);
+		}
+	}
+	for (std::size_t channel{ 0U }; channel < 3U; ++channel)
+	{
+		const std::int32_t inset = (maxColor[channel] - minColor[channel]) >> 4;
+		minColor[channel] += inset;
+		maxColor[channel] -= inset;
+	}
+
+	// Every channel of maxColor is at least minColor, so color0 >= color1 and
+	// the block uses the 4 color mode unless both are the same
+	const std::uint16_t color0 = To565(maxColor);
+	const std::uint16_t color1 = To565(minColor);
+
+	std::uint32_t indices{ 0U };
+	if (color0 != color1)
+	{
+		const Rgb endpoint0 = From565(color0);
+		const Rgb endpoint1 = From565(color1);
+		std::array<Rgb, 4> palette{ endpoint0, endpoint1 };
+		for (std::size_t channel{ 0U }; channel < 3U; ++channel)
+		{
+			const std::int32_t first  = endpoint0[channel];
+			const std::int32_t second = endpoint1[channel];
+			palette[2][channel]       = (2 * first + second) / 3;
+			palette[3][channel]       = (first + 2 * second) / 3;
+		}
+
+		for (std::uint32_t i{ 0U }; i < BlockTexels; ++i)
+		{
+			std::uint32_t bestIndex{ 0U };
+			std::int32_t bestDistance = std::numeric_limits<std::int32_t>::max();
+			for (std::uint32_t index{ 0U }; index < palette.size(); ++index)
+			{
+				std::int32_t distance{ 0 };
+				for (std::size_t channel{ 0U }; channel < 3U; ++channel)
+				{
+					const std::int32_t difference =
+						texels[i][channel] - palette[index][channel];
+					distance += difference * difference;
+				}
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex    = index;
+				}
+			}
+			indices |= bestIndex << (2U * i);
+		}
+	}
+
+	// Little endian endpoints followed by 2 bit indices, first texel lowest
+	return Bc1Block{
+		static_cast<std::byte>(color0 & 0xFFU),
+		static_cast<std::byte>(color0 >> 8U),
+		static_cast<std::byte>(color1 & 0xFFU),
+		static_cast<std::byte>(color1 >> 8U),
+		static_cast<std::byte>(indices & 0xFFU),
+		static_cast<std::byte>(indices >> 8U & 0xFFU),
+		static_cast<std::byte>(indices >> 16U & 0xFFU),
+		static_cast<std::byte>(indices >> 24U),
+	};
+}
+
+void EncodeBc1Level(const std::span<const std::byte> texels,
+                    const vk::Extent2D extent,
+                    const std::span<std::byte> destination)
+{
+	const std::uint32_t blockColumns =
+		(extent.width + BlockDimension - 1U) / BlockDimension;
+	const std::uint32_t blockRows =
+		(extent.height + BlockDimension - 1U) / BlockDimension;
+	std::vector<Bc1Block> blocks(std::size_t{ blockColumns } * blockRows);
+	assert(destination.size() == blocks.size() * Bc1BlockSize);
+
+	const auto encodeBlock = [&](Bc1Block& block) {
+		const auto blockIndex = static_cast<std::uint32_t>(&block - blocks.data());
+		const std::uint32_t bx = blockIndex % blockColumns * BlockDimension;
+		const std::uint32_t by = blockIndex / blockColumns * BlockDimension;
+
+		// Blocks hanging over the edge repeat the last row and column
+		std::array<Rgb, BlockTexels> blockTexels{};
+		for (std::uint32_t y{ 0U }; y < BlockDimension; ++y)
+		{
+			for (std::uint32_t x{ 0U }; x < BlockDimension; ++x)
+			{
+				const std::uint32_t sourceX = std::min(bx + x, extent.width - 1U);
+				const std::uint32_t sourceY = std::min(by + y, extent.height - 1U);
+				const std::size_t offset =
+					(std::size_t{ sourceY } * extent.width + sourceX) * 4U;
+				for (std::size_t channel{ 0U }; channel < 3U; ++channel)
+				{
+					blockTexels[y * BlockDimension + x][channel] =
+						std::to_integer<std::int32_t>(texels[offset + channel]);
+				}
+			}
+		}
+		block = EncodeBc1Block(blockTexels);
+	};
+	std::for_each(std::execution::par, begin(blocks), end(blocks), encodeBlock);
+
+	std::ranges::copy(std::as_bytes(std::span{ blocks }), destination.data());
+}
+
+[[nodiscard]] float SrgbToLinear(const std::uint8_t value)
+{
+	static const std::array<float, 256> Table = [] {
+		std::array<float, 256> table{};
+		for (std::size_t i{ 0U }; i < table.size(); ++i)
+		{
+			const float encoded = static_cast<float>(i) / 255.F;
+			table.at(i)         = encoded <= 0.04045F
+			                          ? encoded / 12.92F
+			                          : std::pow((encoded + 0.055F) / 1.055F, 2.4F);
+		}
+		return table;
+	}();
+	return Table.at(value);
+}
+
+[[nodiscard]] std::uint8_t LinearToSrgb(const float value)
+{
+	const float encoded = value <= 0.0031308F
+	                          ? value * 12.92F
+	                          : 1.055F * std::pow(value, 1.F / 2.4F) - 0.055F;
+	return static_cast<std::uint8_t>(
+		std::clamp(encoded * 255.F + 0.5F, 0.F, 255.F));
+}
+
+// 2x2 box filter, averaged in linear space for sRGB textures
+[[nodiscard]] std::vector<std::byte> Downsample(
+	const std::span<const std::byte> texels,
+	const vk::Extent2D extent,
+	const vk::Extent2D halfExtent,
+	const bool srgb)
+{
+	const auto texelOffset = [](const std::uint32_t x,
+	                            const std::uint32_t y,
+	                            const std::uint32_t width) {
+		return (std::size_t{ y } * width + x) * 4U;
+	};
+	std::vector<std::byte> result(
+		texelOffset(0U, halfExtent.height, halfExtent.width));
+	std::vector<std::uint32_t> rows(halfExtent.height);
+	std::ranges::generate(rows, [row = 0U]() mutable { return row++; });
+
+	const auto downsampleRow = [&](const std::uint32_t y) {
+		for (std::uint32_t x{ 0U }; x < halfExtent.width; ++x)
+		{
+			for (std::size_t channel{ 0U }; channel < 4U; ++channel)
+			{
+				const bool linearize = srgb && channel < 3U;
+				float sum{ 0.F };
+				for (std::uint32_t sample{ 0U }; sample < 4U; ++sample)
+				{
+					const std::uint32_t sourceX =
+						std::min(x * 2U + sample % 2U, extent.width - 1U);
+					const std::uint32_t sourceY =
+						std::min(y * 2U + sample / 2U, extent.height - 1U);
+					const std::size_t offset =
+						texelOffset(sourceX, sourceY, extent.width) + channel;
+					const auto value =
+						std::to_integer<std::uint8_t>(texels[offset]);
+					sum += linearize ? SrgbToLinear(value)
+					                 : static_cast<float>(value) / 255.F;
+				}
+				const float average = sum / 4.F;
+				const std::uint8_t value =
+					linearize ? LinearToSrgb(average)
+					          : static_cast<std::uint8_t>(average * 255.F + 0.5F);
+				result[texelOffset(x, y, halfExtent.width) + channel] =
+					std::byte{ value };
+			}
+		}
+	};
+	std::for_each(std::execution::par, begin(rows), end(rows), downsampleRow);
+	return result;
+}
+} // namespace
+
+TextureData EncodeBc1(const TextureData& image)
+{
+	assert(image.Format == vk::Format::eR8G8B8A8Srgb ||
+	       image.Format == vk::Format::eR8G8B8A8Unorm);
+	const bool srgb = image.Format == vk::Format::eR8G8B8A8Srgb;
+
+	TextureData texture{
+		.Format = srgb ? vk::Format::eBc1RgbSrgbBlock
+		               : vk::Format::eBc1RgbUnormBlock,
+		.Extent = image.Extent,
+		.BlockExtent =
+			vk::Extent2D{ .width = BlockDimension, .height = BlockDimension },
+		.BlockSize   = Bc1BlockSize,
+		.LevelCount  = static_cast<std::uint32_t>(
+			std::bit_width(std::max(image.Extent.width, image.Extent.height))),
+	};
+	vk::DeviceSize size{ 0U };
+	for (std::uint32_t level{ 0U }; level < texture.LevelCount; ++level)
+	{
+		size += texture.GetLevelSize(level);
+	}
+	texture.Data.resize(size);
+
+	const std::span<const std::byte> baseLevel = image.GetLevel(0U);
+	std::vector<std::byte> levelTexels(begin(baseLevel), end(baseLevel));
+	vk::DeviceSize offset{ 0U };
+	for (std::uint32_t level{ 0U }; level < texture.LevelCount; ++level)
+	{
+		const vk::Extent2D levelExtent = GetMipExtent(image.Extent, level);
+		const vk::DeviceSize levelSize = texture.GetLevelSize(level);
+		EncodeBc1Level(levelTexels, levelExtent,
+		               std::span{ texture.Data }.subspan(offset, levelSize));
+		offset += levelSize;
+
+		if (level + 1U < texture.LevelCount)
+		{
+			levelTexels = Downsample(levelTexels, levelExtent,
+			                         GetMipExtent(image.Extent, level + 1U), srgb);
+		}
+	}
+	return texture;
+}
+
+bool IsOpaque(const TextureData& image)
+{
+	const std::span<const std::byte> texels = image.GetLevel(0U);
+	for (std::size_t offset{ 3U }; offset < texels.size(); offset += 4U)
+	{
+		if (texels[offset] != std::byte{ 0xFF })
+		{
+			return false;
+		}
+	}
+	return true;
+}
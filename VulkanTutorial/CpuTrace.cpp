@@ -0,0 +1,211 @@
+#include <VulkanTutorial/CpuTrace.h>
+
+#include <QSaveFile>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct TraceEvent
+{
+	const char* Name{ nullptr };
+	// Nanoseconds since the trace started
+	std::int64_t Start{};
+	std::int64_t Duration{};
+};
+
+// Atomic, so WriteChromeTrace can read a slot while its thread overwrites it.
+// Relaxed accesses are plain loads and stores on common hardware
+struct EventSlot
+{
+	std::atomic<const char*> Name{ nullptr };
+	std::atomic<std::int64_t> Start{};
+	std::atomic<std::int64_t> Duration{};
+};
+
+struct ThreadBuffer
+{
+	std::uint32_t ThreadId{};
+	// Guarded by the registry mutex
+	std::string Name;
+	std::array<EventSlot, CpuTrace::EventsPerThread> Events{};
+	// Only ever advanced by the owning thread
+	std::atomic<std::uint64_t> WriteCount{ 0U };
+};
+
+// Buffers outlive their threads, so events of finished workers are kept
+struct Registry
+{
+	std::mutex Mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> Buffers;
+};
+
+// Set before main, so no scope can start earlier
+const CpuTrace::Clock::time_point TraceEpoch = CpuTrace::Clock::now();
+
+Registry& GetRegistry()
+{
+	static Registry registry{};
+	return registry;
+}
+
+ThreadBuffer& GetThreadBuffer()
+{
+	// Registration is the only time a thread takes the lock
+	thread_local ThreadBuffer* const Buffer = [] {
+		Registry& registry = GetRegistry();
+		const std::scoped_lock lock{ registry.Mutex };
+		const std::unique_ptr<ThreadBuffer>& buffer =
+			registry.Buffers.emplace_back(std::make_unique<ThreadBuffer>());
+		buffer->ThreadId = static_cast<std::uint32_t>(registry.Buffers.size());
+		return buffer.get();
+	}();
+	return *Buffer;
+}
+
+// Names are string literals of our own, only quotes and backslashes matter
+std::string EscapeJson(const std::string_view text)
+{
+	std::string escaped{};
+	escaped.reserve(text.size());
+	for (const char character : text)
+	{
+		if (character == '"' || character == '\\')
+		{
+			escaped.push_back('\\');
+		}
+		escaped.push_back(character);
+	}
+	return escaped;
+}
+} // namespace
+
+void CpuTrace::Record(const char* const name,
+                      const Clock::time_point start,
+                      const Clock::time_point end) noexcept
+{
+	using std::chrono::duration_cast;
+	using std::chrono::nanoseconds;
+
+	ThreadBuffer& buffer = GetThreadBuffer();
+	const std::uint64_t writeCount =
+		buffer.WriteCount.load(std::memory_order_relaxed);
+
+	// A reader that sees any of the slot's new values also sees this count, so
+	// it knows the slot may have been overwritten
+	std::atomic_thread_fence(std::memory_order_release);
+	EventSlot& slot = buffer.Events.at(writeCount % EventsPerThread);
+	slot.Name.store(name, std::memory_order_relaxed);
+	slot.Start.store(duration_cast<nanoseconds>(start - TraceEpoch).count(),
+	                 std::memory_order_relaxed);
+	slot.Duration.store(duration_cast<nanoseconds>(end - start).count(),
+	                    std::memory_order_relaxed);
+	// Publishes the event to WriteChromeTrace
+	buffer.WriteCount.store(writeCount + 1U, std::memory_order_release);
+}
+
+void CpuTrace::SetThreadName(const char* const name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	const std::scoped_lock lock{ GetRegistry().Mutex };
+	buffer.Name = name;
+}
+
+void CpuTrace::WriteChromeTrace(const std::filesystem::path& path)
+{
+	constexpr double NanosecondsPerMicrosecond = 1000.0;
+
+	fmt::memory_buffer json{};
+	fmt::format_to(std::back_inserter(json), "{{\"traceEvents\":[");
+
+	bool first = true;
+	const auto appendSeparator = [&json, &first] {
+		if (!first)
+		{
+			fmt::format_to(std::back_inserter(json), ",");
+		}
+		first = false;
+	};
+
+	Registry& registry = GetRegistry();
+	{
+		const std::scoped_lock lock{ registry.Mutex };
+		for (const std::unique_ptr<ThreadBuffer>& buffer : registry.Buffers)
+		{
+			if (!buffer->Name.empty())
+			{
+				appendSeparator();
+				fmt::format_to(std::back_inserter(json),
+				               "\n{{\"name\":\"thread_name\",\"ph\":\"M\","
+				               "\"pid\":1,\"tid\":{},"
+				               "\"args\":{{\"name\":\"{}\"}}}}",
+				               buffer->ThreadId, EscapeJson(buffer->Name));
+			}
+
+			const std::uint64_t writeCount =
+				buffer->WriteCount.load(std::memory_order_acquire);
+			const std::uint64_t firstEvent =
+				writeCount > EventsPerThread ? writeCount - EventsPerThread : 0U;
+			std::vector<TraceEvent> events{};
+			events.reserve(static_cast<std::size_t>(writeCount - firstEvent));
+			for (std::uint64_t i{ firstEvent }; i < writeCount; ++i)
+			{
+				const EventSlot& slot = buffer->Events.at(i % EventsPerThread);
+				events.push_back(TraceEvent{
+					.Name     = slot.Name.load(std::memory_order_relaxed),
+					.Start    = slot.Start.load(std::memory_order_relaxed),
+					.Duration = slot.Duration.load(std::memory_order_relaxed),
+				});
+			}
+			// Threads still recording may have started overwriting the oldest
+			// events while they were copied, those are skipped
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const std::uint64_t latestCount =
+				buffer->WriteCount.load(std::memory_order_relaxed);
+			const std::uint64_t firstIntact =
+				latestCount >= firstEvent + EventsPerThread
+					? latestCount - EventsPerThread + 1U
+					: firstEvent;
+			for (std::uint64_t i{ firstIntact }; i < writeCount; ++i)
+			{
+				const TraceEvent& event = events.at(i - firstEvent);
+				const double start =
+					static_cast<double>(event.Start) / NanosecondsPerMicrosecond;
+				const double duration =
+					static_cast<double>(event.Duration) / NanosecondsPerMicrosecond;
+				appendSeparator();
+				fmt::format_to(std::back_inserter(json),
+				               "\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,"
+				               "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				               EscapeJson(event.Name), buffer->ThreadId, start,
+				               duration);
+			}
+		}
+	}
+	fmt::format_to(std::back_inserter(json), "\n],\"displayTimeUnit\":\"ms\"}}\n");
+
+	QSaveFile file{ QString::fromStdString(path.string()) };
+	if (!file.open(QIODevice::OpenModeFlag::WriteOnly))
+	{
+		throw std::runtime_error{ fmt::format("Failed to open {}: {}",
+		                                      path.string(),
+		                                      file.errorString().toStdString()) };
+	}
+	file.write(json.data(), static_cast<qint64>(json.size()));
+	if (!file.commit())
+	{
+		throw std::runtime_error{ fmt::format("Failed to write {}: {}",
+		                                      path.string(),
+		                                      file.errorString().toStdString()) };
+	}
+}
@@ -0,0 +1,321 @@
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+
+#include <fmt/core.h>
+
+namespace
+{
+[[nodiscard]] constexpr vk::DeviceSize AlignUp(const vk::DeviceSize value,
+                                               const vk::DeviceSize alignment)
+{
+	assert(std::has_single_bit(alignment));
+	return (value + alignment - 1U) & ~(alignment - 1U);
+}
+} // namespace
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(
+	const vk::Device device,
+	const vk::PhysicalDevice physicalDevice,
+	const vk::DeviceSize blockSize)
+	: m_Device{ device }
+	, m_PhysicalDevice{ physicalDevice }
+	, m_MemoryProperties{ physicalDevice.getMemoryProperties() }
+	, m_BlockSize{ blockSize }
+{
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator() noexcept
+{
+	// Whatever is still alive at this point has leaked, but the blocks
+	// themselves must still go back to the driver
+	for (std::array<MemoryPool, 2>& pools : m_Pools)
+	{
+		for (MemoryPool& pool : pools)
+		{
+			for (const MemoryBlock& block : pool.Blocks)
+			{
+				assert(block.AllocationCount == 0U);
+				m_Device.free(block.Memory);
+			}
+		}
+	}
+	assert(m_DedicatedAllocationCount == 0U);
+}
+
+DeviceMemoryAllocator::MemoryPool& DeviceMemoryAllocator::GetPool(
+	const std::uint32_t memoryTypeIndex,
+	const ResourceTiling tiling)
+{
+	return m_Pools.at(memoryTypeIndex).at(static_cast<std::size_t>(tiling));
+}
+
+vk::DeviceMemory DeviceMemoryAllocator::AllocateDeviceMemory(
+	const vk::DeviceSize size,
+	const std::uint32_t memoryTypeIndex,
+	void** const mappedData)
+{
+	const vk::DeviceMemory memory = m_Device.allocateMemory(vk::MemoryAllocateInfo{
+		.allocationSize  = size,
+		.memoryTypeIndex = memoryTypeIndex,
+	});
+
+	*mappedData = nullptr;
+	const vk::MemoryPropertyFlags propertyFlags =
+		m_MemoryProperties.memoryTypes.at(memoryTypeIndex).propertyFlags;
+	if (propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+	{
+		// Persistent mapping, a memory object can only be mapped once so
+		// every sub-allocation shares this pointer
+		*mappedData = m_Device.mapMemory(memory, vk::DeviceSize{ 0 }, VK_WHOLE_SIZE,
+		                                 vk::MemoryMapFlags{});
+	}
+	return memory;
+}
+
+bool DeviceMemoryAllocator::TryAllocateFromBlock(
+	MemoryBlock& block,
+	const vk::MemoryRequirements& memoryRequirements,
+	vk::DeviceSize& outOffset)
+{
+	// First fit, blocks are small enough for a linear scan to not matter
+	for (auto it = begin(block.FreeRanges); it != end(block.FreeRanges); ++it)
+	{
+		const vk::DeviceSize alignedOffset =
+			AlignUp(it->Offset, memoryRequirements.alignment);
+		const vk::DeviceSize padding = alignedOffset - it->Offset;
+		if (it->Size < padding + memoryRequirements.size)
+		{
+			continue;
+		}
+
+		const FreeRange tail{
+			.Offset = alignedOffset + memoryRequirements.size,
+			.Size   = it->Size - padding - memoryRequirements.size,
+		};
+		// Alignment padding stays in the free list so it can be merged back
+		if (padding > 0U)
+		{
+			it->Size = padding;
+			if (tail.Size > 0U)
+			{
+				block.FreeRanges.insert(std::next(it), tail);
+			}
+		}
+		else if (tail.Size > 0U)
+		{
+			*it = tail;
+		}
+		else
+		{
+			block.FreeRanges.erase(it);
+		}
+
+		++block.AllocationCount;
+		outOffset = alignedOffset;
+		return true;
+	}
+	return false;
+}
+
+DeviceAllocation DeviceMemoryAllocator::Allocate(
+	const vk::MemoryRequirements& memoryRequirements,
+	const vk::MemoryPropertyFlags memoryFlags,
+	const ResourceTiling tiling)
+{
+	const std::uint32_t memoryTypeIndex = FindMemoryType(
+		m_PhysicalDevice, memoryFlags, memoryRequirements.memoryTypeBits);
+
+	const std::scoped_lock lock{ m_Mutex };
+
+	// Big resources would only fragment the blocks, give them their own memory
+	if (memoryRequirements.size > m_BlockSize / 2U)
+	{
+		void* mappedData{ nullptr };
+		const vk::DeviceMemory memory = AllocateDeviceMemory(
+			memoryRequirements.size, memoryTypeIndex, &mappedData);
+		++m_DedicatedAllocationCount;
+		m_DedicatedBytes += memoryRequirements.size;
+
+		return DeviceAllocation{
+			.Memory          = memory,
+			.Offset          = vk::DeviceSize{ 0 },
+			.Size            = memoryRequirements.size,
+			.MappedData      = mappedData,
+			.MemoryTypeIndex = memoryTypeIndex,
+			.BlockIndex      = DeviceAllocation::DedicatedBlock,
+			.Tiling          = tiling,
+		};
+	}
+
+	MemoryPool& pool = GetPool(memoryTypeIndex, tiling);
+
+	const auto makeAllocation = [&](const MemoryBlock& block,
+	                                const std::size_t blockIndex,
+	                                const vk::DeviceSize offset) {
+		return DeviceAllocation{
+			.Memory = block.Memory,
+			.Offset = offset,
+			.Size   = memoryRequirements.size,
+			.MappedData =
+				block.MappedData == nullptr
+					? nullptr
+					: static_cast<void*>(static_cast<std::byte*>(block.MappedData) +
+			                             offset),
+			.MemoryTypeIndex = memoryTypeIndex,
+			.BlockIndex      = static_cast<std::uint32_t>(blockIndex),
+			.Tiling          = tiling,
+		};
+	};
+
+	vk::DeviceSize offset{};
+	for (std::size_t i{ 0U }; i < pool.Blocks.size(); ++i)
+	{
+		MemoryBlock& block = pool.Blocks[i];
+		if (block.Memory && TryAllocateFromBlock(block, memoryRequirements, offset))
+		{
+			return makeAllocation(block, i, offset);
+		}
+	}
+
+	// Re-use a slot of a previously released block before growing the vector,
+	// block indices of live allocations have to stay stable
+	auto freeSlot = std::ranges::find_if(
+		pool.Blocks, [](const MemoryBlock& block) { return !block.Memory; });
+	if (freeSlot == end(pool.Blocks))
+	{
+		freeSlot = pool.Blocks.insert(end(pool.Blocks), MemoryBlock{});
+	}
+
+	MemoryBlock& newBlock = *freeSlot;
+	newBlock.Memory =
+		AllocateDeviceMemory(m_BlockSize, memoryTypeIndex, &newBlock.MappedData);
+	newBlock.Size            = m_BlockSize;
+	newBlock.AllocationCount = 0U;
+	newBlock.FreeRanges      = { FreeRange{ .Offset = 0U, .Size = m_BlockSize } };
+
+	[[maybe_unused]] const bool allocated =
+		TryAllocateFromBlock(newBlock, memoryRequirements, offset);
+	assert(allocated);
+
+	const auto blockIndex =
+		static_cast<std::size_t>(std::distance(begin(pool.Blocks), freeSlot));
+	return makeAllocation(newBlock, blockIndex, offset);
+}
+
+void DeviceMemoryAllocator::Free(const DeviceAllocation& allocation) noexcept
+{
+	if (!allocation.Memory)
+	{
+		return;
+	}
+
+	const std::scoped_lock lock{ m_Mutex };
+
+	if (allocation.BlockIndex == DeviceAllocation::DedicatedBlock)
+	{
+		m_Device.free(allocation.Memory);
+		--m_DedicatedAllocationCount;
+		m_DedicatedBytes -= allocation.Size;
+		return;
+	}
+
+	MemoryPool& pool   = GetPool(allocation.MemoryTypeIndex, allocation.Tiling);
+	MemoryBlock& block = pool.Blocks[allocation.BlockIndex];
+	assert(block.Memory == allocation.Memory);
+
+	std::vector<FreeRange>& ranges = block.FreeRanges;
+	const auto next                = std::ranges::lower_bound(
+        ranges, allocation.Offset, std::less{}, &FreeRange::Offset);
+	auto inserted = ranges.insert(
+		next, FreeRange{ .Offset = allocation.Offset, .Size = allocation.Size });
+
+	// Coalesce with the following range, then with the preceding one
+	if (const auto following = std::next(inserted);
+	    following != end(ranges) &&
+	    inserted->Offset + inserted->Size == following->Offset)
+	{
+		inserted->Size += following->Size;
+		inserted = std::prev(ranges.erase(following));
+	}
+	if (inserted != begin(ranges))
+	{
+		if (const auto preceding = std::prev(inserted);
+		    preceding->Offset + preceding->Size == inserted->Offset)
+		{
+			preceding->Size += inserted->Size;
+			ranges.erase(inserted);
+		}
+	}
+
+	--block.AllocationCount;
+	if (block.AllocationCount > 0U)
+	{
+		return;
+	}
+
+	// Keep a single empty block around per pool to avoid allocation churn when
+	// an asset gets reloaded, anything past that goes back to the driver
+	const auto emptyBlocks = std::ranges::count_if(pool.Blocks, [](const auto& b) {
+		return b.Memory && b.AllocationCount == 0U;
+	});
+	if (emptyBlocks > 1)
+	{
+		m_Device.free(block.Memory);
+		block = MemoryBlock{};
+	}
+}
+
+DeviceAllocatorStatistics DeviceMemoryAllocator::GetStatistics() const
+{
+	const std::scoped_lock lock{ m_Mutex };
+
+	DeviceAllocatorStatistics statistics{
+		.DedicatedAllocationCount = m_DedicatedAllocationCount,
+		.ReservedBytes            = m_DedicatedBytes,
+		.UsedBytes                = m_DedicatedBytes,
+	};
+	for (const std::array<MemoryPool, 2>& pools : m_Pools)
+	{
+		for (const MemoryPool& pool : pools)
+		{
+			for (const MemoryBlock& block : pool.Blocks)
+			{
+				if (!block.Memory)
+				{
+					continue;
+				}
+
+				vk::DeviceSize freeBytes{};
+				for (const FreeRange& range : block.FreeRanges)
+				{
+					freeBytes += range.Size;
+					statistics.LargestFreeRange =
+						std::max(statistics.LargestFreeRange, range.Size);
+				}
+
+				++statistics.BlockCount;
+				statistics.SubAllocationCount += block.AllocationCount;
+				statistics.ReservedBytes += block.Size;
+				statistics.UsedBytes += block.Size - freeBytes;
+			}
+		}
+	}
+	return statistics;
+}
+
+void DeviceMemoryAllocator::PrintStatistics() const
+{
+	const DeviceAllocatorStatistics statistics = GetStatistics();
+	fmt::print("DeviceMemoryAllocator: {} blocks + {} dedicated, "
+	           "{} sub-allocations, {}/{} bytes used, "
+	           "largest free range {} bytes\n",
+	           statistics.BlockCount, statistics.DedicatedAllocationCount,
+	           statistics.SubAllocationCount, statistics.UsedBytes,
+	           statistics.ReservedBytes, statistics.LargestFreeRange);
+}
@@ -0,0 +1,24 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/FramePacing.h>
+
+#include <thread>
+
+FrameLimiter::FrameLimiter(const std::uint32_t frameRate)
+	: m_Interval{ std::chrono::duration_cast<Clock::duration>(
+		  std::chrono::duration<double>{ 1.0 / static_cast<double>(frameRate) }) }
+{
+}
+
+void FrameLimiter::Wait()
+{
+	CPU_TRACE_SCOPE("FrameLimiter");
+	const Clock::time_point now = Clock::now();
+	// Fell behind, the missed frames aren't caught up with a burst
+	if (m_NextFrame < now)
+	{
+		m_NextFrame = now + m_Interval;
+		return;
+	}
+	std::this_thread::sleep_until(m_NextFrame);
+	m_NextFrame += m_Interval;
+}
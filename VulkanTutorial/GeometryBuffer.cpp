@@ -0,0 +1,198 @@
+#include <VulkanTutorial/GeometryBuffer.h>
+#include <VulkanTutorial/Vertex.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+GeometryBuffer::GeometryBuffer(const vk::Device device,
+                               DeviceMemoryAllocator& allocator,
+                               UploadContext& uploadContext,
+                               const std::uint32_t vertexCapacity,
+                               const std::uint32_t indexCapacity)
+	: m_Device{ device }
+	, m_Allocator{ &allocator }
+	, m_UploadContext{ &uploadContext }
+	, m_Vertices{ CreateSharedBuffer(vertexCapacity, sizeof(Vertex),
+	                                 vk::BufferUsageFlagBits::eVertexBuffer) }
+	, m_Indices{ CreateSharedBuffer(indexCapacity, sizeof(std::uint32_t),
+	                                vk::BufferUsageFlagBits::eIndexBuffer) }
+{
+}
+
+GeometryBuffer::~GeometryBuffer() noexcept
+{
+	DestroySharedBuffer(m_Indices);
+	DestroySharedBuffer(m_Vertices);
+}
+
+GeometryBuffer::SharedBuffer GeometryBuffer::CreateSharedBuffer(
+	const std::uint32_t capacity,
+	const vk::DeviceSize elementSize,
+	const vk::BufferUsageFlags usage) const
+{
+	SharedBuffer sharedBuffer{ .Capacity = capacity };
+	// Compaction copies from the old buffer into the new one
+	std::tie(sharedBuffer.Buffer, sharedBuffer.Allocation) = CreateDeviceBuffer(
+		vk::DeviceSize{ capacity } * elementSize,
+		usage | vk::BufferUsageFlagBits::eTransferSrc |
+			vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
+		m_Device, *m_Allocator);
+	return sharedBuffer;
+}
+
+void GeometryBuffer::DestroySharedBuffer(SharedBuffer& sharedBuffer) noexcept
+{
+	if (sharedBuffer.Buffer)
+	{
+		m_Device.destroy(sharedBuffer.Buffer);
+		m_Allocator->Free(sharedBuffer.Allocation);
+	}
+	sharedBuffer = SharedBuffer{};
+}
+
+GeometryHandle GeometryBuffer::Allocate(const std::uint32_t vertexCount,
+                                        const std::uint32_t indexCount)
+{
+	const bool verticesFit = m_Vertices.Used + vertexCount <= m_Vertices.Capacity;
+	const bool indicesFit  = m_Indices.Used + indexCount <= m_Indices.Capacity;
+	if (!verticesFit || !indicesFit)
+	{
+		// Compacting alone might be enough, otherwise grow to the next power of 2
+		Reallocate(std::max(m_Vertices.Capacity,
+		                    std::bit_ceil(m_Vertices.Live + vertexCount)),
+		           std::max(m_Indices.Capacity,
+		                    std::bit_ceil(m_Indices.Live + indexCount)));
+	}
+
+	const GeometryRange range{
+		.FirstVertex = m_Vertices.Used,
+		.VertexCount = vertexCount,
+		.FirstIndex  = m_Indices.Used,
+		.IndexCount  = indexCount,
+	};
+	m_Vertices.Used += vertexCount;
+	m_Vertices.Live += vertexCount;
+	m_Indices.Used += indexCount;
+	m_Indices.Live += indexCount;
+
+	if (!m_FreeHandles.empty())
+	{
+		const GeometryHandle handle = m_FreeHandles.back();
+		m_FreeHandles.pop_back();
+		m_Ranges.at(handle) = range;
+		return handle;
+	}
+	m_Ranges.emplace_back(range);
+	return static_cast<GeometryHandle>(m_Ranges.size() - 1U);
+}
+
+void GeometryBuffer::Free(const GeometryHandle handle)
+{
+	std::optional<GeometryRange>& range = m_Ranges.at(handle);
+	assert(range.has_value());
+
+	m_Vertices.Live -= range->VertexCount;
+	m_Indices.Live -= range->IndexCount;
+	range.reset();
+	m_FreeHandles.push_back(handle);
+
+	const bool fragmented = m_Vertices.Live < m_Vertices.Used / 2U ||
+	                        m_Indices.Live < m_Indices.Used / 2U;
+	if (fragmented)
+	{
+		Reallocate(m_Vertices.Capacity, m_Indices.Capacity);
+	}
+}
+
+const GeometryRange& GeometryBuffer::GetRange(const GeometryHandle handle) const
+{
+	const std::optional<GeometryRange>& range = m_Ranges.at(handle);
+	assert(range.has_value());
+	return *range;
+}
+
+void GeometryBuffer::Bind(const vk::CommandBuffer commandBuffer) const
+{
+	constexpr vk::DeviceSize Offset{ 0 };
+	commandBuffer.bindVertexBuffers(Vertex::Binding, { m_Vertices.Buffer },
+	                                { Offset });
+	commandBuffer.bindIndexBuffer(m_Indices.Buffer, 0, vk::IndexType::eUint32);
+}
+
+void GeometryBuffer::Reallocate(const std::uint32_t vertexCapacity,
+                                const std::uint32_t indexCapacity)
+{
+	// Pending uploads still target the old buffers and frames in flight still
+	// draw from them
+	m_UploadContext->Flush();
+	m_Device.waitIdle();
+
+	SharedBuffer vertices = CreateSharedBuffer(
+		vertexCapacity, sizeof(Vertex), vk::BufferUsageFlagBits::eVertexBuffer);
+	SharedBuffer indices  = CreateSharedBuffer(
+		indexCapacity, sizeof(std::uint32_t),
+		vk::BufferUsageFlagBits::eIndexBuffer);
+
+	std::vector<vk::BufferCopy> vertexCopies{};
+	std::vector<vk::BufferCopy> indexCopies{};
+	for (std::optional<GeometryRange>& range : m_Ranges)
+	{
+		if (!range.has_value())
+		{
+			continue;
+		}
+
+		if (range->VertexCount > 0U)
+		{
+			vertexCopies.push_back(vk::BufferCopy{
+				.srcOffset = vk::DeviceSize{ range->FirstVertex } * sizeof(Vertex),
+				.dstOffset = vk::DeviceSize{ vertices.Used } * sizeof(Vertex),
+				.size      = vk::DeviceSize{ range->VertexCount } * sizeof(Vertex),
+			});
+		}
+		if (range->IndexCount > 0U)
+		{
+			constexpr vk::DeviceSize IndexSize = sizeof(std::uint32_t);
+			indexCopies.push_back(vk::BufferCopy{
+				.srcOffset = vk::DeviceSize{ range->FirstIndex } * IndexSize,
+				.dstOffset = vk::DeviceSize{ indices.Used } * IndexSize,
+				.size      = vk::DeviceSize{ range->IndexCount } * IndexSize,
+			});
+		}
+
+		// Indices are relative to FirstVertex, moving the range keeps them valid
+		range->FirstVertex = vertices.Used;
+		range->FirstIndex  = indices.Used;
+		vertices.Used += range->VertexCount;
+		indices.Used += range->IndexCount;
+	}
+	vertices.Live = vertices.Used;
+	indices.Live  = indices.Used;
+
+	// Stays on the graphics queue, which owns everything uploaded to the old
+	// buffers by now
+	const vk::CommandBuffer commandBuffer = m_UploadContext->GetCommandBuffer();
+	if (!vertexCopies.empty())
+	{
+		commandBuffer.copyBuffer(m_Vertices.Buffer, vertices.Buffer, vertexCopies);
+		BufferUploadBarrier(commandBuffer, vertices.Buffer,
+		                    vk::PipelineStageFlagBits::eVertexInput,
+		                    vk::AccessFlagBits::eVertexAttributeRead);
+	}
+	if (!indexCopies.empty())
+	{
+		commandBuffer.copyBuffer(m_Indices.Buffer, indices.Buffer, indexCopies);
+		BufferUploadBarrier(commandBuffer, indices.Buffer,
+		                    vk::PipelineStageFlagBits::eVertexInput,
+		                    vk::AccessFlagBits::eIndexRead);
+	}
+	m_UploadContext->Wait(m_UploadContext->Submit());
+
+	DestroySharedBuffer(m_Vertices);
+	DestroySharedBuffer(m_Indices);
+	m_Vertices = vertices;
+	m_Indices  = indices;
+}
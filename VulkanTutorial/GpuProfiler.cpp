@@ -0,0 +1,256 @@
+#include <VulkanTutorial/GpuProfiler.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace
+{
+constexpr std::uint32_t QueriesPerScope = 2U;
+constexpr std::uint32_t QueriesPerRange =
+	GpuProfiler::MaxScopesPerRange * QueriesPerScope;
+constexpr double NanosecondsPerMillisecond = 1'000'000.0;
+} // namespace
+
+GpuProfiler::GpuProfiler(const vk::Device device,
+                         const vk::PhysicalDevice physicalDevice,
+                         const std::uint32_t queueFamilyIndex)
+	: m_Device{ device }
+{
+	const std::uint32_t validBits =
+		physicalDevice.getQueueFamilyProperties()
+			.at(queueFamilyIndex)
+			.timestampValidBits;
+	if (validBits == 0U)
+	{
+		fmt::println(stderr, "GpuProfiler: queue family {} has no timestamps",
+		             queueFamilyIndex);
+		return;
+	}
+
+	m_TimestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+	m_TimestampMask   = validBits >= 64U
+	                        ? std::numeric_limits<std::uint64_t>::max()
+	                        : (std::uint64_t{ 1U } << validBits) - 1U;
+	m_QueryPool = m_Device.createQueryPool(vk::QueryPoolCreateInfo{
+		.queryType  = vk::QueryType::eTimestamp,
+		.queryCount = MaxRanges * QueriesPerRange,
+	});
+
+	m_FreeRanges.resize(MaxRanges);
+	// Handed out from the back, lowest index first
+	std::iota(m_FreeRanges.rbegin(), m_FreeRanges.rend(), 0U);
+}
+
+GpuProfiler::~GpuProfiler() noexcept
+{
+	m_Device.destroy(m_QueryPool);
+}
+
+GpuProfileRange GpuProfiler::BeginRange(const vk::CommandBuffer commandBuffer)
+{
+	if (m_FreeRanges.empty())
+	{
+		return GpuProfileRange{};
+	}
+
+	const std::uint32_t index = m_FreeRanges.back();
+	m_FreeRanges.pop_back();
+	m_Ranges.at(index).Histories.clear();
+
+	commandBuffer.resetQueryPool(m_QueryPool, index * QueriesPerRange,
+	                             QueriesPerRange);
+	return GpuProfileRange{
+		.Profiler      = this,
+		.CommandBuffer = commandBuffer,
+		.Index         = index,
+	};
+}
+
+std::optional<double> GpuProfiler::ResolveRange(
+	const GpuProfileRange& range) noexcept
+{
+	if (range.Profiler == nullptr)
+	{
+		return std::nullopt;
+	}
+	assert(range.Profiler == this);
+
+	const std::vector<std::uint32_t>& histories =
+		m_Ranges.at(range.Index).Histories;
+	const auto queryCount =
+		static_cast<std::uint32_t>(histories.size()) * QueriesPerScope;
+	std::array<std::uint64_t, QueriesPerRange> timestamps{};
+	// The command buffer has finished, so the results have to be there already.
+	// Not waiting also keeps a lost device from hanging here
+	const bool available =
+		queryCount > 0U &&
+		m_Device.getQueryPoolResults(
+			m_QueryPool, range.Index * QueriesPerRange, queryCount,
+			queryCount * sizeof(std::uint64_t), timestamps.data(),
+			sizeof(std::uint64_t),
+			vk::QueryResultFlags{ vk::QueryResultFlagBits::e64 }) ==
+			vk::Result::eSuccess;
+	std::optional<double> rangeMilliseconds{};
+	if (available)
+	{
+		// Scopes begin in order, the first one starts the range
+		std::uint64_t rangeTicks{ 0U };
+		// Scopes with the same name are added up, a range only has a few names
+		std::vector<std::pair<std::uint32_t, double>> totals{};
+		for (std::size_t i{ 0U }; i < histories.size(); ++i)
+		{
+			const std::uint64_t ticks =
+				(timestamps.at(i * QueriesPerScope + 1U) -
+				 timestamps.at(i * QueriesPerScope)) &
+				m_TimestampMask;
+			const double milliseconds = static_cast<double>(ticks) *
+			                            m_TimestampPeriod /
+			                            NanosecondsPerMillisecond;
+			const std::uint64_t sinceRangeStart =
+				(timestamps.at(i * QueriesPerScope + 1U) - timestamps.front()) &
+				m_TimestampMask;
+			rangeTicks = std::max(rangeTicks, sinceRangeStart);
+
+			const auto total = std::ranges::find(
+				totals, histories.at(i), &std::pair<std::uint32_t, double>::first);
+			if (total == totals.end())
+			{
+				totals.emplace_back(histories.at(i), milliseconds);
+			}
+			else
+			{
+				total->second += milliseconds;
+			}
+		}
+		for (const auto& [history, milliseconds] : totals)
+		{
+			AddSample(history, milliseconds);
+		}
+		rangeMilliseconds = static_cast<double>(rangeTicks) * m_TimestampPeriod /
+		                    NanosecondsPerMillisecond;
+	}
+
+	m_FreeRanges.push_back(range.Index);
+	return rangeMilliseconds;
+}
+
+std::uint32_t GpuProfiler::BeginScope(const GpuProfileRange& range,
+                                      const std::string_view name)
+{
+	std::vector<std::uint32_t>& histories = m_Ranges.at(range.Index).Histories;
+	if (histories.size() == MaxScopesPerRange)
+	{
+		if (!m_ReportedFullRange)
+		{
+			fmt::println(stderr,
+			             "GpuProfiler: a range has more than {} scopes, the rest "
+			             "aren't measured",
+			             MaxScopesPerRange);
+			m_ReportedFullRange = true;
+		}
+		return NoScope;
+	}
+
+	auto found = m_HistoryIndices.find(name);
+	if (found == m_HistoryIndices.end())
+	{
+		const auto index = static_cast<std::uint32_t>(m_Histories.size());
+		found = m_HistoryIndices.emplace(std::string{ name }, index).first;
+		m_Histories.push_back(ScopeHistory{ .Name = found->first });
+	}
+
+	const auto scope = static_cast<std::uint32_t>(histories.size());
+	histories.push_back(found->second);
+	range.CommandBuffer.writeTimestamp(
+		vk::PipelineStageFlagBits::eTopOfPipe, m_QueryPool,
+		range.Index * QueriesPerRange + scope * QueriesPerScope);
+	return scope;
+}
+
+void GpuProfiler::EndScope(const GpuProfileRange& range,
+                           const std::uint32_t scope) noexcept
+{
+	if (scope == NoScope)
+	{
+		return;
+	}
+	range.CommandBuffer.writeTimestamp(
+		vk::PipelineStageFlagBits::eBottomOfPipe, m_QueryPool,
+		range.Index * QueriesPerRange + scope * QueriesPerScope + 1U);
+}
+
+void GpuProfiler::AddSample(const std::uint32_t history, const double milliseconds)
+{
+	ScopeHistory& scopeHistory = m_Histories.at(history);
+	if (scopeHistory.Samples.size() < HistorySize)
+	{
+		scopeHistory.Samples.push_back(milliseconds);
+		return;
+	}
+	scopeHistory.Samples.at(scopeHistory.NextSample) = milliseconds;
+	scopeHistory.NextSample = (scopeHistory.NextSample + 1U) % HistorySize;
+}
+
+std::vector<GpuScopeStatistics> GpuProfiler::GetStatistics() const
+{
+	std::vector<GpuScopeStatistics> statistics{};
+	statistics.reserve(m_Histories.size());
+	for (const ScopeHistory& history : m_Histories)
+	{
+		if (history.Samples.empty())
+		{
+			continue;
+		}
+
+		std::vector<double> samples = history.Samples;
+		const auto sampleCount      = static_cast<std::ptrdiff_t>(samples.size());
+		// Nearest rank, 99% of the samples are at most this one
+		const auto percentile =
+			samples.begin() + (sampleCount * 99 + 99) / 100 - 1;
+		std::ranges::nth_element(samples, percentile);
+		const double total = std::accumulate(samples.begin(), samples.end(), 0.0);
+
+		statistics.push_back(GpuScopeStatistics{
+			.Name         = history.Name,
+			.SampleCount  = samples.size(),
+			.Minimum      = std::ranges::min(samples),
+			.Average      = total / static_cast<double>(sampleCount),
+			.Percentile99 = *percentile,
+		});
+	}
+	return statistics;
+}
+
+void GpuProfiler::PrintStatistics() const
+{
+	for (const GpuScopeStatistics& scope : GetStatistics())
+	{
+		fmt::print("GpuProfiler: {:<24} min {:.3f} ms, avg {:.3f} ms, "
+		           "p99 {:.3f} ms over {} samples\n",
+		           scope.Name, scope.Minimum, scope.Average, scope.Percentile99,
+		           scope.SampleCount);
+	}
+}
+
+GpuProfileScope::GpuProfileScope(const GpuProfileRange& range,
+                                 const std::string_view name)
+	: m_Range{ range }
+{
+	if (m_Range.Profiler != nullptr)
+	{
+		m_Scope = m_Range.Profiler->BeginScope(m_Range, name);
+	}
+}
+
+GpuProfileScope::~GpuProfileScope() noexcept
+{
+	if (m_Range.Profiler != nullptr)
+	{
+		m_Range.Profiler->EndScope(m_Range, m_Scope);
+	}
+}
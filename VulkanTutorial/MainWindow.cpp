@@ -1,13 +1,18 @@
+#include <VulkanTutorial/CpuTrace.h>
 #include <VulkanTutorial/MainWindow.h>
+#include <VulkanTutorial/VulkanHelpers.h>
 #include <VulkanTutorial/VulkanRenderer.h>
 
-namespace
-{
-void SetDeviceFeatures(VkPhysicalDeviceFeatures& deviceFeature)
-{
-	deviceFeature.samplerAnisotropy = vk::True;
-}
-} // namespace
+#include <QKeyEvent>
+
+#include <fmt/core.h>
+
+#include <vulkan/vulkan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 MainWindow::MainWindow()
 	: MainWindow{ nullptr }
@@ -17,16 +22,153 @@ MainWindow::MainWindow()
 MainWindow::MainWindow(QWindow* const parent)
     : QVulkanWindow{ parent }
 {
-    setEnabledFeaturesModifier(&SetDeviceFeatures);
+	// Qt leaves out the extension when the device doesn't have it
+	setDeviceExtensions({ VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME });
+	setEnabledFeaturesModifier([this](VkPhysicalDeviceFeatures2& features) {
+		SetDeviceFeatures(features);
+	});
+	setQueueCreateInfoModifier(
+		[this](const VkQueueFamilyProperties* /*properties*/,
+		       std::uint32_t /*queueFamilyCount*/,
+		       QList<VkDeviceQueueCreateInfo>& createInfos) {
+			AddTransferQueue(createInfos);
+		});
+}
+
+void MainWindow::SetDeviceFeatures(VkPhysicalDeviceFeatures2& features)
+{
+	features.features.samplerAnisotropy = vk::True;
+	// All the models are drawn with one indirect draw when culling on the GPU,
+	// each command starts at its model's first instance
+	features.features.multiDrawIndirect         = vk::True;
+	features.features.drawIndirectFirstInstance = vk::True;
+
+	// Supported either as core 1.3 or through the extension
+	using DynamicRenderingFeatures = vk::PhysicalDeviceDynamicRenderingFeatures;
+	const auto supportedFeatures =
+		vk::PhysicalDevice{ physicalDevice() }
+			.getFeatures2<vk::PhysicalDeviceFeatures2, DynamicRenderingFeatures>();
+	m_DynamicRenderingFeatures = DynamicRenderingFeatures{
+		.pNext            = features.pNext,
+		.dynamicRendering = supportedFeatures.get<DynamicRenderingFeatures>()
+		                        .dynamicRendering,
+	};
+	m_DeviceSetup.DynamicRendering =
+		m_DynamicRenderingFeatures.dynamicRendering == vk::True;
+	if (!m_DeviceSetup.DynamicRendering)
+	{
+		return;
+	}
+
+	// Qt 6.7 and later already chain the core features of 1.3 devices, the
+	// extension's struct may not be chained next to them
+	for (auto* next = static_cast<VkBaseOutStructure*>(features.pNext);
+	     next != nullptr; next = next->pNext)
+	{
+		if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES)
+		{
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<VkPhysicalDeviceVulkan13Features*>(next)
+				->dynamicRendering = vk::True;
+			return;
+		}
+	}
+	features.pNext = &m_DynamicRenderingFeatures;
+}
+
+void MainWindow::AddTransferQueue(QList<VkDeviceQueueCreateInfo>& createInfos)
+{
+	// Qt only asks for the graphics and present queues
+	const std::vector<vk::QueueFamilyProperties> queueFamilies =
+		vk::PhysicalDevice{ physicalDevice() }.getQueueFamilyProperties();
+	m_DeviceSetup.TransferQueueFamily = FindDedicatedQueueFamily(
+		queueFamilies, vk::QueueFlagBits::eTransfer,
+		vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute);
+	if (!m_DeviceSetup.TransferQueueFamily.has_value())
+	{
+		return;
+	}
+
+	const std::uint32_t family = *m_DeviceSetup.TransferQueueFamily;
+	const bool requested = std::ranges::any_of(
+		createInfos, [family](const VkDeviceQueueCreateInfo& createInfo) {
+			return createInfo.queueFamilyIndex == family;
+		});
+	if (!requested)
+	{
+		// Read when Qt creates the device, after this returns
+		static constexpr float QueuePriority{ 1.F };
+		createInfos.append(VkDeviceQueueCreateInfo{
+			.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.pNext            = nullptr,
+			.flags            = 0U,
+			.queueFamilyIndex = family,
+			.queueCount       = 1,
+			.pQueuePriorities = &QueuePriority,
+		});
+	}
 }
 
 QVulkanWindowRenderer* MainWindow::createRenderer()
 {
-	constexpr bool MSAAEnabled = true;
+	constexpr bool MSAAEnabled               = true;
+	constexpr bool GpuCullingEnabled         = true;
+	constexpr std::uint32_t RecordingThreads = 0U;
 	// This needs to be a raw pointer return
 	// It's ok as we give it a parent, so the MainWindow will take care of managing
 	// it
 
 	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
-	return new VulkanRenderer{ *this, MSAAEnabled };
+	auto* const renderer =
+		new VulkanRenderer{ *this, m_DeviceSetup, MSAAEnabled, GpuCullingEnabled,
+		                    RecordingThreads };
+	if (m_FrameBudget.has_value())
+	{
+		renderer->SetFrameBudget(*m_FrameBudget);
+	}
+	renderer->SetFramePacing(m_FramePacing);
+	if (m_ShaderHotReload)
+	{
+		renderer->EnableShaderHotReload();
+	}
+	return renderer;
+}
+
+void MainWindow::SetTracePath(std::filesystem::path tracePath)
+{
+	m_TracePath = std::move(tracePath);
+}
+
+void MainWindow::SetFrameBudget(const std::optional<double> frameBudget)
+{
+	m_FrameBudget = frameBudget;
+}
+
+void MainWindow::SetFramePacing(const FramePacing& pacing)
+{
+	m_FramePacing = pacing;
+}
+
+void MainWindow::SetShaderHotReload(const bool hotReload)
+{
+	m_ShaderHotReload = hotReload;
+}
+
+void MainWindow::keyPressEvent(QKeyEvent* const event)
+{
+	if (event->key() != Qt::Key::Key_F12 || m_TracePath.empty())
+	{
+		QVulkanWindow::keyPressEvent(event);
+		return;
+	}
+
+	try
+	{
+		CpuTrace::WriteChromeTrace(m_TracePath);
+		fmt::println("CPU trace written to {}", m_TracePath.string());
+	}
+	catch (const std::exception& e)
+	{
+		fmt::println(stderr, "Failed to write CPU trace: {}", e.what());
+	}
 }
@@ -0,0 +1,209 @@
+#include <VulkanTutorial/MeshCache.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+namespace
+{
+constexpr std::array<char, 8> MeshCacheMagic{
+	'V', 'T', 'M', 'E', 'S', 'H', '\0', '\0',
+};
+// Bump whenever the layout of the file or the conversion changes
+constexpr std::uint32_t MeshCacheVersion = 1U;
+constexpr std::size_t DataAlignment      = 16U;
+
+struct MeshCacheHeader
+{
+	std::array<char, 8> Magic{};
+	std::uint32_t Version{};
+	std::uint32_t VertexSize{};
+	std::uint32_t ImportFlags{};
+	std::uint32_t PathLength{};
+	std::int64_t SourceModifiedTime{};
+	std::uint32_t VertexCount{};
+	std::uint32_t IndexCount{};
+};
+static_assert(std::is_trivially_copyable_v<MeshCacheHeader>);
+
+[[nodiscard]] constexpr std::size_t AlignUp(const std::size_t value)
+{
+	return (value + DataAlignment - 1U) / DataAlignment * DataAlignment;
+}
+
+[[nodiscard]] std::filesystem::path GetCachePath(
+	const std::filesystem::path& modelPath)
+{
+	std::filesystem::path cachePath{ modelPath };
+	cachePath += ".meshcache";
+	return cachePath;
+}
+
+[[nodiscard]] std::string GetSourceKey(const std::filesystem::path& modelPath)
+{
+	std::error_code error{};
+	const std::filesystem::path canonicalPath =
+		std::filesystem::weakly_canonical(modelPath, error);
+	return error ? modelPath.generic_string() : canonicalPath.generic_string();
+}
+
+[[nodiscard]] std::int64_t GetModifiedTime(const std::filesystem::path& modelPath)
+{
+	return static_cast<std::int64_t>(
+		std::filesystem::last_write_time(modelPath).time_since_epoch().count());
+}
+
+[[nodiscard]] std::size_t GetVertexDataOffset(const std::size_t pathLength)
+{
+	return AlignUp(sizeof(MeshCacheHeader) + pathLength);
+}
+
+[[nodiscard]] std::size_t GetFileSize(const MeshCacheHeader& header)
+{
+	return GetVertexDataOffset(header.PathLength) +
+	       std::size_t{ header.VertexCount } * sizeof(Vertex) +
+	       std::size_t{ header.IndexCount } * sizeof(std::uint32_t);
+}
+} // namespace
+
+MeshCache::MeshCache(const std::filesystem::path& cachePath)
+	: m_File{ cachePath }
+{
+}
+
+MeshCache::~MeshCache() noexcept
+{
+	// Also unmaps everything mapped through it
+	m_File.close();
+}
+
+std::shared_ptr<const MeshCache> MeshCache::Open(
+	const std::filesystem::path& modelPath,
+	const std::uint32_t importFlags)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory), constructor is private
+	std::shared_ptr<MeshCache> cache{ new MeshCache{ GetCachePath(modelPath) } };
+	if (!cache->m_File.open(QIODevice::OpenModeFlag::ReadOnly) ||
+	    cache->m_File.size() < static_cast<qint64>(sizeof(MeshCacheHeader)))
+	{
+		return nullptr;
+	}
+
+	const uchar* const data = cache->m_File.map(0, cache->m_File.size());
+	if (data == nullptr)
+	{
+		return nullptr;
+	}
+
+	MeshCacheHeader header{};
+	std::memcpy(&header, data, sizeof(MeshCacheHeader));
+
+	const std::string sourceKey = GetSourceKey(modelPath);
+	const bool valid =
+		header.Magic == MeshCacheMagic && header.Version == MeshCacheVersion &&
+		header.VertexSize == sizeof(Vertex) && header.ImportFlags == importFlags &&
+		header.SourceModifiedTime == GetModifiedTime(modelPath) &&
+		header.PathLength == sourceKey.size() &&
+		static_cast<std::size_t>(cache->m_File.size()) == GetFileSize(header) &&
+		std::memcmp(data + sizeof(MeshCacheHeader), sourceKey.data(),
+	                sourceKey.size()) == 0;
+	if (!valid)
+	{
+		return nullptr;
+	}
+
+	const uchar* const vertexData = data + GetVertexDataOffset(header.PathLength);
+	const uchar* const indexData =
+		vertexData + std::size_t{ header.VertexCount } * sizeof(Vertex);
+	// Mapping is page aligned and the arrays are aligned within the file
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+	cache->m_Vertices = std::span{
+		reinterpret_cast<const Vertex*>(vertexData),
+		header.VertexCount,
+	};
+	cache->m_Indices  = std::span{
+		reinterpret_cast<const std::uint32_t*>(indexData),
+		header.IndexCount,
+	};
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+	return cache;
+}
+
+std::shared_ptr<const MeshCache> MeshCache::Create(
+	const std::filesystem::path& modelPath,
+	const std::uint32_t importFlags,
+	const std::uint32_t vertexCount,
+	const std::uint32_t indexCount,
+	const FillFn& fillFn)
+{
+	const std::filesystem::path cachePath = GetCachePath(modelPath);
+	std::filesystem::path temporaryPath{ cachePath };
+	temporaryPath += ".tmp";
+
+	const std::string sourceKey = GetSourceKey(modelPath);
+	MeshCacheHeader header{
+		.Magic              = MeshCacheMagic,
+		.Version            = MeshCacheVersion,
+		.VertexSize         = sizeof(Vertex),
+		.ImportFlags        = importFlags,
+		.PathLength         = static_cast<std::uint32_t>(sourceKey.size()),
+		.SourceModifiedTime = GetModifiedTime(modelPath),
+		.VertexCount        = vertexCount,
+		.IndexCount         = indexCount,
+	};
+	const std::size_t fileSize = GetFileSize(header);
+
+	{
+		QFile file{ temporaryPath };
+		if (!file.open(QIODevice::OpenModeFlag::ReadWrite |
+		               QIODevice::OpenModeFlag::Truncate) ||
+		    !file.resize(static_cast<qint64>(fileSize)))
+		{
+			fmt::println(stderr, "Failed to create mesh cache {}",
+			             temporaryPath.string());
+			return nullptr;
+		}
+
+		uchar* const data = file.map(0, static_cast<qint64>(fileSize));
+		if (data == nullptr)
+		{
+			file.remove();
+			return nullptr;
+		}
+
+		uchar* const vertexData = data + GetVertexDataOffset(header.PathLength);
+		uchar* const indexData =
+			vertexData + std::size_t{ vertexCount } * sizeof(Vertex);
+		// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+		fillFn(std::span{ reinterpret_cast<Vertex*>(vertexData), vertexCount },
+		       std::span{ reinterpret_cast<std::uint32_t*>(indexData),
+		                  indexCount });
+		// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+
+		// Header goes in last, a crash while filling leaves an invalid file behind
+		std::ranges::copy(sourceKey, data + sizeof(MeshCacheHeader));
+		std::memcpy(data, &header, sizeof(MeshCacheHeader));
+
+		file.unmap(data);
+		file.close();
+	}
+
+	// Readers never see a partially written entry
+	std::error_code error{};
+	std::filesystem::rename(temporaryPath, cachePath, error);
+	if (error)
+	{
+		fmt::println(stderr, "Failed to store mesh cache {}: {}",
+		             cachePath.string(), error.message());
+		std::filesystem::remove(temporaryPath, error);
+		return nullptr;
+	}
+
+	return Open(modelPath, importFlags);
+}
@@ -0,0 +1,388 @@
+#include <VulkanTutorial/MipmapGenerator.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <vector>
+
+namespace
+{
+constexpr std::uint32_t WorkgroupSize = 8U;
+
+// Matches the push constants in mip.comp
+struct MipPushConstants
+{
+	std::uint32_t Srgb{};
+};
+
+enum class MipBinding : std::uint32_t
+{
+	Source      = 0U,
+	Destination = 1U,
+};
+constexpr auto SourceBinding = static_cast<std::uint32_t>(MipBinding::Source);
+constexpr auto DestinationBinding =
+	static_cast<std::uint32_t>(MipBinding::Destination);
+
+[[nodiscard]] std::int32_t GetMipSize(const std::uint32_t size,
+                                      const std::uint32_t level)
+{
+	return static_cast<std::int32_t>(std::max(size >> level, 1U));
+}
+
+// Formats the compute fallback can store to, sRGB is encoded by the shader
+// and written through a UNORM view
+[[nodiscard]] bool SupportsComputeFallback(const vk::Format format)
+{
+	return format == vk::Format::eR8G8B8A8Unorm ||
+	       format == vk::Format::eR8G8B8A8Srgb;
+}
+} // namespace
+
+MipmapGenerator::MipmapGenerator(const vk::Device device,
+                                 const vk::PhysicalDevice physicalDevice,
+                                 const vk::ShaderModule mipShader,
+                                 const vk::PipelineCache pipelineCache)
+	: m_Device{ device }
+	, m_PhysicalDevice{ physicalDevice }
+{
+	// Texels are fetched directly, the sampler is only there for the sRGB decode
+	m_Sampler = m_Device.createSampler(vk::SamplerCreateInfo{
+		.magFilter    = vk::Filter::eNearest,
+		.minFilter    = vk::Filter::eNearest,
+		.mipmapMode   = vk::SamplerMipmapMode::eNearest,
+		.addressModeU = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vk::SamplerAddressMode::eClampToEdge,
+		.maxLod       = 0.F,
+		.borderColor  = vk::BorderColor::eIntOpaqueBlack,
+	});
+
+	const std::array descriptorSetLayoutBindings{
+		vk::DescriptorSetLayoutBinding{
+			.binding            = SourceBinding,
+			.descriptorType     = vk::DescriptorType::eCombinedImageSampler,
+			.descriptorCount    = 1U,
+			.stageFlags         = vk::ShaderStageFlagBits::eCompute,
+			.pImmutableSamplers = &m_Sampler,
+		},
+		vk::DescriptorSetLayoutBinding{
+			.binding         = DestinationBinding,
+			.descriptorType  = vk::DescriptorType::eStorageImage,
+			.descriptorCount = 1U,
+			.stageFlags      = vk::ShaderStageFlagBits::eCompute,
+		},
+	};
+	m_DescriptorSetLayout =
+		m_Device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+			.bindingCount =
+				static_cast<std::uint32_t>(descriptorSetLayoutBindings.size()),
+			.pBindings = descriptorSetLayoutBindings.data(),
+		});
+
+	constexpr vk::PushConstantRange PushConstantRange{
+		.stageFlags = vk::ShaderStageFlagBits::eCompute,
+		.offset     = 0U,
+		.size       = sizeof(MipPushConstants),
+	};
+	m_PipelineLayout = m_Device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+		.setLayoutCount         = 1U,
+		.pSetLayouts            = &m_DescriptorSetLayout,
+		.pushConstantRangeCount = 1U,
+		.pPushConstantRanges    = &PushConstantRange,
+	});
+
+	auto [createPipelineResult, pipeline] = m_Device.createComputePipeline(
+		pipelineCache,
+		vk::ComputePipelineCreateInfo{
+			.stage =
+				vk::PipelineShaderStageCreateInfo{
+					.stage  = vk::ShaderStageFlagBits::eCompute,
+					.module = mipShader,
+					.pName  = "main",
+				},
+			.layout            = m_PipelineLayout,
+			.basePipelineIndex = -1,
+		});
+	if (createPipelineResult != vk::Result::eSuccess)
+	{
+		throw std::runtime_error{
+			fmt::format("Failed to create mipmap pipeline: {}",
+			            vk::to_string(createPipelineResult)),
+		};
+	}
+	m_Pipeline = pipeline;
+}
+
+MipmapGenerator::~MipmapGenerator() noexcept
+{
+	m_Device.destroy(m_Pipeline);
+	m_Device.destroy(m_PipelineLayout);
+	m_Device.destroy(m_DescriptorSetLayout);
+	m_Device.destroy(m_Sampler);
+}
+
+std::uint32_t MipmapGenerator::GetMipLevelCount(const vk::Extent2D extent) noexcept
+{
+	return static_cast<std::uint32_t>(
+		std::bit_width(std::max(extent.width, extent.height)));
+}
+
+MipmapGenerator::Method MipmapGenerator::GetMethod(const vk::Format format) const
+{
+	constexpr vk::FormatFeatureFlags BlitFeatures =
+		vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst |
+		vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+	const vk::FormatProperties properties =
+		m_PhysicalDevice.getFormatProperties(format);
+	if ((properties.optimalTilingFeatures & BlitFeatures) == BlitFeatures)
+	{
+		return Method::Blit;
+	}
+	if (SupportsComputeFallback(format))
+	{
+		return Method::Compute;
+	}
+	throw std::runtime_error{ fmt::format("Can't generate mipmaps for {}",
+	                                      vk::to_string(format)) };
+}
+
+vk::ImageUsageFlags MipmapGenerator::GetRequiredUsage(const vk::Format format) const
+{
+	if (GetMethod(format) == Method::Blit)
+	{
+		return vk::ImageUsageFlagBits::eTransferSrc |
+		       vk::ImageUsageFlagBits::eTransferDst;
+	}
+	return vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled |
+	       vk::ImageUsageFlagBits::eStorage;
+}
+
+vk::ImageCreateFlags MipmapGenerator::GetRequiredFlags(
+	const vk::Format format) const
+{
+	if (GetMethod(format) == Method::Compute &&
+	    format != vk::Format::eR8G8B8A8Unorm)
+	{
+		// The image gets the storage usage its sRGB format doesn't support
+		return vk::ImageCreateFlagBits::eMutableFormat |
+		       vk::ImageCreateFlagBits::eExtendedUsage;
+	}
+	return vk::ImageCreateFlags{};
+}
+
+std::function<void()> MipmapGenerator::Generate(
+	const vk::CommandBuffer commandBuffer,
+	const vk::Image image,
+	const vk::Format format,
+	const vk::Extent2D extent,
+	const std::uint32_t mipLevels)
+{
+	assert(mipLevels <= GetMipLevelCount(extent));
+	if (mipLevels <= 1U)
+	{
+		TransitionImageLayout(commandBuffer, image, format,
+		                      vk::ImageLayout::eTransferDstOptimal,
+		                      vk::ImageLayout::eShaderReadOnlyOptimal);
+		return [] {};
+	}
+
+	if (GetMethod(format) == Method::Blit)
+	{
+		GenerateWithBlits(commandBuffer, image, extent, mipLevels);
+		return [] {};
+	}
+	return GenerateWithCompute(commandBuffer, image, format, extent, mipLevels);
+}
+
+void MipmapGenerator::GenerateWithBlits(const vk::CommandBuffer commandBuffer,
+                                        const vk::Image image,
+                                        const vk::Extent2D extent,
+                                        const std::uint32_t mipLevels) const
+{
+	TransitionImageLayout(commandBuffer, image, vk::Format{},
+	                      vk::ImageLayout::eTransferDstOptimal,
+	                      vk::ImageLayout::eTransferSrcOptimal, 0U, 1U);
+
+	const auto subresource = [](const std::uint32_t mipLevel) {
+		return vk::ImageSubresourceLayers{
+			.aspectMask     = vk::ImageAspectFlagBits::eColor,
+			.mipLevel       = mipLevel,
+			.baseArrayLayer = 0U,
+			.layerCount     = 1U,
+		};
+	};
+	for (std::uint32_t level{ 1U }; level < mipLevels; ++level)
+	{
+		const vk::ImageBlit blit{
+			.srcSubresource = subresource(level - 1U),
+			.srcOffsets =
+				std::array{
+					vk::Offset3D{ .x = 0, .y = 0, .z = 0 },
+					vk::Offset3D{ .x = GetMipSize(extent.width, level - 1U),
+					              .y = GetMipSize(extent.height, level - 1U),
+					              .z = 1 },
+				},
+			.dstSubresource = subresource(level),
+			.dstOffsets =
+				std::array{
+					vk::Offset3D{ .x = 0, .y = 0, .z = 0 },
+					vk::Offset3D{ .x = GetMipSize(extent.width, level),
+					              .y = GetMipSize(extent.height, level),
+					              .z = 1 },
+				},
+		};
+		commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image,
+		                        vk::ImageLayout::eTransferDstOptimal,
+		                        vk::ArrayProxy{ blit }, vk::Filter::eLinear);
+
+		// The previous level is done, this one becomes the next blit's source
+		const vk::ImageLayout nextLayout =
+			level + 1U == mipLevels ? vk::ImageLayout::eShaderReadOnlyOptimal
+			                        : vk::ImageLayout::eTransferSrcOptimal;
+		const std::array barriers{
+			MakeImageLayoutBarrier(image, vk::ImageLayout::eTransferSrcOptimal,
+			                       vk::ImageLayout::eShaderReadOnlyOptimal,
+			                       level - 1U),
+			MakeImageLayoutBarrier(image, vk::ImageLayout::eTransferDstOptimal,
+			                       nextLayout, level),
+		};
+		TransitionImageLayouts(commandBuffer, barriers);
+	}
+}
+
+std::function<void()> MipmapGenerator::GenerateWithCompute(
+	const vk::CommandBuffer commandBuffer,
+	const vk::Image image,
+	const vk::Format format,
+	const vk::Extent2D extent,
+	const std::uint32_t mipLevels)
+{
+	const std::uint32_t dispatchCount = mipLevels - 1U;
+	const std::array poolSizes{
+		vk::DescriptorPoolSize{
+			.type            = vk::DescriptorType::eCombinedImageSampler,
+			.descriptorCount = dispatchCount,
+		},
+		vk::DescriptorPoolSize{
+			.type            = vk::DescriptorType::eStorageImage,
+			.descriptorCount = dispatchCount,
+		},
+	};
+	const vk::DescriptorPool descriptorPool =
+		m_Device.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+			.maxSets       = dispatchCount,
+			.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size()),
+			.pPoolSizes    = poolSizes.data(),
+		});
+	const std::vector<vk::DescriptorSetLayout> layouts(dispatchCount,
+	                                                   m_DescriptorSetLayout);
+	const std::vector<vk::DescriptorSet> descriptorSets =
+		m_Device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+			.descriptorPool     = descriptorPool,
+			.descriptorSetCount = dispatchCount,
+			.pSetLayouts        = layouts.data(),
+		});
+
+	// One sampled view in the image's own format for decoding and one UNORM
+	// storage view per level, storage images can't be sRGB
+	std::vector<vk::ImageView> views{};
+	views.reserve(std::size_t{ mipLevels } * 2U);
+	const auto createView = [&](const vk::Format viewFormat,
+	                            const vk::ImageUsageFlags usage,
+	                            const std::uint32_t level) {
+		const vk::ImageViewUsageCreateInfo usageInfo{ .usage = usage };
+		return views.emplace_back(m_Device.createImageView(vk::ImageViewCreateInfo{
+			.pNext    = &usageInfo,
+			.image    = image,
+			.viewType = vk::ImageViewType::e2D,
+			.format   = viewFormat,
+			.subresourceRange =
+				vk::ImageSubresourceRange{
+					.aspectMask     = vk::ImageAspectFlagBits::eColor,
+					.baseMipLevel   = level,
+					.levelCount     = 1U,
+					.baseArrayLayer = 0U,
+					.layerCount     = 1U,
+				},
+		}));
+	};
+	for (std::uint32_t level{ 1U }; level < mipLevels; ++level)
+	{
+		const vk::DescriptorImageInfo sourceInfo{
+			.imageView   = createView(format, vk::ImageUsageFlagBits::eSampled,
+			                          level - 1U),
+			.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+		};
+		const vk::DescriptorImageInfo destinationInfo{
+			.imageView   = createView(vk::Format::eR8G8B8A8Unorm,
+			                          vk::ImageUsageFlagBits::eStorage, level),
+			.imageLayout = vk::ImageLayout::eGeneral,
+		};
+		const vk::DescriptorSet descriptorSet = descriptorSets.at(level - 1U);
+		m_Device.updateDescriptorSets(
+			std::array{
+				vk::WriteDescriptorSet{
+					.dstSet          = descriptorSet,
+					.dstBinding      = SourceBinding,
+					.dstArrayElement = 0U,
+					.descriptorCount = 1U,
+					.descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+					.pImageInfo      = &sourceInfo,
+				},
+				vk::WriteDescriptorSet{
+					.dstSet          = descriptorSet,
+					.dstBinding      = DestinationBinding,
+					.dstArrayElement = 0U,
+					.descriptorCount = 1U,
+					.descriptorType  = vk::DescriptorType::eStorageImage,
+					.pImageInfo      = &destinationInfo,
+				},
+			},
+			{});
+	}
+
+	const std::array initialBarriers{
+		MakeImageLayoutBarrier(image, vk::ImageLayout::eTransferDstOptimal,
+		                       vk::ImageLayout::eShaderReadOnlyOptimal, 0U, 1U),
+		MakeImageLayoutBarrier(image, vk::ImageLayout::eTransferDstOptimal,
+		                       vk::ImageLayout::eGeneral, 1U, dispatchCount),
+	};
+	TransitionImageLayouts(commandBuffer, initialBarriers);
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_Pipeline);
+	const MipPushConstants pushConstants{
+		.Srgb = format == vk::Format::eR8G8B8A8Srgb ? 1U : 0U,
+	};
+	commandBuffer.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eCompute,
+	                            0U, sizeof(MipPushConstants), &pushConstants);
+	for (std::uint32_t level{ 1U }; level < mipLevels; ++level)
+	{
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+		                                 m_PipelineLayout, 0U,
+		                                 descriptorSets.at(level - 1U), {});
+		const vk::Extent2D levelExtent = GetMipExtent(extent, level);
+		const std::uint32_t width      = levelExtent.width;
+		const std::uint32_t height     = levelExtent.height;
+		commandBuffer.dispatch((width + WorkgroupSize - 1U) / WorkgroupSize,
+		                       (height + WorkgroupSize - 1U) / WorkgroupSize, 1U);
+
+		TransitionImageLayout(commandBuffer, image, format,
+		                      vk::ImageLayout::eGeneral,
+		                      vk::ImageLayout::eShaderReadOnlyOptimal, level, 1U);
+	}
+
+	return [device = m_Device, descriptorPool, views = std::move(views)] {
+		for (const vk::ImageView view : views)
+		{
+			device.destroy(view);
+		}
+		// Frees the descriptor sets as well
+		device.destroy(descriptorPool);
+	};
+}
@@ -0,0 +1,372 @@
+#include <VulkanTutorial/ModelCuller.h>
+#include <VulkanTutorial/ModelManager.h>
+#include <VulkanTutorial/Vertex.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+
+namespace
+{
+constexpr std::uint32_t WorkgroupSize      = 64U;
+constexpr vk::DeviceSize MinimumBufferSize = 4096U;
+
+// Matches CullInstance in cull.comp, std430 pads it to 16 bytes
+struct CullInstance
+{
+	QGenericMatrix<4, 4, float> Transform;
+	std::uint32_t Model{};
+	std::array<std::uint32_t, 3> Padding{};
+};
+static_assert(sizeof(CullInstance) == 80U);
+
+using ModelTransform = QGenericMatrix<4, 4, float>;
+
+struct CullPushConstants
+{
+	std::uint32_t InstanceCount{};
+};
+
+enum class CullBinding : std::uint32_t
+{
+	Uniforms         = 0U,
+	BoundingSpheres  = 1U,
+	Instances        = 2U,
+	DrawCommands     = 3U,
+	VisibleInstances = 4U,
+	ModelTransforms  = 5U,
+};
+constexpr auto UniformsBinding = static_cast<std::uint32_t>(CullBinding::Uniforms);
+
+template <typename T>
+[[nodiscard]] std::span<T> AsMapped(const DeviceAllocation& allocation,
+                                    const std::size_t count)
+{
+	// Host visible blocks are persistently mapped by the allocator
+	return std::span{ static_cast<T*>(allocation.MappedData), count };
+}
+} // namespace
+
+ModelCuller::ModelCuller(const vk::Device device,
+                         DeviceMemoryAllocator& allocator,
+                         const std::uint32_t concurrentFrameCount,
+                         const vk::ShaderModule cullShader,
+                         const vk::PipelineCache pipelineCache)
+	: m_Device{ device }
+	, m_Allocator{ &allocator }
+	, m_Frames(concurrentFrameCount)
+{
+	const auto storageBinding = [](const CullBinding binding) {
+		return vk::DescriptorSetLayoutBinding{
+			.binding         = static_cast<std::uint32_t>(binding),
+			.descriptorType  = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = 1U,
+			.stageFlags      = vk::ShaderStageFlagBits::eCompute,
+		};
+	};
+	const std::array descriptorSetLayoutBindings{
+		vk::DescriptorSetLayoutBinding{
+			.binding         = UniformsBinding,
+			.descriptorType  = vk::DescriptorType::eUniformBuffer,
+			.descriptorCount = 1U,
+			.stageFlags      = vk::ShaderStageFlagBits::eCompute,
+		},
+		storageBinding(CullBinding::BoundingSpheres),
+		storageBinding(CullBinding::Instances),
+		storageBinding(CullBinding::DrawCommands),
+		storageBinding(CullBinding::VisibleInstances),
+		storageBinding(CullBinding::ModelTransforms),
+	};
+	m_DescriptorSetLayout =
+		m_Device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+			.bindingCount =
+				static_cast<std::uint32_t>(descriptorSetLayoutBindings.size()),
+			.pBindings = descriptorSetLayoutBindings.data(),
+		});
+
+	const std::array poolSizes{
+		vk::DescriptorPoolSize{
+			.type            = vk::DescriptorType::eUniformBuffer,
+			.descriptorCount = concurrentFrameCount,
+		},
+		vk::DescriptorPoolSize{
+			.type            = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = concurrentFrameCount * 5U,
+		},
+	};
+	m_DescriptorPool = m_Device.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+		.maxSets       = concurrentFrameCount,
+		.poolSizeCount = static_cast<std::uint32_t>(poolSizes.size()),
+		.pPoolSizes    = poolSizes.data(),
+	});
+
+	const std::vector<vk::DescriptorSetLayout> layouts(concurrentFrameCount,
+	                                                   m_DescriptorSetLayout);
+	const std::vector<vk::DescriptorSet> descriptorSets =
+		m_Device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+			.descriptorPool     = m_DescriptorPool,
+			.descriptorSetCount = concurrentFrameCount,
+			.pSetLayouts        = layouts.data(),
+		});
+	for (std::uint32_t i{ 0U }; i < concurrentFrameCount; ++i)
+	{
+		m_Frames.at(i).DescriptorSet = descriptorSets.at(i);
+	}
+
+	constexpr vk::PushConstantRange PushConstantRange{
+		.stageFlags = vk::ShaderStageFlagBits::eCompute,
+		.offset     = 0U,
+		.size       = sizeof(CullPushConstants),
+	};
+	m_PipelineLayout = m_Device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
+		.setLayoutCount         = 1U,
+		.pSetLayouts            = &m_DescriptorSetLayout,
+		.pushConstantRangeCount = 1U,
+		.pPushConstantRanges    = &PushConstantRange,
+	});
+
+	auto [createPipelineResult, pipeline] = m_Device.createComputePipeline(
+		pipelineCache,
+		vk::ComputePipelineCreateInfo{
+			.stage =
+				vk::PipelineShaderStageCreateInfo{
+					.stage  = vk::ShaderStageFlagBits::eCompute,
+					.module = cullShader,
+					.pName  = "main",
+				},
+			.layout            = m_PipelineLayout,
+			.basePipelineIndex = -1,
+		});
+	if (createPipelineResult != vk::Result::eSuccess)
+	{
+		throw std::runtime_error{
+			fmt::format("Failed to create cull pipeline: {}",
+			            vk::to_string(createPipelineResult)),
+		};
+	}
+	m_Pipeline = pipeline;
+}
+
+ModelCuller::~ModelCuller() noexcept
+{
+	for (FrameResources& frame : m_Frames)
+	{
+		Destroy(frame.DrawCommandTemplates);
+		Destroy(frame.BoundingSpheres);
+		Destroy(frame.ModelTransforms);
+		Destroy(frame.Instances);
+		Destroy(frame.DrawCommands);
+		Destroy(frame.VisibleInstances);
+	}
+
+	m_Device.destroy(m_Pipeline);
+	m_Device.destroy(m_PipelineLayout);
+	// Frees the descriptor sets as well
+	m_Device.destroy(m_DescriptorPool);
+	m_Device.destroy(m_DescriptorSetLayout);
+}
+
+void ModelCuller::Reserve(FrameBuffer& frameBuffer,
+                          const vk::DeviceSize size,
+                          const vk::BufferUsageFlags usage,
+                          const vk::MemoryPropertyFlags memoryFlags)
+{
+	if (size <= frameBuffer.Size)
+	{
+		return;
+	}
+
+	// Buffers belong to a single frame, the GPU is done with the previous one
+	Destroy(frameBuffer);
+	frameBuffer.Size = std::bit_ceil(std::max(size, MinimumBufferSize));
+	std::tie(frameBuffer.Buffer, frameBuffer.Allocation) = CreateDeviceBuffer(
+		frameBuffer.Size, usage, memoryFlags, m_Device, *m_Allocator);
+}
+
+void ModelCuller::Destroy(FrameBuffer& frameBuffer) noexcept
+{
+	if (frameBuffer.Buffer)
+	{
+		m_Device.destroy(frameBuffer.Buffer);
+		m_Allocator->Free(frameBuffer.Allocation);
+	}
+	frameBuffer = FrameBuffer{};
+}
+
+void ModelCuller::Cull(const vk::CommandBuffer commandBuffer,
+                       const std::uint32_t frameIndex,
+                       const std::span<const Model* const> models,
+                       const GeometryBuffer& geometry,
+                       const vk::Buffer uniformBuffer)
+{
+	FrameResources& frame = m_Frames.at(frameIndex);
+
+	std::size_t instanceCount{ 0U };
+	for (const Model* const model : models)
+	{
+		instanceCount += model->Instances.size();
+	}
+	if (instanceCount == 0U)
+	{
+		return;
+	}
+
+	const vk::DeviceSize drawCommandsSize =
+		models.size() * sizeof(vk::DrawIndexedIndirectCommand);
+	constexpr vk::MemoryPropertyFlags HostMemory{
+		vk::MemoryPropertyFlagBits::eHostVisible |
+		vk::MemoryPropertyFlagBits::eHostCoherent
+	};
+	constexpr vk::MemoryPropertyFlags DeviceMemory{
+		vk::MemoryPropertyFlagBits::eDeviceLocal
+	};
+	Reserve(frame.DrawCommandTemplates, drawCommandsSize,
+	        vk::BufferUsageFlagBits::eTransferSrc, HostMemory);
+	Reserve(frame.BoundingSpheres, models.size() * sizeof(QVector4D),
+	        vk::BufferUsageFlagBits::eStorageBuffer, HostMemory);
+	Reserve(frame.ModelTransforms, models.size() * sizeof(ModelTransform),
+	        vk::BufferUsageFlagBits::eStorageBuffer, HostMemory);
+	Reserve(frame.Instances, instanceCount * sizeof(CullInstance),
+	        vk::BufferUsageFlagBits::eStorageBuffer, HostMemory);
+	Reserve(frame.DrawCommands, drawCommandsSize,
+	        vk::BufferUsageFlagBits::eTransferDst |
+	            vk::BufferUsageFlagBits::eStorageBuffer |
+	            vk::BufferUsageFlagBits::eIndirectBuffer,
+	        DeviceMemory);
+	Reserve(frame.VisibleInstances, instanceCount * sizeof(InstanceData),
+	        vk::BufferUsageFlagBits::eStorageBuffer |
+	            vk::BufferUsageFlagBits::eVertexBuffer,
+	        DeviceMemory);
+
+	const std::span drawCommandTemplates = AsMapped<vk::DrawIndexedIndirectCommand>(
+		frame.DrawCommandTemplates.Allocation, models.size());
+	const std::span boundingSpheres =
+		AsMapped<QVector4D>(frame.BoundingSpheres.Allocation, models.size());
+	const std::span modelTransforms =
+		AsMapped<ModelTransform>(frame.ModelTransforms.Allocation, models.size());
+	const std::span instances =
+		AsMapped<CullInstance>(frame.Instances.Allocation, instanceCount);
+
+	std::uint32_t firstInstance{ 0U };
+	for (std::uint32_t modelIndex{ 0U }; modelIndex < models.size(); ++modelIndex)
+	{
+		const Model& model         = *models[modelIndex];
+		const GeometryRange& range = geometry.GetRange(model.Geometry);
+
+		// The cull pass counts the visible instances up from 0
+		drawCommandTemplates[modelIndex] = vk::DrawIndexedIndirectCommand{
+			.indexCount    = range.IndexCount,
+			.instanceCount = 0U,
+			.firstIndex    = range.FirstIndex,
+			.vertexOffset  = static_cast<std::int32_t>(range.FirstVertex),
+			.firstInstance = firstInstance,
+		};
+		boundingSpheres[modelIndex] = model.BoundingSphere;
+		modelTransforms[modelIndex] = model.Transform;
+		for (const InstanceData& instance : model.Instances)
+		{
+			instances[firstInstance++] = CullInstance{
+				.Transform = instance.Transform,
+				.Model     = modelIndex,
+			};
+		}
+	}
+
+	const auto bufferInfo = [](const FrameBuffer& frameBuffer) {
+		return vk::DescriptorBufferInfo{ frameBuffer.Buffer, 0U, VK_WHOLE_SIZE };
+	};
+	const std::array bufferInfos{
+		vk::DescriptorBufferInfo{ uniformBuffer, 0U, VK_WHOLE_SIZE },
+		bufferInfo(frame.BoundingSpheres),
+		bufferInfo(frame.Instances),
+		bufferInfo(frame.DrawCommands),
+		bufferInfo(frame.VisibleInstances),
+		bufferInfo(frame.ModelTransforms),
+	};
+	// Buffers might have been reallocated, the set isn't in use by the GPU anymore
+	std::array<vk::WriteDescriptorSet, bufferInfos.size()> descriptorWrites{};
+	for (std::uint32_t i{ 0U }; i < descriptorWrites.size(); ++i)
+	{
+		descriptorWrites.at(i) = vk::WriteDescriptorSet{
+			.dstSet          = frame.DescriptorSet,
+			.dstBinding      = i,
+			.dstArrayElement = 0U,
+			.descriptorCount = 1U,
+			.descriptorType  = i == UniformsBinding
+			                       ? vk::DescriptorType::eUniformBuffer
+			                       : vk::DescriptorType::eStorageBuffer,
+			.pBufferInfo     = &bufferInfos.at(i),
+		};
+	}
+	m_Device.updateDescriptorSets(descriptorWrites,
+	                              vk::ArrayProxy<const vk::CopyDescriptorSet>{});
+
+	commandBuffer.copyBuffer(frame.DrawCommandTemplates.Buffer,
+	                         frame.DrawCommands.Buffer,
+	                         vk::BufferCopy{
+								 .srcOffset = 0U,
+								 .dstOffset = 0U,
+								 .size      = drawCommandsSize,
+							 });
+	BufferUploadBarrier(commandBuffer, frame.DrawCommands.Buffer,
+	                    vk::PipelineStageFlagBits::eComputeShader,
+	                    vk::AccessFlagBits::eShaderRead |
+	                        vk::AccessFlagBits::eShaderWrite);
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_Pipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+	                                 m_PipelineLayout, 0U,
+	                                 vk::ArrayProxy{ frame.DescriptorSet },
+	                                 vk::ArrayProxy<const std::uint32_t>{});
+	const CullPushConstants pushConstants{
+		.InstanceCount = static_cast<std::uint32_t>(instanceCount),
+	};
+	commandBuffer.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eCompute,
+	                            0U, sizeof(CullPushConstants), &pushConstants);
+	commandBuffer.dispatch(
+		(pushConstants.InstanceCount + WorkgroupSize - 1U) / WorkgroupSize, 1U, 1U);
+
+	constexpr vk::MemoryBarrier CullBarrier{
+		.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+		.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead |
+		                 vk::AccessFlagBits::eVertexAttributeRead,
+	};
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eComputeShader,
+		vk::PipelineStageFlagBits::eDrawIndirect |
+			vk::PipelineStageFlagBits::eVertexInput,
+		vk::DependencyFlags{},
+		vk::ArrayProxy<const vk::MemoryBarrier>{ CullBarrier },
+		vk::ArrayProxy<const vk::BufferMemoryBarrier>{},
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{});
+}
+
+void ModelCuller::Draw(const vk::CommandBuffer commandBuffer,
+                       const std::uint32_t frameIndex,
+                       const std::span<const Model* const> models,
+                       const GeometryBuffer& geometry) const
+{
+	const FrameResources& frame = m_Frames.at(frameIndex);
+	if (models.empty() || !frame.DrawCommands.Buffer)
+	{
+		return;
+	}
+
+	constexpr vk::DeviceSize Offset{ 0 };
+	commandBuffer.bindVertexBuffers(InstanceData::Binding,
+	                                { frame.VisibleInstances.Buffer }, { Offset });
+	geometry.Bind(commandBuffer);
+
+	// Needs multiDrawIndirect and drawIndirectFirstInstance, culled models just
+	// end up with 0 instances. Every model keeps its slot, so a count buffer
+	// would always hold the model count. drawIndexedIndirectCount only pays off
+	// once a second pass compacts the commands, which costs more than the empty
+	// draws it would skip
+	commandBuffer.drawIndexedIndirect(frame.DrawCommands.Buffer, 0U,
+	                                  static_cast<std::uint32_t>(models.size()),
+	                                  sizeof(vk::DrawIndexedIndirectCommand));
+}
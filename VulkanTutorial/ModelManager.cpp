@@ -1,3 +1,5 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/MeshCache.h>
 #include <VulkanTutorial/ModelManager.h>
 #include <VulkanTutorial/Vertex.h>
 #include <VulkanTutorial/VulkanHelpers.h>
@@ -7,10 +9,17 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+#include <fmt/core.h>
+
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstdint>
 #include <execution>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <ranges>
 #include <type_traits>
@@ -18,21 +27,265 @@
 namespace
 {
 constexpr std::uint32_t ImportFlags =
-    aiProcess_JoinIdenticalVertices | aiProcess_Triangulate |
-    aiProcess_ValidateDataStructure | aiProcess_ImproveCacheLocality |
-    aiProcess_RemoveRedundantMaterials | aiProcess_FindInvalidData |
-    aiProcess_GenUVCoords | aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
-    aiProcess_FlipUVs;
+	aiProcess_JoinIdenticalVertices | aiProcess_Triangulate |
+	aiProcess_ValidateDataStructure | aiProcess_ImproveCacheLocality |
+	aiProcess_RemoveRedundantMaterials | aiProcess_FindInvalidData |
+	aiProcess_GenUVCoords | aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
+	aiProcess_FlipUVs;
+constexpr vk::DeviceSize IndexSize = sizeof(std::uint32_t);
+
+using MatrixF4 = QGenericMatrix<4, 4, float>;
+
+void PushModelTransform(const vk::CommandBuffer commandBuffer,
+                        const vk::PipelineLayout pipelineLayout,
+                        const MatrixF4& transform)
+{
+	const ModelPushConstants pushConstants{ .Transform = transform };
+	commandBuffer.pushConstants(pipelineLayout, ModelPushConstantRange.stageFlags,
+	                            ModelPushConstantRange.offset,
+	                            ModelPushConstantRange.size, &pushConstants);
+}
 
-template <typename... Functors>
-// NOLINTNEXTLINE(fuchsia-multiple-inheritance)
-struct [[nodiscard]] Overload : Functors...
+// Keeps the assimp scene alive while its chunks are streamed to the GPU
+struct [[nodiscard]] ImportedScene
 {
-    using Functors::operator()...;
+	Assimp::Importer Importer;
+	std::span<const aiMesh* const> Meshes;
+
+	// Prefix sums over the meshes, element i is where mesh i starts and the last
+	// element is the total, one past the last mesh
+	std::vector<std::uint32_t> VertexOffsets;
+	std::vector<std::uint32_t> IndexOffsets;
 };
 
-template <typename... Functors>
-Overload(Functors...) -> Overload<Functors...>;
+template <typename CountFn>
+[[nodiscard]] std::vector<std::uint32_t> ComputeOffsets(
+	const std::span<const aiMesh* const> meshes,
+	CountFn countFn)
+{
+	std::vector<std::uint32_t> offsets(meshes.size() + 1U, 0U);
+	std::transform_inclusive_scan(std::execution::par_unseq, begin(meshes),
+	                              end(meshes), std::next(begin(offsets)),
+	                              std::plus<>{}, countFn);
+	return offsets;
+}
+
+// Calls convertFn(meshIndex, firstInMesh, lastInMesh, firstInOutput) in parallel
+// for every mesh overlapping the [first, first + count) element range
+template <typename ConvertFn>
+void ForEachMeshInRange(const std::span<const std::uint32_t> offsets,
+                        const std::uint32_t first,
+                        const std::uint32_t count,
+                        ConvertFn convertFn)
+{
+	// Without meshes there is only the total
+	if (count == 0U || offsets.size() < 2U)
+	{
+		return;
+	}
+	const std::uint32_t last = first + count;
+	// upper_bound - 1 is the mesh containing the element
+	const std::span<const std::uint32_t> meshOffsets =
+		offsets.first(offsets.size() - 1U);
+	const auto firstMesh = static_cast<std::size_t>(
+		std::ranges::upper_bound(meshOffsets, first) - begin(meshOffsets) - 1);
+	const auto lastMesh = static_cast<std::size_t>(
+		std::ranges::lower_bound(offsets, last) - begin(offsets));
+
+	const auto meshIndices = std::views::iota(firstMesh, lastMesh);
+	std::for_each(
+		std::execution::par_unseq, begin(meshIndices), end(meshIndices),
+		[&](const std::size_t meshIndex) {
+			const std::uint32_t meshOffset = offsets[meshIndex];
+			const std::uint32_t begin      = std::max(first, meshOffset);
+			const std::uint32_t end = std::min(last, offsets[meshIndex + 1U]);
+			convertFn(meshIndex, begin - meshOffset, end - meshOffset,
+			          begin - first);
+		});
+}
+
+// Converts the vertices [first, first + output.size()) of the whole scene
+void ConvertVertices(const ImportedScene& scene,
+                     const std::uint32_t first,
+                     const std::span<Vertex> output)
+{
+	ForEachMeshInRange(
+		scene.VertexOffsets, first, static_cast<std::uint32_t>(output.size()),
+		[&](const std::size_t meshIndex, const std::uint32_t begin,
+	        const std::uint32_t end, const std::uint32_t outputOffset) {
+			const aiMesh* const mesh = scene.Meshes[meshIndex];
+			const std::span<const aiVector3D> meshVertices{ mesh->mVertices,
+				                                            mesh->mNumVertices };
+			const std::span<const aiVector3D> meshTextureCoords{
+				mesh->mTextureCoords[0], mesh->mNumVertices
+			};
+
+			for (std::uint32_t i{ begin }; i < end; ++i)
+			{
+				const aiVector3D& vertex       = meshVertices[i];
+				const aiVector3D& textureCoord = meshTextureCoords[i];
+				assert(0.F <= textureCoord.x && textureCoord.x <= 1.F);
+				assert(0.F <= textureCoord.y && textureCoord.y <= 1.F);
+				output[outputOffset + (i - begin)] =
+					Vertex::Create(QVector3D{ vertex.x, vertex.y, vertex.z },
+				                   QVector2D{ textureCoord.x, textureCoord.y });
+			}
+		});
+}
+
+// Converts the indices [first, first + output.size()) of the whole scene
+void ConvertIndices(const ImportedScene& scene,
+                    const std::uint32_t first,
+                    const std::span<std::uint32_t> output)
+{
+	ForEachMeshInRange(
+		scene.IndexOffsets, first, static_cast<std::uint32_t>(output.size()),
+		[&](const std::size_t meshIndex, const std::uint32_t begin,
+	        const std::uint32_t end, const std::uint32_t outputOffset) {
+			const aiMesh* const mesh = scene.Meshes[meshIndex];
+			const std::span<const aiFace> meshFaces{ mesh->mFaces,
+			                                         mesh->mNumFaces };
+			// All meshes share one vertex buffer, rebase onto this mesh's vertices
+			const std::uint32_t baseVertex = scene.VertexOffsets[meshIndex];
+
+			for (std::uint32_t i{ begin }; i < end; ++i)
+			{
+				const aiFace& face = meshFaces[i / 3U];
+				assert(face.mNumIndices == 3U);
+				output[outputOffset + (i - begin)] =
+					baseVertex + face.mIndices[i % 3U];
+			}
+		});
+}
+
+// Reinterprets a staging chunk as elements, chunks are always split at whole
+// elements and the staging memory is 16 byte aligned
+template <typename T>
+[[nodiscard]] std::span<T> AsElements(const std::span<std::byte> destination)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	return std::span{ reinterpret_cast<T*>(destination.data()),
+		              destination.size() / sizeof(T) };
+}
+
+[[nodiscard]] UploadWriter MakeVertexWriter(
+	std::shared_ptr<const ImportedScene> scene)
+{
+	return [scene = std::move(scene)](const std::span<std::byte> destination,
+	                                  const vk::DeviceSize sourceOffset) {
+		ConvertVertices(*scene,
+		                static_cast<std::uint32_t>(sourceOffset / sizeof(Vertex)),
+		                AsElements<Vertex>(destination));
+	};
+}
+
+[[nodiscard]] UploadWriter MakeIndexWriter(
+	std::shared_ptr<const ImportedScene> scene)
+{
+	return [scene = std::move(scene)](const std::span<std::byte> destination,
+	                                  const vk::DeviceSize sourceOffset) {
+		const auto firstIndex =
+			static_cast<std::uint32_t>(sourceOffset / sizeof(std::uint32_t));
+		ConvertIndices(*scene, firstIndex, AsElements<std::uint32_t>(destination));
+	};
+}
+
+// Copies out of the mapped cache entry, keeping it mapped until the last chunk
+template <typename T>
+[[nodiscard]] UploadWriter MakeCacheWriter(
+	std::shared_ptr<const MeshCache> meshCache,
+	const std::span<const T> elements)
+{
+	return [meshCache = std::move(meshCache),
+	        elements](const std::span<std::byte> destination,
+	                  const vk::DeviceSize sourceOffset) {
+		std::ranges::copy(
+			std::as_bytes(elements).subspan(sourceOffset, destination.size()),
+			destination.data());
+	};
+}
+
+// Axis aligned bounds, reduced in parallel over the vertices
+struct Bounds
+{
+	QVector3D Min{ std::numeric_limits<float>::max(),
+		           std::numeric_limits<float>::max(),
+		           std::numeric_limits<float>::max() };
+	QVector3D Max{ std::numeric_limits<float>::lowest(),
+		           std::numeric_limits<float>::lowest(),
+		           std::numeric_limits<float>::lowest() };
+};
+
+[[nodiscard]] Bounds MergeBounds(const Bounds& lhs, const Bounds& rhs)
+{
+	return Bounds{
+		.Min = QVector3D{ std::min(lhs.Min.x(), rhs.Min.x()),
+		                  std::min(lhs.Min.y(), rhs.Min.y()),
+		                  std::min(lhs.Min.z(), rhs.Min.z()) },
+		.Max = QVector3D{ std::max(lhs.Max.x(), rhs.Max.x()),
+		                  std::max(lhs.Max.y(), rhs.Max.y()),
+		                  std::max(lhs.Max.z(), rhs.Max.z()) },
+	};
+}
+
+template <typename T, typename PositionFn>
+[[nodiscard]] Bounds ComputeBounds(const std::span<const T> elements,
+                                   PositionFn positionFn)
+{
+	const auto toBounds = [&positionFn](const T& element) {
+		const QVector3D position = positionFn(element);
+		return Bounds{ .Min = position, .Max = position };
+	};
+	return std::transform_reduce(std::execution::par_unseq, begin(elements),
+	                             end(elements), Bounds{}, &MergeBounds, toBounds);
+}
+
+[[nodiscard]] Bounds ComputeBounds(const ImportedScene& scene)
+{
+	Bounds bounds{};
+	for (const aiMesh* const mesh : scene.Meshes)
+	{
+		const std::span<const aiVector3D> positions{ mesh->mVertices,
+		                                             mesh->mNumVertices };
+		bounds = MergeBounds(
+			bounds, ComputeBounds(positions, [](const aiVector3D& vertex) {
+				return QVector3D{ vertex.x, vertex.y, vertex.z };
+			}));
+	}
+	return bounds;
+}
+
+// Loose sphere around the bounds, good enough for culling
+[[nodiscard]] QVector4D ToBoundingSphere(const Bounds& bounds)
+{
+	const QVector3D center = (bounds.Min + bounds.Max) / 2.F;
+	return QVector4D{ center, (bounds.Max - bounds.Min).length() / 2.F };
+}
+
+[[nodiscard]] std::shared_ptr<ImportedScene> ImportScene(
+	const std::filesystem::path& modelPath)
+{
+	auto importedScene = std::make_shared<ImportedScene>();
+	const aiScene* const scene =
+		importedScene->Importer.ReadFile(modelPath.string(), ImportFlags);
+	if (scene == nullptr)
+	{
+		throw std::runtime_error{ "Failed to load model" };
+	}
+
+	// Only polygons are rendered, mNumFaces * 3 is the index count per mesh
+	importedScene->Meshes = std::span{ scene->mMeshes, scene->mNumMeshes };
+	importedScene->VertexOffsets =
+		ComputeOffsets(importedScene->Meshes, [](const aiMesh* const mesh) {
+			return mesh->mNumVertices;
+		});
+	importedScene->IndexOffsets =
+		ComputeOffsets(importedScene->Meshes, [](const aiMesh* const mesh) {
+			return mesh->mNumFaces * 3U;
+		});
+
+	return importedScene;
+}
 } // namespace
 
 ModelManager::ModelManager()
@@ -47,187 +300,357 @@ ModelManager::~ModelManager() noexcept
 }
 
 void ModelManager::SetResouces(const vk::Device device,
-                               const vk::PhysicalDevice physicalDevice,
-                               const vk::CommandPool commandPool,
-                               const vk::Queue workQueue)
+                               DeviceMemoryAllocator& allocator,
+                               UploadContext& uploadContext,
+                               const std::uint32_t concurrentFrameCount)
 {
 	static_assert(std::is_trivially_copy_assignable_v<vk::Device>);
-	static_assert(std::is_trivially_copy_assignable_v<vk::PhysicalDevice>);
-	static_assert(std::is_trivially_copy_assignable_v<vk::CommandPool>);
-	static_assert(std::is_trivially_copy_assignable_v<vk::Queue>);
 
-	m_Device         = device;
-	m_PhysicalDevice = physicalDevice;
-	m_CommandPool    = commandPool;
-	m_WorkQueue      = workQueue;
+	m_Device               = device;
+	m_Allocator            = &allocator;
+	m_UploadContext        = &uploadContext;
+	m_ConcurrentFrameCount = concurrentFrameCount;
+	m_InstanceBuffers.resize(concurrentFrameCount);
+	m_Geometry.emplace(device, allocator, uploadContext);
 }
 
 void ModelManager::LoadModel(const std::string_view modelName,
-							 const std::filesystem::path& modelPath)
+                             const std::filesystem::path& modelPath)
 {
-	Assimp::Importer modelImpoter{};
-	const aiScene* const scene =
-		modelImpoter.ReadFile(modelPath.string(), ImportFlags);
-	if (scene == nullptr)
+	CPU_TRACE_SCOPE("LoadModel");
+	std::uint32_t vertexCount{};
+	std::uint32_t indexCount{};
+	Bounds bounds{};
+	UploadWriter vertexWriter{};
+	UploadWriter indexWriter{};
+
+	std::shared_ptr<const MeshCache> meshCache =
+		MeshCache::Open(modelPath, ImportFlags);
+	if (meshCache == nullptr)
 	{
-		throw std::runtime_error{ "Failed to load model" };
+		const std::shared_ptr<const ImportedScene> importedScene =
+			ImportScene(modelPath);
+		vertexCount = importedScene->VertexOffsets.back();
+		indexCount  = importedScene->IndexOffsets.back();
+
+		// Cold start, convert into a new cache entry the next run can map as is
+		meshCache = MeshCache::Create(
+			modelPath, ImportFlags, vertexCount, indexCount,
+			[&importedScene](const std::span<Vertex> vertices,
+		                     const std::span<std::uint32_t> indices) {
+				ConvertVertices(*importedScene, 0U, vertices);
+				ConvertIndices(*importedScene, 0U, indices);
+			});
+		if (meshCache == nullptr)
+		{
+			// Cache isn't writable, convert straight into the staging memory
+			bounds       = ComputeBounds(*importedScene);
+			vertexWriter = MakeVertexWriter(importedScene);
+			indexWriter  = MakeIndexWriter(importedScene);
+		}
 	}
 
-	const std::span sceneMeshes{ scene->mMeshes, scene->mNumMeshes };
-
-	// Reduce with different types is difficult D:
-
-	const std::uint32_t vertexCount = std::reduce(
-		std::execution::par_unseq, begin(sceneMeshes), end(sceneMeshes), 0U,
-		Overload{
-			[](const aiMesh* const lhs, const std::uint32_t rhs) {
-				return lhs->mNumVertices + rhs;
-			},
-			[](const std::uint32_t lhs, const aiMesh* const rhs) {
-				return lhs + rhs->mNumVertices;
-			},
-			[](const std::uint32_t lhs, const std::uint32_t rhs) {
-				return lhs + rhs;
-			},
-			[](const aiMesh* const lhs, const aiMesh* const rhs) {
-				return lhs->mNumVertices + rhs->mNumVertices;
-			},
-		});
-	const std::uint32_t indexCount = std::reduce(
-		std::execution::par_unseq, begin(sceneMeshes), end(sceneMeshes), 0U,
-		Overload{
-			[](const aiMesh* const lhs, const std::uint32_t rhs) {
-				return lhs->mNumFaces * 3 + rhs;
-			},
-			[](const std::uint32_t lhs, const aiMesh* const rhs) {
-				return lhs + rhs->mNumFaces * 3;
-			},
-			[](const std::uint32_t lhs, const std::uint32_t rhs) {
-				return lhs + rhs;
-			},
-			[](const aiMesh* const lhs, const aiMesh* const rhs) {
-				return lhs->mNumFaces * 3 + rhs->mNumFaces * 3;
-			},
-		});
+	if (meshCache != nullptr)
+	{
+		vertexCount  = static_cast<std::uint32_t>(meshCache->GetVertices().size());
+		indexCount   = static_cast<std::uint32_t>(meshCache->GetIndices().size());
+		bounds       = ComputeBounds(meshCache->GetVertices(),
+		                             std::mem_fn(&Vertex::GetPosition));
+		vertexWriter = MakeCacheWriter(meshCache, meshCache->GetVertices());
+		indexWriter  = MakeCacheWriter(meshCache, meshCache->GetIndices());
+	}
 
-	const vk::DeviceSize vertexBufferSize =
-		static_cast<vk::DeviceSize>(vertexCount) * sizeof(Vertex);
-	const vk::DeviceSize indexBufferSize =
-		static_cast<vk::DeviceSize>(indexCount) * sizeof(std::uint32_t);
+	const GeometryHandle geometry = m_Geometry->Allocate(vertexCount, indexCount);
+	const GeometryRange& range    = m_Geometry->GetRange(geometry);
 
-	const auto [vertexStagingBuffer, vertexStagingMemory] = CreateDeviceBuffer(
-		vertexBufferSize,
-		vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferSrc },
-		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible |
-								 vk::MemoryPropertyFlagBits::eHostCoherent },
-		m_Device, m_PhysicalDevice);
+	// Large models get streamed over several frames, the writers keep their
+	// source (scene or mapped cache) alive until the last chunk has been written
+	m_UploadContext->UploadBuffer(
+		BufferUploadInfo{
+			.DstBuffer   = m_Geometry->GetVertexBuffer(),
+			.DstOffset   = vk::DeviceSize{ range.FirstVertex } * sizeof(Vertex),
+			.Size        = vk::DeviceSize{ vertexCount } * sizeof(Vertex),
+			.Granularity = sizeof(Vertex),
+			.DstStage    = vk::PipelineStageFlagBits::eVertexInput,
+			.DstAccess   = vk::AccessFlagBits::eVertexAttributeRead,
+		},
+		std::move(vertexWriter));
+	// Uploads finish in order, once the indices are done the model is usable
+	const UploadId upload = m_UploadContext->UploadBuffer(
+		BufferUploadInfo{
+			.DstBuffer   = m_Geometry->GetIndexBuffer(),
+			.DstOffset   = vk::DeviceSize{ range.FirstIndex } * IndexSize,
+			.Size        = vk::DeviceSize{ indexCount } * IndexSize,
+			.Granularity = IndexSize,
+			.DstStage    = vk::PipelineStageFlagBits::eVertexInput,
+			.DstAccess   = vk::AccessFlagBits::eIndexRead,
+		},
+		std::move(indexWriter));
 
-	const auto [indexStagingBuffer, indexStagingMemory] = CreateDeviceBuffer(
-		indexBufferSize,
-		vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferSrc },
+	m_LoadedModels.push_back(Model{
+		.ModelName      = std::string{ modelName },
+		.VertexCount    = vertexCount,
+		.IndexCount     = indexCount,
+		.Geometry       = geometry,
+		.Upload         = upload,
+		.BoundingSphere = ToBoundingSphere(bounds),
+	});
+}
+
+void ModelManager::UnloadModel(const std::string_view modelName)
+{
+	Model& model = FindModel(modelName);
+	// Might compact the geometry, which waits for the frames in flight
+	m_Geometry->Free(model.Geometry);
+
+	m_LoadedModels.erase(m_LoadedModels.begin() + (&model - m_LoadedModels.data()));
+	for (std::vector<const Model*>& culledModels : m_CulledModels)
+	{
+		culledModels.clear();
+	}
+}
+
+Model& ModelManager::FindModel(const std::string_view modelName)
+{
+	const auto model =
+		std::ranges::find(m_LoadedModels, modelName, &Model::ModelName);
+	if (model == end(m_LoadedModels))
+	{
+		throw std::runtime_error{ fmt::format("Model {} isn't loaded", modelName) };
+	}
+	return *model;
+}
+
+ModelInstance ModelManager::AddInstance(const std::string_view modelName,
+                                        const QMatrix4x4& transform)
+{
+	Model& model = FindModel(modelName);
+	model.Instances.push_back(InstanceData{ transform.toGenericMatrix<4, 4>() });
+
+	return ModelInstance{
+		.ModelIndex    = static_cast<std::size_t>(&model - m_LoadedModels.data()),
+		.InstanceIndex = model.Instances.size() - 1U,
+	};
+}
+
+void ModelManager::SetInstanceTransform(const ModelInstance instance,
+                                        const QMatrix4x4& transform)
+{
+	m_LoadedModels.at(instance.ModelIndex).Instances.at(instance.InstanceIndex) =
+		InstanceData{ transform.toGenericMatrix<4, 4>() };
+}
+
+void ModelManager::SetModelTransform(const std::string_view modelName,
+                                     const QMatrix4x4& transform)
+{
+	FindModel(modelName).Transform = transform.toGenericMatrix<4, 4>();
+}
+
+void ModelManager::ClearInstances(const std::string_view modelName)
+{
+	FindModel(modelName).Instances.clear();
+}
+
+void ModelManager::ReserveInstances(InstanceBuffer& instanceBuffer,
+                                    const std::size_t instanceCount)
+{
+	constexpr std::size_t MinimumCapacity = 64U;
+	if (instanceCount <= instanceBuffer.Capacity)
+	{
+		return;
+	}
+
+	// The previous buffer belongs to the same frame, the GPU is done with it
+	if (instanceBuffer.Buffer)
+	{
+		m_Device.destroy(instanceBuffer.Buffer);
+		m_Allocator->Free(instanceBuffer.Allocation);
+	}
+
+	instanceBuffer.Capacity =
+		std::bit_ceil(std::max(instanceCount, MinimumCapacity));
+	std::tie(instanceBuffer.Buffer, instanceBuffer.Allocation) = CreateDeviceBuffer(
+		instanceBuffer.Capacity * sizeof(InstanceData),
+		vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eVertexBuffer },
 		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible |
-								 vk::MemoryPropertyFlagBits::eHostCoherent },
-		m_Device, m_PhysicalDevice);
-
-	// Apparently the copy operations need to be done in one go
-	// always?
-	std::vector<Vertex> vertices{};
-	vertices.reserve(vertexCount);
-	std::vector<unsigned int> indices{};
-	indices.reserve(indexCount);
-
-	for (const aiMesh* const mesh : sceneMeshes)
-	{
-		const std::span<const aiVector3D> meshVertices{ mesh->mVertices,
-												  mesh->mNumVertices };
-		const std::span<const aiVector3D> meshTextureCoords{ mesh->mTextureCoords[0],
-													   mesh->mNumVertices };
-
-		constexpr auto TransformFn = [](const auto& zipElement) {
-			const auto& [vertex, textureCoord] = zipElement;
-			assert(0.F <= textureCoord.x && textureCoord.x <= 1.F);
-			assert(0.F <= textureCoord.y && textureCoord.y <= 1.F);
-			assert(0.F <= textureCoord.z && textureCoord.z <= 1.F);
-			return Vertex{
-				.Position          = { vertex[0], vertex[1], vertex[2] },
-				.Color             = { 1.F, 1.F, 1.F },
-				.TextureCoordinate = { textureCoord.x, textureCoord.y },
-			};
-		};
-		std::ranges::transform(
-			std::ranges::views::zip(meshVertices, meshTextureCoords),
-			std::back_inserter(vertices), TransformFn);
+		                         vk::MemoryPropertyFlagBits::eHostCoherent },
+		m_Device, *m_Allocator);
+}
 
-		const std::span meshFaces{ mesh->mFaces, mesh->mNumFaces };
-		for (const aiFace& face : meshFaces)
+std::vector<const Model*> ModelManager::GetDrawableModels() const
+{
+	std::vector<const Model*> models{};
+	for (const Model& model : m_LoadedModels)
+	{
+		if (!model.Instances.empty() &&
+		    m_UploadContext->IsUploadComplete(model.Upload))
 		{
-			std::ranges::copy(std::span{ face.mIndices, face.mNumIndices },
-							  std::back_inserter(indices));
+			models.push_back(&model);
 		}
 	}
+	return models;
+}
+
+void ModelManager::EnableGpuCulling(const vk::ShaderModule cullShader,
+                                    const vk::PipelineCache pipelineCache)
+{
+	m_Culler.emplace(m_Device, *m_Allocator, m_ConcurrentFrameCount, cullShader,
+	                 pipelineCache);
+	m_CulledModels.resize(m_ConcurrentFrameCount);
+}
+
+void ModelManager::CullAllModels(const vk::CommandBuffer commandBuffer,
+                                 const std::uint32_t frameIndex,
+                                 const vk::Buffer uniformBuffer,
+                                 const GpuProfileRange& profileRange)
+{
+	assert(m_Culler.has_value());
+	const GpuProfileScope profileScope{ profileRange, "Cull" };
+
+	std::vector<const Model*>& models = m_CulledModels.at(frameIndex);
+	models                            = GetDrawableModels();
+	m_Culler->Cull(commandBuffer, frameIndex, models, *m_Geometry, uniformBuffer);
+}
+
+void ModelManager::RenderAllModels(const vk::CommandBuffer commandBuffer,
+                                   const std::uint32_t frameIndex,
+                                   const vk::PipelineLayout pipelineLayout,
+                                   const GpuProfileRange& profileRange)
+{
+	if (m_Culler.has_value())
+	{
+		// The cull pass already applied the model transforms to the instances
+		PushModelTransform(commandBuffer, pipelineLayout, MatrixF4{});
+
+		const GpuProfileScope profileScope{ profileRange, "Draw indirect" };
+		m_Culler->Draw(commandBuffer, frameIndex, m_CulledModels.at(frameIndex),
+		               *m_Geometry);
+		return;
+	}
 
-	void* const vertexPtr =
-		m_Device.mapMemory(vertexStagingMemory, vk::DeviceSize{ 0 },
-						   vertexBufferSize, vk::MemoryMapFlags{});
-	void* const indexPtr =
-		m_Device.mapMemory(indexStagingMemory, vk::DeviceSize{ 0 }, indexBufferSize,
-						   vk::MemoryMapFlags{});
+	const std::vector<const Model*> models     = GetDrawableModels();
+	const std::span<InstanceData> instanceData = MapInstances(frameIndex, models);
+	if (instanceData.empty())
+	{
+		return;
+	}
 
-	std::memcpy(vertexPtr, vertices.data(), vertexBufferSize);
-	std::memcpy(indexPtr, indices.data(), indexBufferSize);
+	DrawModels(commandBuffer, frameIndex, pipelineLayout, models, instanceData, 0U,
+	           profileRange);
+}
 
-	m_Device.unmapMemory(indexStagingMemory);
-	m_Device.unmapMemory(vertexStagingMemory);
+std::vector<vk::CommandBuffer> ModelManager::RecordAllModels(
+	ParallelRecorder& recorder,
+	const std::uint32_t frameIndex,
+	const vk::CommandBufferInheritanceInfo& inheritance,
+	const vk::PipelineLayout pipelineLayout,
+	const ParallelRecorder::RecordFn& bindStateFn)
+{
+	assert(!m_Culler.has_value());
 
-	const auto [vertexBuffer, vertexBufferMemory] = CreateDeviceBuffer(
-		vertexBufferSize,
-		vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferDst |
-							  vk::BufferUsageFlagBits::eVertexBuffer },
-		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
-		m_Device, m_PhysicalDevice);
+	const std::vector<const Model*> models     = GetDrawableModels();
+	const std::span<InstanceData> instanceData = MapInstances(frameIndex, models);
+	if (instanceData.empty())
+	{
+		return {};
+	}
 
-	const auto [indexBuffer, indexBufferMemory] = CreateDeviceBuffer(
-		indexBufferSize,
-		vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferDst |
-							  vk::BufferUsageFlagBits::eIndexBuffer },
-		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
-		m_Device, m_PhysicalDevice);
+	// Contiguous chunks of models, so each job writes its own part of the
+	// instance buffer
+	const std::size_t threadCount = recorder.GetThreadCount();
+	const std::size_t chunkSize = (models.size() + threadCount - 1U) / threadCount;
+	std::vector<ParallelRecorder::RecordFn> jobs{};
+	std::uint32_t firstInstance{ 0U };
+	for (std::size_t first{ 0U }; first < models.size(); first += chunkSize)
+	{
+		const std::span<const Model* const> chunk = std::span{ models }.subspan(
+			first, std::min(chunkSize, models.size() - first));
+		jobs.emplace_back([=, this, &bindStateFn](const vk::CommandBuffer buffer) {
+			bindStateFn(buffer);
+			DrawModels(buffer, frameIndex, pipelineLayout, chunk, instanceData,
+			           firstInstance, GpuProfileRange{});
+		});
+		for (const Model* const model : chunk)
+		{
+			firstInstance += static_cast<std::uint32_t>(model->Instances.size());
+		}
+	}
+	return recorder.Record(frameIndex, inheritance, jobs);
+}
 
-	CopyBuffer(vertexBuffer, vertexStagingBuffer, vertexBufferSize, m_CommandPool,
-			   m_Device, m_WorkQueue);
-	CopyBuffer(indexBuffer, indexStagingBuffer, indexBufferSize, m_CommandPool,
-			   m_Device, m_WorkQueue);
+std::span<InstanceData> ModelManager::MapInstances(
+	const std::uint32_t frameIndex,
+	const std::span<const Model* const> models)
+{
+	std::size_t instanceCount{ 0U };
+	for (const Model* const model : models)
+	{
+		instanceCount += model->Instances.size();
+	}
+	if (instanceCount == 0U)
+	{
+		return {};
+	}
 
-	m_Device.free(indexStagingMemory);
-	m_Device.destroy(indexStagingBuffer);
-	m_Device.free(vertexStagingMemory);
-	m_Device.destroy(vertexStagingBuffer);
+	InstanceBuffer& instanceBuffer = m_InstanceBuffers.at(frameIndex);
+	ReserveInstances(instanceBuffer, instanceCount);
 
-	m_LoadedModels.emplace_back(std::string{ modelName }, vertexCount, vertexBuffer,
-								vertexBufferMemory, indexCount, indexBuffer,
-								indexBufferMemory);
+	// Host visible blocks are persistently mapped by the allocator
+	return std::span{
+		static_cast<InstanceData*>(instanceBuffer.Allocation.MappedData),
+		instanceCount,
+	};
 }
 
-void ModelManager::RenderAllModels(vk::CommandBuffer commandBuffer) const
+void ModelManager::DrawModels(const vk::CommandBuffer commandBuffer,
+                              const std::uint32_t frameIndex,
+                              const vk::PipelineLayout pipelineLayout,
+                              const std::span<const Model* const> models,
+                              const std::span<InstanceData> instanceData,
+                              std::uint32_t firstInstance,
+                              const GpuProfileRange& profileRange) const
 {
 	constexpr vk::DeviceSize Offset{ 0 };
-	for (const Model& model : m_LoadedModels)
+	commandBuffer.bindVertexBuffers(InstanceData::Binding,
+	                                { m_InstanceBuffers.at(frameIndex).Buffer },
+	                                { Offset });
+	m_Geometry->Bind(commandBuffer);
+
+	for (const Model* const model : models)
 	{
-		commandBuffer.bindVertexBuffers(0, { model.VertexBuffer }, { Offset });
-		commandBuffer.bindIndexBuffer(model.IndexBuffer, 0, vk::IndexType::eUint32);
+		std::ranges::copy(model->Instances,
+		                  instanceData.subspan(firstInstance).begin());
+
+		const GeometryRange& range = m_Geometry->GetRange(model->Geometry);
+		const auto modelInstanceCount =
+			static_cast<std::uint32_t>(model->Instances.size());
+		PushModelTransform(commandBuffer, pipelineLayout, model->Transform);
 
-		commandBuffer.drawIndexed(model.IndexCount, 1, 0, 0, 0);
+		const GpuProfileScope profileScope{ profileRange, model->ModelName };
+		commandBuffer.drawIndexed(range.IndexCount, modelInstanceCount,
+		                          range.FirstIndex,
+		                          static_cast<std::int32_t>(range.FirstVertex),
+		                          firstInstance);
+		firstInstance += modelInstanceCount;
 	}
 }
 
 void ModelManager::UnloadAllModels()
 {
-	for (const Model& model : m_LoadedModels)
+	// Its buffers come from the same allocator
+	m_Culler.reset();
+	m_CulledModels.clear();
+
+	m_LoadedModels.clear();
+	m_Geometry.reset();
+
+	for (InstanceBuffer& instanceBuffer : m_InstanceBuffers)
 	{
-		m_Device.destroy(model.IndexBuffer);
-		m_Device.destroy(model.VertexBuffer);
-		m_Device.free(model.IndexBufferMemory);
-		m_Device.free(model.VertexBufferMemory);
+		if (instanceBuffer.Buffer)
+		{
+			m_Device.destroy(instanceBuffer.Buffer);
+			m_Allocator->Free(instanceBuffer.Allocation);
+		}
+		instanceBuffer = InstanceBuffer{};
 	}
-	m_LoadedModels.clear();
 }
@@ -0,0 +1,353 @@
+#include <VulkanTutorial/OffscreenTarget.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+#include <VulkanTutorial/VulkanInstance.h>
+
+#include <fmt/core.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+OffscreenTarget::OffscreenTarget(const VulkanInstance& instance,
+                                 const vk::Extent2D extent,
+                                 const std::uint32_t frameCount)
+	: m_Device{ instance.GetDevice() }
+	, m_PhysicalDevice{ instance.GetPhysicalDevice() }
+	, m_Queue{ instance.GetWorkQueue() }
+	, m_QueueFamily{ instance.GetWorkQueueFamily() }
+	, m_TransferQueue{ instance.GetTransferQueue() }
+	, m_TransferQueueFamily{ instance.GetTransferQueueFamily() }
+	, m_DynamicRendering{ instance.IsDynamicRenderingEnabled() }
+	, m_Extent{ extent }
+	, m_Allocator{ m_Device, m_PhysicalDevice }
+	, m_CommandPool{ m_Device.createCommandPool(vk::CommandPoolCreateInfo{
+		  .flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		  .queueFamilyIndex = m_QueueFamily,
+	  }) }
+	, m_Frames(frameCount)
+{
+	if (frameCount == 0U || frameCount > MaxFrameCount)
+	{
+		m_Device.destroy(m_CommandPool);
+		throw std::runtime_error{ fmt::format(
+			"Between 1 and {} frames can be in flight, not {}", MaxFrameCount,
+			frameCount) };
+	}
+	const std::vector<vk::CommandBuffer> commandBuffers =
+		m_Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+			.commandPool        = m_CommandPool,
+			.level              = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = frameCount,
+		});
+	assert(commandBuffers.size() == frameCount);
+
+	for (std::uint32_t i{ 0U }; i < frameCount; ++i)
+	{
+		Frame& frame = m_Frames.at(i);
+		frame.Color = CreateAttachment(
+			ColorFormat, vk::SampleCountFlagBits::e1,
+			vk::ImageUsageFlagBits::eColorAttachment |
+				vk::ImageUsageFlagBits::eTransferSrc,
+			vk::ImageAspectFlagBits::eColor);
+		frame.CommandBuffer = commandBuffers.at(i);
+		// Signaled, so the first BeginFrame doesn't wait
+		frame.Fence = m_Device.createFence(vk::FenceCreateInfo{
+			.flags = vk::FenceCreateFlagBits::eSignaled,
+		});
+	}
+}
+
+OffscreenTarget::~OffscreenTarget() noexcept
+{
+	try
+	{
+		WaitIdle();
+	}
+	catch (const vk::SystemError&)
+	{
+		// Device lost, nothing left to wait for
+	}
+
+	for (const Frame& frame : m_Frames)
+	{
+		DestroyAttachment(frame.Color);
+		m_Device.destroy(frame.Fence);
+	}
+	// Frees all the command buffers allocated from it as well
+	m_Device.destroy(m_CommandPool);
+}
+
+OffscreenTarget::Attachment OffscreenTarget::CreateAttachment(
+	const vk::Format format,
+	const vk::SampleCountFlagBits samples,
+	const vk::ImageUsageFlags usage,
+	const vk::ImageAspectFlags aspect)
+{
+	Attachment attachment{};
+	std::tie(attachment.Image, attachment.Allocation) = CreateDeviceImage(
+		vk::ImageCreateInfo{
+			.imageType     = vk::ImageType::e2D,
+			.format        = format,
+			.extent        = vk::Extent3D{ m_Extent.width, m_Extent.height, 1U },
+			.mipLevels     = 1U,
+			.arrayLayers   = 1U,
+			.samples       = samples,
+			.tiling        = vk::ImageTiling::eOptimal,
+			.usage         = usage,
+			.sharingMode   = vk::SharingMode::eExclusive,
+			.initialLayout = vk::ImageLayout::eUndefined,
+		},
+		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
+		m_Device, m_Allocator);
+
+	attachment.View = m_Device.createImageView(vk::ImageViewCreateInfo{
+		.image    = attachment.Image,
+		.viewType = vk::ImageViewType::e2D,
+		.format   = format,
+		.subresourceRange =
+			vk::ImageSubresourceRange{
+				.aspectMask     = aspect,
+				.baseMipLevel   = 0U,
+				.levelCount     = 1U,
+				.baseArrayLayer = 0U,
+				.layerCount     = 1U,
+			},
+	});
+	return attachment;
+}
+
+void OffscreenTarget::DestroyAttachment(const Attachment& attachment) noexcept
+{
+	m_Device.destroy(attachment.View);
+	m_Device.destroy(attachment.Image);
+	m_Allocator.Free(attachment.Allocation);
+}
+
+void OffscreenTarget::BeginFrame()
+{
+	const Frame& frame      = m_Frames.at(m_CurrentFrame);
+	const vk::Result result = m_Device.waitForFences(
+		vk::ArrayProxy{ frame.Fence }, vk::True,
+		std::numeric_limits<std::uint64_t>::max());
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error{ "Failed to wait for frame fence" };
+	}
+	m_Device.resetFences(vk::ArrayProxy{ frame.Fence });
+
+	frame.CommandBuffer.reset();
+	frame.CommandBuffer.begin(vk::CommandBufferBeginInfo{
+		.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+	});
+}
+
+void OffscreenTarget::FrameReady()
+{
+	const Frame& frame = m_Frames.at(m_CurrentFrame);
+	frame.CommandBuffer.end();
+	m_Queue.submit(
+		vk::ArrayProxy{
+			vk::SubmitInfo{
+				.commandBufferCount = 1,
+				.pCommandBuffers    = &frame.CommandBuffer,
+			},
+		},
+		frame.Fence);
+
+	m_LastSubmittedFrame = m_CurrentFrame;
+	m_CurrentFrame       = (m_CurrentFrame + 1U) % GetConcurrentFrameCount();
+}
+
+void OffscreenTarget::WaitIdle() const
+{
+	m_Queue.waitIdle();
+}
+
+QImage OffscreenTarget::Capture()
+{
+	if (!m_LastSubmittedFrame.has_value())
+	{
+		throw std::runtime_error{ "Nothing has been rendered to capture" };
+	}
+
+	constexpr vk::DeviceSize TexelSize = 4U;
+	const vk::DeviceSize imageSize =
+		vk::DeviceSize{ m_Extent.width } * m_Extent.height * TexelSize;
+	const auto [readbackBuffer, readbackAllocation] = CreateDeviceBuffer(
+		imageSize,
+		vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferDst },
+		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible |
+		                         vk::MemoryPropertyFlagBits::eHostCoherent },
+		m_Device, m_Allocator);
+
+	const std::vector<vk::CommandBuffer> commandBuffers =
+		m_Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+			.commandPool        = m_CommandPool,
+			.level              = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = 1,
+		});
+	const vk::CommandBuffer commandBuffer = commandBuffers.at(0);
+	commandBuffer.begin(vk::CommandBufferBeginInfo{
+		.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+	});
+
+	// Rendering already left the image in the transfer layout, only the
+	// resolve writes have to be made visible
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags{},
+		vk::ArrayProxy<const vk::MemoryBarrier>{
+			vk::MemoryBarrier{
+				.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+				.dstAccessMask = vk::AccessFlagBits::eTransferRead,
+			},
+		},
+		vk::ArrayProxy<const vk::BufferMemoryBarrier>{},
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{});
+	commandBuffer.copyImageToBuffer(
+		m_Frames.at(*m_LastSubmittedFrame).Color.Image,
+		vk::ImageLayout::eTransferSrcOptimal, readbackBuffer,
+		vk::ArrayProxy{
+			vk::BufferImageCopy{
+				.bufferOffset      = 0U,
+				.bufferRowLength   = 0U,
+				.bufferImageHeight = 0U,
+				.imageSubresource =
+					vk::ImageSubresourceLayers{
+						.aspectMask     = vk::ImageAspectFlagBits::eColor,
+						.mipLevel       = 0U,
+						.baseArrayLayer = 0U,
+						.layerCount     = 1U,
+					},
+				.imageOffset = vk::Offset3D{ 0, 0, 0 },
+				.imageExtent =
+					vk::Extent3D{ m_Extent.width, m_Extent.height, 1U },
+			},
+		});
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+		vk::DependencyFlags{},
+		vk::ArrayProxy<const vk::MemoryBarrier>{
+			vk::MemoryBarrier{
+				.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+				.dstAccessMask = vk::AccessFlagBits::eHostRead,
+			},
+		},
+		vk::ArrayProxy<const vk::BufferMemoryBarrier>{},
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{});
+	commandBuffer.end();
+
+	m_Queue.submit(vk::ArrayProxy{
+		vk::SubmitInfo{
+			.commandBufferCount = 1,
+			.pCommandBuffers    = &commandBuffer,
+		},
+	});
+	WaitIdle();
+
+	QImage image{ static_cast<int>(m_Extent.width),
+		          static_cast<int>(m_Extent.height), QImage::Format_RGBA8888 };
+	const auto rowSize = static_cast<std::size_t>(m_Extent.width * TexelSize);
+	for (int y{ 0 }; y < image.height(); ++y)
+	{
+		const std::size_t rowOffset = static_cast<std::size_t>(y) * rowSize;
+		std::memcpy(image.scanLine(y),
+		            static_cast<const std::byte*>(readbackAllocation.MappedData) +
+		                rowOffset,
+		            rowSize);
+	}
+
+	m_Device.freeCommandBuffers(m_CommandPool, vk::ArrayProxy{ commandBuffer });
+	m_Device.destroy(readbackBuffer);
+	m_Allocator.Free(readbackAllocation);
+	return image;
+}
+
+vk::Device OffscreenTarget::GetDevice() const
+{
+	return m_Device;
+}
+
+vk::PhysicalDevice OffscreenTarget::GetPhysicalDevice() const
+{
+	return m_PhysicalDevice;
+}
+
+vk::Queue OffscreenTarget::GetGraphicsQueue() const
+{
+	return m_Queue;
+}
+
+std::uint32_t OffscreenTarget::GetGraphicsQueueFamily() const
+{
+	return m_QueueFamily;
+}
+
+std::uint32_t OffscreenTarget::GetConcurrentFrameCount() const
+{
+	return static_cast<std::uint32_t>(m_Frames.size());
+}
+
+vk::Format OffscreenTarget::GetColorFormat() const
+{
+	return ColorFormat;
+}
+
+vk::ImageLayout OffscreenTarget::GetFinalLayout() const
+{
+	// Ready to be copied out by Capture
+	return vk::ImageLayout::eTransferSrcOptimal;
+}
+
+bool OffscreenTarget::IsDynamicRenderingEnabled() const
+{
+	return m_DynamicRendering;
+}
+
+vk::Queue OffscreenTarget::GetTransferQueue() const
+{
+	return m_TransferQueue;
+}
+
+std::uint32_t OffscreenTarget::GetTransferQueueFamily() const
+{
+	return m_TransferQueueFamily;
+}
+
+vk::Extent2D OffscreenTarget::GetExtent() const
+{
+	return m_Extent;
+}
+
+std::uint32_t OffscreenTarget::GetImageCount() const
+{
+	return static_cast<std::uint32_t>(m_Frames.size());
+}
+
+vk::ImageView OffscreenTarget::GetColorView(const std::uint32_t idx) const
+{
+	return m_Frames.at(idx).Color.View;
+}
+
+vk::Image OffscreenTarget::GetColorImage(const std::uint32_t idx) const
+{
+	return m_Frames.at(idx).Color.Image;
+}
+
+std::uint32_t OffscreenTarget::GetCurrentFrame() const
+{
+	return m_CurrentFrame;
+}
+
+std::uint32_t OffscreenTarget::GetCurrentImage() const
+{
+	return m_CurrentFrame;
+}
+
+vk::CommandBuffer OffscreenTarget::GetCurrentCommandBuffer() const
+{
+	return m_Frames.at(m_CurrentFrame).CommandBuffer;
+}
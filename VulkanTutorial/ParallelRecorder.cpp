@@ -0,0 +1,166 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/ParallelRecorder.h>
+
+#include <utility>
+
+ParallelRecorder::ParallelRecorder(const vk::Device device,
+                                   const std::uint32_t queueFamilyIndex,
+                                   const std::uint32_t concurrentFrameCount,
+                                   const std::uint32_t threadCount)
+	: m_Device{ device }
+	, m_ThreadFrames(threadCount)
+{
+	for (std::vector<ThreadFrame>& threadFrames : m_ThreadFrames)
+	{
+		threadFrames.resize(concurrentFrameCount);
+		for (ThreadFrame& threadFrame : threadFrames)
+		{
+			threadFrame.CommandPool =
+				m_Device.createCommandPool(vk::CommandPoolCreateInfo{
+					.flags            = vk::CommandPoolCreateFlagBits::eTransient,
+					.queueFamilyIndex = queueFamilyIndex,
+				});
+		}
+	}
+
+	m_Workers.reserve(threadCount);
+	for (std::uint32_t i{ 0U }; i < threadCount; ++i)
+	{
+		m_Workers.emplace_back([this, i](const std::stop_token& stopToken) {
+			RunWorker(stopToken, i);
+		});
+	}
+}
+
+ParallelRecorder::~ParallelRecorder() noexcept
+{
+	m_Workers.clear();
+
+	// Frees the command buffers as well
+	for (const std::vector<ThreadFrame>& threadFrames : m_ThreadFrames)
+	{
+		for (const ThreadFrame& threadFrame : threadFrames)
+		{
+			m_Device.destroy(threadFrame.CommandPool);
+		}
+	}
+}
+
+std::vector<vk::CommandBuffer> ParallelRecorder::Record(
+	const std::uint32_t frameIndex,
+	const vk::CommandBufferInheritanceInfo& inheritance,
+	const std::span<const RecordFn> jobs)
+{
+	std::vector<vk::CommandBuffer> commandBuffers(jobs.size());
+	if (jobs.empty())
+	{
+		return commandBuffers;
+	}
+
+	// The workers are idle, so nobody else is using the pools
+	for (std::vector<ThreadFrame>& threadFrames : m_ThreadFrames)
+	{
+		ThreadFrame& threadFrame = threadFrames.at(frameIndex);
+		m_Device.resetCommandPool(threadFrame.CommandPool);
+		threadFrame.UsedCount = 0U;
+	}
+
+	{
+		const std::scoped_lock lock{ m_Mutex };
+		m_Batch = Batch{
+			.FrameIndex     = frameIndex,
+			.Inheritance    = &inheritance,
+			.Jobs           = jobs,
+			.CommandBuffers = commandBuffers,
+		};
+		m_BusyWorkers = GetThreadCount();
+		++m_Generation;
+	}
+	m_BatchStarted.notify_all();
+
+	std::unique_lock lock{ m_Mutex };
+	m_BatchFinished.wait(lock, [this] { return m_BusyWorkers == 0U; });
+	m_Batch = Batch{};
+	if (m_Error)
+	{
+		std::rethrow_exception(std::exchange(m_Error, nullptr));
+	}
+	return commandBuffers;
+}
+
+void ParallelRecorder::RunWorker(const std::stop_token& stopToken,
+                                 const std::uint32_t workerIndex)
+{
+	CPU_TRACE_THREAD_NAME("ParallelRecorder");
+	std::uint64_t generation{ 0U };
+	while (true)
+	{
+		{
+			std::unique_lock lock{ m_Mutex };
+			if (!m_BatchStarted.wait(lock, stopToken, [this, generation] {
+				    return m_Generation != generation;
+			    }))
+			{
+				return;
+			}
+			generation = m_Generation;
+		}
+
+		std::exception_ptr error{};
+		try
+		{
+			RecordJobs(workerIndex);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		{
+			const std::scoped_lock lock{ m_Mutex };
+			if (error && !m_Error)
+			{
+				m_Error = error;
+			}
+			--m_BusyWorkers;
+		}
+		m_BatchFinished.notify_one();
+	}
+}
+
+void ParallelRecorder::RecordJobs(const std::uint32_t workerIndex)
+{
+	// Written before the batch started, and not changed until it has finished
+	const Batch& batch       = m_Batch;
+	ThreadFrame& threadFrame = m_ThreadFrames.at(workerIndex).at(batch.FrameIndex);
+
+	// Interleaved, neighbouring jobs tend to cost about the same
+	for (std::size_t i{ workerIndex }; i < batch.Jobs.size(); i += GetThreadCount())
+	{
+		CPU_TRACE_SCOPE("Record secondary");
+		const vk::CommandBuffer commandBuffer = Allocate(threadFrame);
+		commandBuffer.begin(vk::CommandBufferBeginInfo{
+			.flags            = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+			                    vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+			.pInheritanceInfo = batch.Inheritance,
+		});
+		batch.Jobs[i](commandBuffer);
+		commandBuffer.end();
+		batch.CommandBuffers[i] = commandBuffer;
+	}
+}
+
+vk::CommandBuffer ParallelRecorder::Allocate(ThreadFrame& threadFrame)
+{
+	if (threadFrame.UsedCount == threadFrame.CommandBuffers.size())
+	{
+		const std::vector<vk::CommandBuffer> allocated =
+			m_Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+				.commandPool        = threadFrame.CommandPool,
+				.level              = vk::CommandBufferLevel::eSecondary,
+				.commandBufferCount = 1U,
+			});
+		threadFrame.CommandBuffers.push_back(allocated.front());
+	}
+	return threadFrame.CommandBuffers.at(threadFrame.UsedCount++);
+}
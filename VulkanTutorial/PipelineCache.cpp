@@ -0,0 +1,148 @@
+#include <VulkanTutorial/PipelineCache.h>
+
+#include <QFile>
+#include <QSaveFile>
+
+#include <fmt/core.h>
+
+#include <array>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+constexpr std::array<char, 8> PipelineCacheMagic{
+	'V', 'T', 'P', 'I', 'P', 'E', '\0', '\0',
+};
+constexpr std::uint32_t PipelineCacheVersion = 1U;
+
+// Precedes the data returned by getPipelineCacheData
+struct PipelineCacheHeader
+{
+	std::array<char, 8> Magic{};
+	std::uint32_t Version{};
+	std::uint32_t VendorId{};
+	std::uint32_t DeviceId{};
+	std::uint32_t DriverVersion{};
+	std::array<std::uint8_t, VK_UUID_SIZE> PipelineCacheUuid{};
+	std::uint64_t DataSize{};
+};
+static_assert(std::is_trivially_copyable_v<PipelineCacheHeader>);
+
+[[nodiscard]] PipelineCacheHeader MakeHeader(
+	const vk::PhysicalDeviceProperties& properties)
+{
+	return PipelineCacheHeader{
+		.Magic             = PipelineCacheMagic,
+		.Version           = PipelineCacheVersion,
+		.VendorId          = properties.vendorID,
+		.DeviceId          = properties.deviceID,
+		.DriverVersion     = properties.driverVersion,
+		.PipelineCacheUuid = properties.pipelineCacheUUID,
+	};
+}
+
+// Returns the cache data if the file was written for this device and driver
+[[nodiscard]] std::vector<std::byte> LoadCacheData(
+	const std::filesystem::path& cachePath,
+	const vk::PhysicalDeviceProperties& properties)
+{
+	QFile file{ cachePath };
+	if (!file.open(QIODevice::OpenModeFlag::ReadOnly))
+	{
+		return {};
+	}
+
+	const QByteArray contents = file.readAll();
+	if (static_cast<std::size_t>(contents.size()) < sizeof(PipelineCacheHeader))
+	{
+		return {};
+	}
+
+	PipelineCacheHeader header{};
+	std::memcpy(&header, contents.constData(), sizeof(PipelineCacheHeader));
+
+	const PipelineCacheHeader expected = MakeHeader(properties);
+	const bool valid =
+		header.Magic == expected.Magic && header.Version == expected.Version &&
+		header.VendorId == expected.VendorId &&
+		header.DeviceId == expected.DeviceId &&
+		header.DriverVersion == expected.DriverVersion &&
+		header.PipelineCacheUuid == expected.PipelineCacheUuid &&
+		header.DataSize ==
+			static_cast<std::size_t>(contents.size()) - sizeof(PipelineCacheHeader);
+	if (!valid)
+	{
+		fmt::println("Ignoring pipeline cache {}, it was made for a different "
+		             "device or driver",
+		             cachePath.string());
+		return {};
+	}
+
+	const std::span<const std::byte> data =
+		std::as_bytes(std::span{ contents.constData(),
+		                         static_cast<std::size_t>(contents.size()) })
+			.subspan(sizeof(PipelineCacheHeader));
+	return std::vector<std::byte>(begin(data), end(data));
+}
+} // namespace
+
+PipelineCache::PipelineCache(const vk::Device device,
+                             const vk::PhysicalDevice physicalDevice,
+                             std::filesystem::path cachePath)
+	: m_Device{ device }
+	, m_DeviceProperties{ physicalDevice.getProperties() }
+	, m_CachePath{ std::move(cachePath) }
+{
+	const std::vector<std::byte> cacheData =
+		LoadCacheData(m_CachePath, m_DeviceProperties);
+	m_PipelineCache = m_Device.createPipelineCache(vk::PipelineCacheCreateInfo{
+		.initialDataSize = cacheData.size(),
+		.pInitialData    = cacheData.data(),
+	});
+}
+
+PipelineCache::~PipelineCache() noexcept
+{
+	try
+	{
+		Save();
+	}
+	catch (const std::exception& e)
+	{
+		// Only costs compile time on the next launch
+		fmt::println(stderr, "Failed to save pipeline cache: {}", e.what());
+	}
+	m_Device.destroy(m_PipelineCache);
+}
+
+void PipelineCache::Save() const
+{
+	const std::vector<std::uint8_t> cacheData =
+		m_Device.getPipelineCacheData(m_PipelineCache);
+
+	PipelineCacheHeader header = MakeHeader(m_DeviceProperties);
+	header.DataSize            = cacheData.size();
+
+	// Written to a temporary file and renamed over the old one on commit
+	QSaveFile file{ QString::fromStdString(m_CachePath.string()) };
+	if (!file.open(QIODevice::OpenModeFlag::WriteOnly))
+	{
+		throw std::runtime_error{ fmt::format("Failed to open {}: {}",
+		                                      m_CachePath.string(),
+		                                      file.errorString().toStdString()) };
+	}
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+	file.write(reinterpret_cast<const char*>(&header), sizeof(PipelineCacheHeader));
+	file.write(reinterpret_cast<const char*>(cacheData.data()),
+	           static_cast<qint64>(cacheData.size()));
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+	if (!file.commit())
+	{
+		throw std::runtime_error{ fmt::format("Failed to write {}: {}",
+		                                      m_CachePath.string(),
+		                                      file.errorString().toStdString()) };
+	}
+}
@@ -0,0 +1,368 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/PipelineLibrary.h>
+
+#include <QFile>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace
+{
+template <typename T>
+void HashCombine(std::size_t& seed, const T& value) noexcept
+{
+	// Same mixing as boost::hash_combine
+	constexpr std::size_t Golden = 0x9e3779b9U;
+	seed ^= std::hash<T>{}(value) + Golden + (seed << 6U) + (seed >> 2U);
+}
+
+// For plain Vulkan structs, which have no padding
+template <std::ranges::contiguous_range Range>
+void HashBytes(std::size_t& seed, const Range& values) noexcept
+{
+	using T = std::ranges::range_value_t<Range>;
+	static_assert(std::has_unique_object_representations_v<T>);
+	const std::string_view bytes{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		reinterpret_cast<const char*>(std::ranges::data(values)),
+		std::ranges::size(values) * sizeof(T),
+	};
+	HashCombine(seed, bytes);
+}
+
+[[nodiscard]] vk::ShaderModule LoadShader(const vk::Device device,
+                                          const std::filesystem::path& path)
+{
+	QFile file{ path };
+	if (!file.open(QIODevice::OpenModeFlag::ReadOnly))
+	{
+		throw std::runtime_error{
+			fmt::format("Failed to open {} shader file",
+			            std::filesystem::absolute(path).string()),
+		};
+	}
+	const QByteArray blob = file.readAll();
+
+	return device.createShaderModule(vk::ShaderModuleCreateInfo{
+		.codeSize = static_cast<std::size_t>(blob.size()),
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		.pCode = reinterpret_cast<const std::uint32_t*>(blob.constData()),
+	});
+}
+} // namespace
+
+std::size_t GraphicsPipelineStateHash::operator()(
+	const GraphicsPipelineState& state) const noexcept
+{
+	std::size_t seed{ 0U };
+	HashCombine(seed, std::filesystem::hash_value(state.VertexShader));
+	HashCombine(seed, std::filesystem::hash_value(state.FragmentShader));
+	HashBytes(seed, state.VertexBindings);
+	HashBytes(seed, state.VertexAttributes);
+	HashCombine(seed, state.Samples);
+	HashCombine(seed, static_cast<VkCullModeFlags>(state.CullMode));
+	HashCombine(seed, state.FrontFace);
+	HashCombine(seed, state.DepthTest);
+	HashCombine(seed, state.DepthWrite);
+	HashCombine(seed, state.DepthCompareOp);
+	HashBytes(seed, std::span{ &state.Blend, 1U });
+	HashBytes(seed, state.SpecializationConstants);
+	HashCombine(seed, static_cast<VkPipelineLayout>(state.Layout));
+	HashCombine(seed, static_cast<VkRenderPass>(state.RenderPass));
+	HashCombine(seed, state.ColorFormat);
+	HashCombine(seed, state.DepthStencilFormat);
+	return seed;
+}
+
+PipelineLibrary::PipelineLibrary(const vk::Device device,
+                                 const vk::PipelineCache pipelineCache,
+                                 const std::uint32_t threadCount)
+	: m_Device{ device }
+	, m_PipelineCache{ pipelineCache }
+{
+	m_Workers.reserve(threadCount);
+	for (std::uint32_t i{ 0U }; i < threadCount; ++i)
+	{
+		m_Workers.emplace_back(
+			[this](const std::stop_token& stopToken) { RunWorker(stopToken); });
+	}
+}
+
+PipelineLibrary::~PipelineLibrary() noexcept
+{
+	// Stop them all before joining any, the current compiles finish in parallel
+	for (std::jthread& worker : m_Workers)
+	{
+		worker.request_stop();
+	}
+	m_Workers.clear();
+	for (const Variant& variant : m_Variants)
+	{
+		m_Device.destroy(variant.Pipeline);
+	}
+}
+
+std::uint32_t PipelineLibrary::GetDefaultThreadCount() noexcept
+{
+	return std::max(std::thread::hardware_concurrency(), 2U) - 1U;
+}
+
+PipelineLibrary::VariantId PipelineLibrary::Request(
+	const GraphicsPipelineState& state)
+{
+	VariantId id{};
+	{
+		const std::scoped_lock lock{ m_Mutex };
+		const auto [it, inserted] =
+			m_VariantIds.try_emplace(state, m_Variants.size());
+		if (!inserted)
+		{
+			return it->second;
+		}
+		id = it->second;
+		m_Variants.push_back(Variant{ .State = state });
+		m_Pending.push_back(id);
+	}
+	m_VariantsRequested.notify_one();
+	return id;
+}
+
+vk::Pipeline PipelineLibrary::Get(const VariantId id)
+{
+	std::unique_lock lock{ m_Mutex };
+	const Variant& variant = m_Variants.at(id);
+	m_VariantCompiled.wait(lock, [&variant] { return variant.Compiled; });
+	if (variant.Error)
+	{
+		std::rethrow_exception(variant.Error);
+	}
+	return variant.Pipeline;
+}
+
+GraphicsPipelineState PipelineLibrary::GetState(const VariantId id) const
+{
+	const std::scoped_lock lock{ m_Mutex };
+	return m_Variants.at(id).State;
+}
+
+vk::Pipeline PipelineLibrary::Replace(const VariantId id,
+                                      const vk::Pipeline pipeline)
+{
+	const std::scoped_lock lock{ m_Mutex };
+	Variant& variant = m_Variants.at(id);
+	// A compile still running would overwrite it
+	if (!variant.Compiled)
+	{
+		throw std::runtime_error{ "Pipeline variant is still being compiled" };
+	}
+	variant.Error = nullptr;
+	return std::exchange(variant.Pipeline, pipeline);
+}
+
+vk::Pipeline PipelineLibrary::Build(const GraphicsPipelineState& state) const
+{
+	CPU_TRACE_SCOPE("Build pipeline variant");
+	const vk::ShaderModule vertexShaderModule =
+		LoadShader(m_Device, state.VertexShader);
+	vk::ShaderModule fragmentShaderModule{};
+	try
+	{
+		fragmentShaderModule = LoadShader(m_Device, state.FragmentShader);
+	}
+	catch (...)
+	{
+		m_Device.destroy(vertexShaderModule);
+		throw;
+	}
+
+	// Constant i is the i-th value, in both stages. Stages that don't declare a
+	// constant ignore its entry
+	std::vector<vk::SpecializationMapEntry> specializationEntries{};
+	specializationEntries.reserve(state.SpecializationConstants.size());
+	for (std::uint32_t i{ 0U }; i < state.SpecializationConstants.size(); ++i)
+	{
+		specializationEntries.push_back(vk::SpecializationMapEntry{
+			.constantID = i,
+			.offset     = i * static_cast<std::uint32_t>(sizeof(std::uint32_t)),
+			.size       = sizeof(std::uint32_t),
+		});
+	}
+	const vk::SpecializationInfo specializationInfo{
+		.mapEntryCount =
+			static_cast<std::uint32_t>(specializationEntries.size()),
+		.pMapEntries = specializationEntries.data(),
+		.dataSize =
+			state.SpecializationConstants.size() * sizeof(std::uint32_t),
+		.pData = state.SpecializationConstants.data(),
+	};
+
+	const std::array<vk::PipelineShaderStageCreateInfo, 2> shaderInfo{
+		vk::PipelineShaderStageCreateInfo{
+			.stage               = vk::ShaderStageFlagBits::eVertex,
+			.module              = vertexShaderModule,
+			.pName               = "main",
+			.pSpecializationInfo = &specializationInfo,
+		},
+		vk::PipelineShaderStageCreateInfo{
+			.stage               = vk::ShaderStageFlagBits::eFragment,
+			.module              = fragmentShaderModule,
+			.pName               = "main",
+			.pSpecializationInfo = &specializationInfo,
+		},
+	};
+
+	constexpr std::array<vk::DynamicState, 2> DynamicStates{
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor,
+	};
+	const vk::PipelineDynamicStateCreateInfo pipelineDynamicState{
+		.dynamicStateCount = static_cast<std::uint32_t>(DynamicStates.size()),
+		.pDynamicStates    = DynamicStates.data(),
+	};
+
+	const vk::PipelineVertexInputStateCreateInfo pipelineVertexInputInfo{
+		.vertexBindingDescriptionCount =
+			static_cast<std::uint32_t>(state.VertexBindings.size()),
+		.pVertexBindingDescriptions = state.VertexBindings.data(),
+		.vertexAttributeDescriptionCount =
+			static_cast<std::uint32_t>(state.VertexAttributes.size()),
+		.pVertexAttributeDescriptions = state.VertexAttributes.data(),
+	};
+
+	constexpr vk::PipelineInputAssemblyStateCreateInfo InputAssemblyInfo{
+		.topology               = vk::PrimitiveTopology::eTriangleList,
+		.primitiveRestartEnable = VK_FALSE,
+	};
+	constexpr vk::PipelineViewportStateCreateInfo DynamicViewportInfo{
+		.viewportCount = 1,
+		.pViewports    = nullptr,
+		.scissorCount  = 1,
+		.pScissors     = nullptr,
+	};
+
+	const vk::PipelineMultisampleStateCreateInfo multisampling{
+		.rasterizationSamples  = state.Samples,
+		.sampleShadingEnable   = VK_FALSE,
+		.minSampleShading      = 1.F,
+		.pSampleMask           = nullptr,
+		.alphaToCoverageEnable = VK_FALSE,
+		.alphaToOneEnable      = VK_FALSE,
+	};
+
+	const vk::PipelineRasterizationStateCreateInfo rasterizationInfo{
+		.depthClampEnable        = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode             = vk::PolygonMode::eFill,
+		.cullMode                = state.CullMode,
+		.frontFace               = state.FrontFace,
+		.depthBiasEnable         = VK_FALSE,
+		.depthBiasConstantFactor = 0.F,
+		.depthBiasClamp          = 0.F,
+		.depthBiasSlopeFactor    = 0.F,
+		.lineWidth               = 1.F,
+	};
+
+	const vk::PipelineDepthStencilStateCreateInfo depthStencil{
+		.depthTestEnable       = state.DepthTest ? vk::True : vk::False,
+		.depthWriteEnable      = state.DepthWrite ? vk::True : vk::False,
+		.depthCompareOp        = state.DepthCompareOp,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable     = VK_FALSE,
+		.minDepthBounds        = 0.F,
+		.maxDepthBounds        = 1.F,
+	};
+
+	const vk::PipelineColorBlendStateCreateInfo colorBlendState{
+		.logicOpEnable   = VK_FALSE,
+		.logicOp         = vk::LogicOp::eCopy,
+		.attachmentCount = 1U,
+		.pAttachments    = &state.Blend,
+	};
+
+	// Takes the place of the render pass with dynamic rendering
+	const vk::PipelineRenderingCreateInfo renderingInfo{
+		.colorAttachmentCount    = 1U,
+		.pColorAttachmentFormats = &state.ColorFormat,
+		.depthAttachmentFormat   = state.DepthStencilFormat,
+		.stencilAttachmentFormat = state.DepthStencilFormat,
+	};
+
+	auto [createPipelineResult, pipeline] = m_Device.createGraphicsPipeline(
+		m_PipelineCache,
+		vk::GraphicsPipelineCreateInfo{
+			.pNext               = state.RenderPass ? nullptr : &renderingInfo,
+			.stageCount          = static_cast<std::uint32_t>(shaderInfo.size()),
+			.pStages             = shaderInfo.data(),
+			.pVertexInputState   = &pipelineVertexInputInfo,
+			.pInputAssemblyState = &InputAssemblyInfo,
+			.pViewportState      = &DynamicViewportInfo,
+			.pRasterizationState = &rasterizationInfo,
+			.pMultisampleState   = &multisampling,
+			.pDepthStencilState  = &depthStencil,
+			.pColorBlendState    = &colorBlendState,
+			.pDynamicState       = &pipelineDynamicState,
+			.layout              = state.Layout,
+			.renderPass          = state.RenderPass,
+			.subpass             = 0,
+			.basePipelineIndex   = -1,
+		});
+	m_Device.destroy(vertexShaderModule);
+	m_Device.destroy(fragmentShaderModule);
+
+	if (createPipelineResult != vk::Result::eSuccess)
+	{
+		throw std::runtime_error{ fmt::format(
+			"Failed to create graphics pipeline: {}",
+			vk::to_string(createPipelineResult)) };
+	}
+	return pipeline;
+}
+
+void PipelineLibrary::RunWorker(const std::stop_token& stopToken)
+{
+	CPU_TRACE_THREAD_NAME("PipelineLibrary");
+	while (true)
+	{
+		VariantId id{};
+		GraphicsPipelineState state{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			if (!m_VariantsRequested.wait(lock, stopToken,
+			                              [this] { return !m_Pending.empty(); }))
+			{
+				return;
+			}
+			id = m_Pending.front();
+			m_Pending.pop_front();
+			state = m_Variants.at(id).State;
+		}
+
+		vk::Pipeline pipeline{};
+		std::exception_ptr error{};
+		try
+		{
+			pipeline = Build(state);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		{
+			const std::scoped_lock lock{ m_Mutex };
+			Variant& variant = m_Variants.at(id);
+			variant.Pipeline = pipeline;
+			variant.Error    = error;
+			variant.Compiled = true;
+		}
+		m_VariantCompiled.notify_all();
+	}
+}
@@ -0,0 +1,78 @@
+#include <VulkanTutorial/QualityGovernor.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+constexpr std::array ResolutionScales{ 1.F, 0.875F, 0.75F, 0.625F, 0.5F };
+} // namespace
+
+QualityGovernor::QualityGovernor(const double frameBudget,
+                                 const vk::SampleCountFlagBits maxSamples)
+	: m_FrameBudget{ frameBudget }
+{
+	for (auto samples = static_cast<std::uint32_t>(maxSamples); samples > 1U;
+	     samples /= 2U)
+	{
+		m_Levels.push_back(QualityLevel{
+			.Samples         = static_cast<vk::SampleCountFlagBits>(samples),
+			.ResolutionScale = 1.F,
+		});
+	}
+	for (const float scale : ResolutionScales)
+	{
+		m_Levels.push_back(QualityLevel{
+			.Samples         = vk::SampleCountFlagBits::e1,
+			.ResolutionScale = scale,
+		});
+	}
+}
+
+bool QualityGovernor::AddFrame(const double cpuTime, const double gpuTime)
+{
+	m_WindowCpuTime += cpuTime;
+	m_WindowGpuTime += gpuTime;
+	if (++m_WindowFrames < WindowSize)
+	{
+		return false;
+	}
+
+	const double cpuAverage = m_WindowCpuTime / WindowSize;
+	const double gpuAverage = m_WindowGpuTime / WindowSize;
+	m_WindowFrames          = 0U;
+	m_WindowCpuTime         = 0.0;
+	m_WindowGpuTime         = 0.0;
+
+	const std::size_t previousLevel = m_Level;
+	// Lower quality doesn't help when the CPU is what takes too long
+	if (gpuAverage > m_FrameBudget * DowngradeThreshold &&
+	    gpuAverage >= cpuAverage)
+	{
+		m_FastWindows = 0U;
+		m_Level       = std::min(m_Level + 1U, m_Levels.size() - 1U);
+	}
+	else if (std::max(cpuAverage, gpuAverage) < m_FrameBudget * UpgradeThreshold)
+	{
+		if (++m_FastWindows >= UpgradeWindows && m_Level > 0U)
+		{
+			m_FastWindows = 0U;
+			--m_Level;
+		}
+	}
+	else
+	{
+		m_FastWindows = 0U;
+	}
+
+	if (m_Level == previousLevel)
+	{
+		return false;
+	}
+	fmt::println("QualityGovernor: CPU {:.2f} ms, GPU {:.2f} ms, now {} at {:.0f}%",
+	             cpuAverage, gpuAverage, vk::to_string(GetLevel().Samples),
+	             GetLevel().ResolutionScale * 100.F);
+	return true;
+}
@@ -0,0 +1,212 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/ShaderReloader.h>
+
+#include <QProcess>
+#include <QStringList>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace
+{
+#ifdef VULKAN_TUTORIAL_SHADER_HOT_RELOAD
+constexpr bool HotReloadAvailable           = true;
+constexpr std::string_view ShaderSourceDir  = VULKAN_TUTORIAL_SHADER_SOURCE_DIR;
+constexpr std::string_view GlslcExecutable  = VULKAN_TUTORIAL_GLSLC;
+constexpr std::string_view GlslcShaderFlags = VULKAN_TUTORIAL_SHADER_DEFINES;
+#else
+constexpr bool HotReloadAvailable           = false;
+constexpr std::string_view ShaderSourceDir  = {};
+constexpr std::string_view GlslcExecutable  = {};
+constexpr std::string_view GlslcShaderFlags = {};
+#endif
+
+[[nodiscard]] std::filesystem::file_time_type GetWriteTime(
+	const std::filesystem::path& path)
+{
+	// Editors may replace the file while saving, it comes back on the next poll
+	std::error_code error{};
+	const std::filesystem::file_time_type writeTime =
+		std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type{} : writeTime;
+}
+} // namespace
+
+ShaderReloader::ShaderReloader(const vk::Device device,
+                               std::filesystem::path outputDirectory)
+	: m_Device{ device }
+	, m_SourceDirectory{ ShaderSourceDir }
+	, m_OutputDirectory{ std::move(outputDirectory) }
+{
+	if (!HotReloadAvailable)
+	{
+		throw std::runtime_error{
+			"Built without VULKAN_TUTORIAL_SHADER_HOT_RELOAD, shaders can't be "
+			"reloaded",
+		};
+	}
+	m_Worker = std::jthread{ [this](const std::stop_token& stopToken) {
+		Run(stopToken);
+	} };
+}
+
+ShaderReloader::~ShaderReloader() noexcept
+{
+	m_Worker.request_stop();
+	m_Worker.join();
+	for (const Reloaded& reloaded : m_Reloaded)
+	{
+		m_Device.destroy(reloaded.Pipeline);
+	}
+}
+
+void ShaderReloader::Watch(std::string name,
+                           std::vector<std::string> shaders,
+                           BuildFn build)
+{
+	const std::scoped_lock lock{ m_Mutex };
+	for (const std::string& shader : shaders)
+	{
+		m_SourceTimes.try_emplace(shader, GetWriteTime(m_SourceDirectory / shader));
+	}
+	m_Watched.push_back(WatchedPipeline{
+		.Name    = std::move(name),
+		.Shaders = std::move(shaders),
+		.Build   = std::move(build),
+	});
+}
+
+std::vector<ShaderReloader::Reloaded> ShaderReloader::TakeReloaded()
+{
+	const std::scoped_lock lock{ m_Mutex };
+	return std::exchange(m_Reloaded, {});
+}
+
+void ShaderReloader::Run(const std::stop_token& stopToken)
+{
+	CPU_TRACE_THREAD_NAME("ShaderReloader");
+	std::unique_lock lock{ m_Mutex };
+	while (true)
+	{
+		// Stopping is the only thing that ends the wait early
+		if (m_StopRequested.wait_for(
+				lock, stopToken, PollInterval,
+				[&stopToken] { return stopToken.stop_requested(); }))
+		{
+			return;
+		}
+		lock.unlock();
+		const std::vector<std::string> compiledShaders = CompileChanged();
+		if (!compiledShaders.empty())
+		{
+			Rebuild(compiledShaders);
+		}
+		lock.lock();
+	}
+}
+
+std::vector<std::string> ShaderReloader::CompileChanged()
+{
+	std::vector<std::string> changedShaders{};
+	{
+		const std::scoped_lock lock{ m_Mutex };
+		for (auto& [shader, writeTime] : m_SourceTimes)
+		{
+			const std::filesystem::file_time_type currentTime =
+				GetWriteTime(m_SourceDirectory / shader);
+			if (currentTime != writeTime &&
+			    currentTime != std::filesystem::file_time_type{})
+			{
+				writeTime = currentTime;
+				changedShaders.push_back(shader);
+			}
+		}
+	}
+
+	// Failed shaders are left out, so their pipelines keep the previous SPIR-V
+	std::erase_if(changedShaders,
+	              [this](const std::string& shader) { return !Compile(shader); });
+	return changedShaders;
+}
+
+bool ShaderReloader::Compile(const std::string& shader) const
+{
+	CPU_TRACE_SCOPE("Compile shader");
+	const std::filesystem::path source = m_SourceDirectory / shader;
+	const std::filesystem::path output = m_OutputDirectory / (shader + ".spv");
+	// Renamed over the output once complete, it is never loaded half written
+	const std::filesystem::path temporary =
+		m_OutputDirectory / (shader + ".spv.tmp");
+
+	// Same arguments as add_shader_dependency
+	QStringList arguments{ QStringLiteral("--target-env=vulkan1.3") };
+	arguments.append(QString::fromUtf8(GlslcShaderFlags)
+	                     .split(QLatin1Char{ ' ' }, Qt::SkipEmptyParts));
+	arguments << QString::fromStdString(source.string()) << QStringLiteral("-O")
+	          << QStringLiteral("-o") << QString::fromStdString(temporary.string());
+
+	QProcess process{};
+	process.start(QString::fromUtf8(GlslcExecutable), arguments);
+	if (!process.waitForFinished(-1) ||
+	    process.exitStatus() != QProcess::ExitStatus::NormalExit ||
+	    process.exitCode() != 0)
+	{
+		fmt::println(stderr, "ShaderReloader: failed to compile {}\n{}", shader,
+		             process.readAllStandardError().toStdString());
+		return false;
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(temporary, output, error);
+	if (error)
+	{
+		fmt::println(stderr, "ShaderReloader: failed to replace {}: {}",
+		             output.string(), error.message());
+		return false;
+	}
+	fmt::println("ShaderReloader: compiled {}", shader);
+	return true;
+}
+
+void ShaderReloader::Rebuild(const std::vector<std::string>& compiledShaders)
+{
+	// Copied, so the pipelines are built without holding the lock
+	std::vector<WatchedPipeline> affected{};
+	{
+		const std::scoped_lock lock{ m_Mutex };
+		std::ranges::copy_if(
+			m_Watched, std::back_inserter(affected),
+			[&compiledShaders](const WatchedPipeline& watched) {
+				return std::ranges::any_of(
+					watched.Shaders, [&compiledShaders](const std::string& shader) {
+						return std::ranges::find(compiledShaders, shader) !=
+						       compiledShaders.end();
+					});
+			});
+	}
+
+	for (const WatchedPipeline& watched : affected)
+	{
+		CPU_TRACE_SCOPE("Rebuild pipeline");
+		try
+		{
+			const vk::Pipeline pipeline = watched.Build();
+			const std::scoped_lock lock{ m_Mutex };
+			m_Reloaded.push_back(Reloaded{
+				.Name     = watched.Name,
+				.Pipeline = pipeline,
+			});
+		}
+		catch (const std::exception& e)
+		{
+			fmt::println(stderr, "ShaderReloader: failed to rebuild {}: {}",
+			             watched.Name, e.what());
+		}
+	}
+}
@@ -1,23 +1,39 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject
+// Only rewritten when the camera or the target size changes
+layout(binding = 0) uniform CameraUniforms
 {
-        mat4 model;
         mat4 view;
         mat4 proj;
 }
-ubo;
+camera;
+
+// Matches ModelPushConstants, set for every model
+layout(push_constant) uniform PushConstants
+{
+        mat4 model;
+}
+pushConstants;
 
+// Must match the Vertex layout, COMPACT_VERTEX selects CompactVertex
 layout(location = 0) in vec3 inPosition;
+#ifndef COMPACT_VERTEX
 layout(location = 1) in vec3 inColor;
+#endif
 layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inInstanceTransform;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main()
 {
-        gl_Position  = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+        gl_Position  = camera.proj * camera.view * inInstanceTransform *
+                       pushConstants.model * vec4(inPosition, 1.0);
+#ifdef COMPACT_VERTEX
+        fragColor    = vec3(1.0);
+#else
         fragColor    = inColor;
+#endif
         fragTexCoord = inTexCoord;
 }
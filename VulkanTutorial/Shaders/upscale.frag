@@ -0,0 +1,22 @@
+#version 450
+
+layout(binding = 0) uniform sampler2D scene;
+
+// Matches UpscalePushConstants, the scene only covers part of its image
+layout(push_constant) uniform PushConstants
+{
+        vec2 uvScale;
+        // Keeps filtering from reading outside of the rendered part
+        vec2 uvMax;
+}
+pushConstants;
+
+layout(location = 0) in vec2 inUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+        const vec2 uv = min(inUV * pushConstants.uvScale, pushConstants.uvMax);
+        outColor = texture(scene, uv);
+}
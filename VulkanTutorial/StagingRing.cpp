@@ -0,0 +1,134 @@
+#include <VulkanTutorial/StagingRing.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+[[nodiscard]] constexpr vk::DeviceSize AlignUp(const vk::DeviceSize value,
+                                               const vk::DeviceSize alignment)
+{
+	return (value + alignment - 1U) / alignment * alignment;
+}
+} // namespace
+
+StagingRing::StagingRing(const vk::Device device,
+                         DeviceMemoryAllocator& allocator,
+                         const vk::DeviceSize size)
+	: m_Device{ device }
+	, m_Allocator{ &allocator }
+	, m_Size{ size }
+{
+	std::tie(m_Buffer, m_Allocation) = CreateDeviceBuffer(
+		m_Size, vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferSrc },
+		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible |
+								 vk::MemoryPropertyFlagBits::eHostCoherent },
+		m_Device, *m_Allocator);
+	assert(m_Allocation.MappedData != nullptr);
+}
+
+StagingRing::~StagingRing() noexcept
+{
+	m_Device.destroy(m_Buffer);
+	m_Allocator->Free(m_Allocation);
+}
+
+std::optional<StagingRegion> StagingRing::TryAllocate(
+	const vk::DeviceSize size,
+	const vk::DeviceSize alignment)
+{
+	if (size == 0U || size > m_Size)
+	{
+		return std::nullopt;
+	}
+
+	const bool wrapped = m_Head < m_Tail || (m_Head == m_Tail && m_UsedBytes > 0U);
+	const vk::DeviceSize alignedHead = AlignUp(m_Head, alignment);
+
+	vk::DeviceSize offset{};
+	vk::DeviceSize consumed{};
+	if (wrapped)
+	{
+		// Only the gap between the newest and the oldest data is free
+		if (alignedHead + size > m_Tail)
+		{
+			return std::nullopt;
+		}
+		offset   = alignedHead;
+		consumed = alignedHead + size - m_Head;
+	}
+	else if (alignedHead + size <= m_Size)
+	{
+		offset   = alignedHead;
+		consumed = alignedHead + size - m_Head;
+	}
+	else if (size <= m_Tail)
+	{
+		// Wrap around, the skipped end of the buffer is released with this region
+		offset   = 0U;
+		consumed = m_Size - m_Head + size;
+	}
+	else
+	{
+		return std::nullopt;
+	}
+
+	m_Head = offset + size;
+	m_UsedBytes += consumed;
+	m_UnfencedBytes += consumed;
+
+	std::byte* const data = static_cast<std::byte*>(m_Allocation.MappedData);
+	return StagingRegion{
+		.Buffer = m_Buffer,
+		.Offset = offset,
+		.Data   = std::span{ data + offset, static_cast<std::size_t>(size) },
+	};
+}
+
+vk::DeviceSize StagingRing::GetLargestFreeRegion(
+	const vk::DeviceSize alignment) const
+{
+	const bool wrapped = m_Head < m_Tail || (m_Head == m_Tail && m_UsedBytes > 0U);
+	const vk::DeviceSize alignedHead = AlignUp(m_Head, alignment);
+
+	if (wrapped)
+	{
+		return m_Tail > alignedHead ? m_Tail - alignedHead : 0U;
+	}
+	const vk::DeviceSize atEnd = m_Size > alignedHead ? m_Size - alignedHead : 0U;
+	return std::max(atEnd, m_Tail);
+}
+
+void StagingRing::Fence(const std::uint64_t fenceValue)
+{
+	if (m_UnfencedBytes == 0U)
+	{
+		return;
+	}
+
+	m_FencedRanges.push_back(FencedRange{
+		.FenceValue = fenceValue,
+		.End        = m_Head,
+		.Bytes      = m_UnfencedBytes,
+	});
+	m_UnfencedBytes = 0U;
+}
+
+void StagingRing::Release(const std::uint64_t completedFenceValue)
+{
+	while (!m_FencedRanges.empty() &&
+	       m_FencedRanges.front().FenceValue <= completedFenceValue)
+	{
+		m_Tail = m_FencedRanges.front().End;
+		m_UsedBytes -= m_FencedRanges.front().Bytes;
+		m_FencedRanges.pop_front();
+	}
+
+	if (m_UsedBytes == 0U)
+	{
+		// Start over from the beginning to get the largest contiguous space
+		m_Head = 0U;
+		m_Tail = 0U;
+	}
+}
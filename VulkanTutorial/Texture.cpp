@@ -0,0 +1,406 @@
+#include <VulkanTutorial/Texture.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <QFile>
+#include <QImage>
+#include <QSaveFile>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <execution>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+
+namespace
+{
+constexpr std::array<std::uint8_t, 12> Ktx2Identifier{
+	0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n',
+};
+
+// File header and index, see the KTX 2.0 specification
+struct Ktx2Header
+{
+	std::array<std::uint8_t, 12> Identifier{};
+	std::uint32_t VkFormat{};
+	std::uint32_t TypeSize{};
+	std::uint32_t PixelWidth{};
+	std::uint32_t PixelHeight{};
+	std::uint32_t PixelDepth{};
+	std::uint32_t LayerCount{};
+	std::uint32_t FaceCount{};
+	std::uint32_t LevelCount{};
+	std::uint32_t SupercompressionScheme{};
+	std::uint32_t DfdByteOffset{};
+	std::uint32_t DfdByteLength{};
+	std::uint32_t KvdByteOffset{};
+	std::uint32_t KvdByteLength{};
+	std::uint64_t SgdByteOffset{};
+	std::uint64_t SgdByteLength{};
+};
+static_assert(sizeof(Ktx2Header) == 80U);
+static_assert(std::is_trivially_copyable_v<Ktx2Header>);
+
+struct Ktx2Level
+{
+	std::uint64_t ByteOffset{};
+	std::uint64_t ByteLength{};
+	std::uint64_t UncompressedByteLength{};
+};
+static_assert(sizeof(Ktx2Level) == 24U);
+static_assert(std::is_trivially_copyable_v<Ktx2Level>);
+
+// Values of the Khronos Data Format descriptor written by SaveKtx2
+constexpr std::uint8_t DfdModelRgbsda    = 1U;
+constexpr std::uint8_t DfdModelBc1a      = 128U;
+constexpr std::uint8_t DfdModelBc7       = 134U;
+constexpr std::uint8_t DfdPrimariesBt709 = 1U;
+constexpr std::uint8_t DfdTransferLinear = 1U;
+constexpr std::uint8_t DfdTransferSrgb   = 2U;
+constexpr std::uint32_t DfdVersion       = 2U;
+
+struct FormatInfo
+{
+	vk::Format Format{};
+	vk::Extent2D BlockExtent;
+	std::uint32_t BlockSize{};
+	std::uint8_t ColorModel{};
+	std::uint8_t Channel{};
+	bool Srgb{};
+};
+
+constexpr vk::Extent2D TexelExtent{ .width = 1U, .height = 1U };
+constexpr vk::Extent2D BcBlockExtent{ .width = 4U, .height = 4U };
+
+constexpr std::uint8_t Bc1ColorChannel = 0U;
+// BC1 with punch-through alpha is described with the alpha channel instead
+constexpr std::uint8_t Bc1AlphaChannel = 1U;
+constexpr std::uint8_t Bc7Channel      = 0U;
+
+constexpr std::array SupportedFormats{
+	FormatInfo{ vk::Format::eR8G8B8A8Unorm, TexelExtent, 4U, DfdModelRgbsda, 0U,
+	            false },
+	FormatInfo{ vk::Format::eR8G8B8A8Srgb, TexelExtent, 4U, DfdModelRgbsda, 0U,
+	            true },
+	FormatInfo{ vk::Format::eBc1RgbUnormBlock, BcBlockExtent, 8U, DfdModelBc1a,
+	            Bc1ColorChannel, false },
+	FormatInfo{ vk::Format::eBc1RgbSrgbBlock, BcBlockExtent, 8U, DfdModelBc1a,
+	            Bc1ColorChannel, true },
+	FormatInfo{ vk::Format::eBc1RgbaUnormBlock, BcBlockExtent, 8U, DfdModelBc1a,
+	            Bc1AlphaChannel, false },
+	FormatInfo{ vk::Format::eBc1RgbaSrgbBlock, BcBlockExtent, 8U, DfdModelBc1a,
+	            Bc1AlphaChannel, true },
+	FormatInfo{ vk::Format::eBc7UnormBlock, BcBlockExtent, 16U, DfdModelBc7,
+	            Bc7Channel, false },
+	FormatInfo{ vk::Format::eBc7SrgbBlock, BcBlockExtent, 16U, DfdModelBc7,
+	            Bc7Channel, true },
+};
+
+[[nodiscard]] std::optional<FormatInfo> FindFormat(const vk::Format format)
+{
+	const auto* const info =
+		std::ranges::find(SupportedFormats, format, &FormatInfo::Format);
+	if (info == end(SupportedFormats))
+	{
+		return std::nullopt;
+	}
+	return *info;
+}
+
+// Basic descriptor block with a single sample covering the whole block, which
+// is how block-compressed formats are described
+[[nodiscard]] std::vector<std::uint32_t> MakeDataFormatDescriptor(
+	const FormatInfo& info)
+{
+	constexpr std::uint32_t BlockHeaderSize = 24U;
+	constexpr std::uint32_t SampleSize      = 16U;
+	constexpr std::uint32_t BlockSize       = BlockHeaderSize + SampleSize;
+
+	const std::uint8_t transfer   = info.Srgb ? DfdTransferSrgb : DfdTransferLinear;
+	const std::uint32_t bitLength = info.BlockSize * 8U;
+	return std::vector<std::uint32_t>{
+		// Total size, including this word
+		sizeof(std::uint32_t) + BlockSize,
+		// Khronos vendor, basic descriptor type
+		0U,
+		DfdVersion | (BlockSize << 16U),
+		std::uint32_t{ info.ColorModel } |
+			(std::uint32_t{ DfdPrimariesBt709 } << 8U) |
+			(std::uint32_t{ transfer } << 16U),
+		(info.BlockExtent.width - 1U) | ((info.BlockExtent.height - 1U) << 8U),
+		info.BlockSize,
+		0U,
+		// The sample: bit offset and length, then position, lower and upper
+		(bitLength - 1U) << 16U | std::uint32_t{ info.Channel } << 24U,
+		0U,
+		0U,
+		0xFFFFFFFFU,
+	};
+}
+
+template <typename T>
+[[nodiscard]] T ReadStruct(const QByteArray& contents, const std::uint64_t offset)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	if (offset + sizeof(T) > static_cast<std::uint64_t>(contents.size()))
+	{
+		throw std::runtime_error{ "Truncated KTX2 file" };
+	}
+	T value{};
+	std::memcpy(&value, contents.constData() + offset, sizeof(T));
+	return value;
+}
+
+// QImage stores 32 bit texels as native 0xAARRGGBB integers, RGBA in memory
+// only needs red and blue swapped. Kept branch free so it gets vectorised
+void SwizzleArgbToRgba(const std::span<const std::byte> source,
+                       const std::span<std::byte> destination)
+{
+	assert(source.size() == destination.size() && source.size() % 4U == 0U);
+	for (std::size_t offset{ 0U }; offset < source.size(); offset += 4U)
+	{
+		std::uint32_t argb{};
+		std::memcpy(&argb, source.data() + offset, sizeof(argb));
+		std::uint32_t rgba{};
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			rgba = (argb & 0xFF00FF00U) | (argb >> 16U & 0xFFU) |
+			       (argb & 0xFFU) << 16U;
+		}
+		else
+		{
+			rgba = std::rotl(argb, 8);
+		}
+		std::memcpy(destination.data() + offset, &rgba, sizeof(rgba));
+	}
+}
+} // namespace
+
+vk::DeviceSize TextureData::GetLevelSize(const std::uint32_t level) const noexcept
+{
+	const vk::Extent2D levelExtent = GetMipExtent(Extent, level);
+	const std::uint32_t blockColumns =
+		(levelExtent.width + BlockExtent.width - 1U) / BlockExtent.width;
+	const std::uint32_t blockRows =
+		(levelExtent.height + BlockExtent.height - 1U) / BlockExtent.height;
+	return vk::DeviceSize{ blockColumns } * blockRows * BlockSize;
+}
+
+std::span<const std::byte> TextureData::GetLevel(const std::uint32_t level) const
+{
+	vk::DeviceSize offset{ 0U };
+	for (std::uint32_t i{ 0U }; i < level; ++i)
+	{
+		offset += GetLevelSize(i);
+	}
+	return std::span{ Data }.subspan(offset, GetLevelSize(level));
+}
+
+TextureData LoadImageFile(const std::filesystem::path& path, const bool srgb)
+{
+	QImage image{ QString::fromStdString(path.string()) };
+	if (image.isNull())
+	{
+		throw std::runtime_error{ fmt::format("Failed to load image {}",
+		                                      path.string()) };
+	}
+	// Most images decode to one of these, anything else takes the slow path
+	const bool swapRedBlue = image.format() == QImage::Format::Format_ARGB32 ||
+	                         image.format() == QImage::Format::Format_RGB32;
+	if (!swapRedBlue && image.format() != QImage::Format::Format_RGBA8888 &&
+	    image.format() != QImage::Format::Format_RGBX8888)
+	{
+		image.convertTo(QImage::Format::Format_RGBA8888);
+	}
+
+	TextureData texture{
+		.Format = srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm,
+		.Extent =
+			vk::Extent2D{
+				.width  = static_cast<std::uint32_t>(image.width()),
+				.height = static_cast<std::uint32_t>(image.height()),
+			},
+		.BlockSize = 4U,
+	};
+	texture.Data.resize(texture.GetLevelSize(0U));
+
+	// Converted straight into the texture, a row per task
+	const std::size_t rowSize = std::size_t{ texture.Extent.width } * 4U;
+	std::vector<std::uint32_t> rows(texture.Extent.height);
+	std::ranges::generate(rows, [row = 0U]() mutable { return row++; });
+	const auto convertRow = [&](const std::uint32_t y) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		const auto* const source = reinterpret_cast<const std::byte*>(
+			image.constScanLine(static_cast<int>(y)));
+		std::byte* const destination = texture.Data.data() + y * rowSize;
+		if (swapRedBlue)
+		{
+			SwizzleArgbToRgba(std::span{ source, rowSize },
+			                  std::span{ destination, rowSize });
+		}
+		else
+		{
+			std::memcpy(destination, source, rowSize);
+		}
+	};
+	std::for_each(std::execution::par_unseq, begin(rows), end(rows), convertRow);
+	return texture;
+}
+
+TextureData LoadKtx2(const std::filesystem::path& path)
+{
+	QFile file{ path };
+	if (!file.open(QIODevice::OpenModeFlag::ReadOnly))
+	{
+		throw std::runtime_error{ fmt::format("Failed to open {}: {}",
+		                                      path.string(),
+		                                      file.errorString().toStdString()) };
+	}
+	const QByteArray contents = file.readAll();
+
+	const auto header = ReadStruct<Ktx2Header>(contents, 0U);
+	if (header.Identifier != Ktx2Identifier)
+	{
+		throw std::runtime_error{ fmt::format("{} is not a KTX2 file",
+		                                      path.string()) };
+	}
+	const auto format                    = static_cast<vk::Format>(header.VkFormat);
+	const std::optional<FormatInfo> info = FindFormat(format);
+	if (!info.has_value())
+	{
+		throw std::runtime_error{ fmt::format("{} has unsupported format {}",
+		                                      path.string(),
+		                                      vk::to_string(format)) };
+	}
+	const bool single2D = header.PixelWidth > 0U && header.PixelHeight > 0U &&
+	                      header.PixelDepth <= 1U && header.LayerCount <= 1U &&
+	                      header.FaceCount == 1U;
+	if (!single2D)
+	{
+		throw std::runtime_error{ fmt::format("{} is not a single 2D texture",
+		                                      path.string()) };
+	}
+	if (header.SupercompressionScheme != 0U)
+	{
+		throw std::runtime_error{ fmt::format("{} is supercompressed",
+		                                      path.string()) };
+	}
+
+	TextureData texture{
+		.Format      = format,
+		.Extent =
+			vk::Extent2D{
+				.width  = header.PixelWidth,
+				.height = header.PixelHeight,
+			},
+		.BlockExtent = info->BlockExtent,
+		.BlockSize   = info->BlockSize,
+		// 0 asks the loader to generate the chain, which happens on upload
+		.LevelCount = std::max(header.LevelCount, 1U),
+	};
+
+	for (std::uint32_t level{ 0U }; level < texture.LevelCount; ++level)
+	{
+		const auto levelIndex = ReadStruct<Ktx2Level>(
+			contents, sizeof(Ktx2Header) + level * sizeof(Ktx2Level));
+		const bool valid =
+			levelIndex.ByteLength == texture.GetLevelSize(level) &&
+			levelIndex.ByteOffset + levelIndex.ByteLength <=
+				static_cast<std::uint64_t>(contents.size());
+		if (!valid)
+		{
+			throw std::runtime_error{ fmt::format("{} has an invalid level {}",
+			                                      path.string(), level) };
+		}
+
+		const std::span<const std::byte> levelData =
+			std::as_bytes(std::span{ contents.constData(),
+			                         static_cast<std::size_t>(contents.size()) })
+				.subspan(levelIndex.ByteOffset, levelIndex.ByteLength);
+		texture.Data.insert(end(texture.Data), begin(levelData), end(levelData));
+	}
+	return texture;
+}
+
+void SaveKtx2(const std::filesystem::path& path, const TextureData& texture)
+{
+	const std::optional<FormatInfo> info = FindFormat(texture.Format);
+	if (!info.has_value() || !texture.IsBlockCompressed())
+	{
+		throw std::invalid_argument{ fmt::format("Can't save {} textures",
+		                                         vk::to_string(texture.Format)) };
+	}
+
+	const std::vector<std::uint32_t> dataFormatDescriptor =
+		MakeDataFormatDescriptor(*info);
+	const std::uint64_t dfdOffset =
+		sizeof(Ktx2Header) +
+		std::uint64_t{ texture.LevelCount } * sizeof(Ktx2Level);
+	const std::uint64_t dfdLength =
+		dataFormatDescriptor.size() * sizeof(std::uint32_t);
+
+	const Ktx2Header header{
+		.Identifier    = Ktx2Identifier,
+		.VkFormat      = static_cast<std::uint32_t>(texture.Format),
+		.TypeSize      = 1U,
+		.PixelWidth    = texture.Extent.width,
+		.PixelHeight   = texture.Extent.height,
+		.PixelDepth    = 0U,
+		.LayerCount    = 0U,
+		.FaceCount     = 1U,
+		.LevelCount    = texture.LevelCount,
+		.DfdByteOffset = static_cast<std::uint32_t>(dfdOffset),
+		.DfdByteLength = static_cast<std::uint32_t>(dfdLength),
+	};
+
+	// The specification wants the smallest level first, each aligned to the
+	// block size
+	const std::uint64_t alignment = std::lcm(std::uint64_t{ info->BlockSize }, 4U);
+	std::vector<Ktx2Level> levels(texture.LevelCount);
+	std::uint64_t offset = dfdOffset + dfdLength;
+	for (std::uint32_t level = texture.LevelCount; level-- > 0U;)
+	{
+		offset = (offset + alignment - 1U) / alignment * alignment;
+		levels.at(level) = Ktx2Level{
+			.ByteOffset             = offset,
+			.ByteLength             = texture.GetLevelSize(level),
+			.UncompressedByteLength = texture.GetLevelSize(level),
+		};
+		offset += levels.at(level).ByteLength;
+	}
+
+	QSaveFile file{ QString::fromStdString(path.string()) };
+	if (!file.open(QIODevice::OpenModeFlag::WriteOnly))
+	{
+		throw std::runtime_error{ fmt::format("Failed to open {}: {}",
+		                                      path.string(),
+		                                      file.errorString().toStdString()) };
+	}
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Ktx2Header));
+	file.write(reinterpret_cast<const char*>(levels.data()),
+	           static_cast<qint64>(levels.size() * sizeof(Ktx2Level)));
+	file.write(reinterpret_cast<const char*>(dataFormatDescriptor.data()),
+	           static_cast<qint64>(dfdLength));
+	for (std::uint32_t level = texture.LevelCount; level-- > 0U;)
+	{
+		const auto paddingSize =
+			static_cast<qsizetype>(levels.at(level).ByteOffset) - file.pos();
+		file.write(QByteArray(paddingSize, '\0'));
+		const std::span<const std::byte> levelData = texture.GetLevel(level);
+		file.write(reinterpret_cast<const char*>(levelData.data()),
+		           static_cast<qint64>(levelData.size()));
+	}
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+	if (!file.commit())
+	{
+		throw std::runtime_error{ fmt::format("Failed to write {}: {}",
+		                                      path.string(),
+		                                      file.errorString().toStdString()) };
+	}
+}
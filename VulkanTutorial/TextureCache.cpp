@@ -0,0 +1,127 @@
+#include <VulkanTutorial/BlockCompression.h>
+#include <VulkanTutorial/TextureCache.h>
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <system_error>
+
+namespace
+{
+// Null when there is no cache, or it is out of date or unusable
+[[nodiscard]] std::shared_ptr<const TextureData> LoadCached(
+	const std::filesystem::path& path,
+	const std::filesystem::path& cachePath,
+	const vk::Format expectedFormat)
+{
+	// An edited source makes the cache stale
+	std::error_code error{};
+	const auto cacheTime = std::filesystem::last_write_time(cachePath, error);
+	if (error)
+	{
+		return nullptr;
+	}
+	const auto sourceTime = std::filesystem::last_write_time(path, error);
+	if (error || cacheTime < sourceTime)
+	{
+		return nullptr;
+	}
+
+	try
+	{
+		auto texture = std::make_shared<const TextureData>(LoadKtx2(cachePath));
+		if (texture->Format == expectedFormat)
+		{
+			return texture;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		fmt::println("Ignoring texture cache {}: {}", cachePath.string(), e.what());
+	}
+	return nullptr;
+}
+} // namespace
+
+TextureCache::TextureCache(const vk::PhysicalDevice physicalDevice)
+	: m_PhysicalDevice{ physicalDevice }
+{
+}
+
+TextureCache::~TextureCache() noexcept
+{
+	const std::scoped_lock lock{ m_EncodersMutex };
+	for (const std::future<void>& encoder : m_Encoders)
+	{
+		encoder.wait();
+	}
+}
+
+std::filesystem::path TextureCache::GetCachePath(const std::filesystem::path& path)
+{
+	std::filesystem::path cachePath = path;
+	cachePath += ".ktx2";
+	return cachePath;
+}
+
+bool TextureCache::IsSupported(const vk::Format format) const
+{
+	const vk::FormatProperties properties =
+		m_PhysicalDevice.getFormatProperties(format);
+	return static_cast<bool>(properties.optimalTilingFeatures &
+	                         vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+}
+
+std::shared_ptr<const TextureData> TextureCache::Load(
+	const std::filesystem::path& path,
+	const bool srgb)
+{
+	if (path.extension() == ".ktx2")
+	{
+		auto texture = std::make_shared<const TextureData>(LoadKtx2(path));
+		if (!IsSupported(texture->Format))
+		{
+			throw std::runtime_error{ fmt::format(
+				"{} uses {}, which the device can't sample", path.string(),
+				vk::to_string(texture->Format)) };
+		}
+		return texture;
+	}
+
+	const vk::Format compressedFormat =
+		srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+	const bool compress                   = IsSupported(compressedFormat);
+	const std::filesystem::path cachePath = GetCachePath(path);
+	if (compress)
+	{
+		std::shared_ptr<const TextureData> cached =
+			LoadCached(path, cachePath, compressedFormat);
+		if (cached)
+		{
+			return cached;
+		}
+	}
+
+	auto image = std::make_shared<const TextureData>(LoadImageFile(path, srgb));
+	if (compress && IsOpaque(*image))
+	{
+		const std::scoped_lock lock{ m_EncodersMutex };
+		std::erase_if(m_Encoders, [](const std::future<void>& encoder) {
+			return encoder.wait_for(std::chrono::seconds{ 0 }) ==
+			       std::future_status::ready;
+		});
+		m_Encoders.push_back(std::async(std::launch::async, [image, cachePath] {
+			try
+			{
+				SaveKtx2(cachePath, EncodeBc1(*image));
+			}
+			catch (const std::exception& e)
+			{
+				// The source is used again on the next launch
+				fmt::println(stderr, "Failed to compress {}: {}",
+				             cachePath.string(), e.what());
+			}
+		}));
+	}
+	return image;
+}
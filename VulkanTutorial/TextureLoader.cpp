@@ -0,0 +1,94 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/TextureCache.h>
+#include <VulkanTutorial/TextureLoader.h>
+
+#include <algorithm>
+
+TextureLoader::TextureLoader(TextureCache& cache, const std::uint32_t threadCount)
+	: m_Cache{ &cache }
+{
+	m_Workers.reserve(threadCount);
+	for (std::uint32_t i{ 0U }; i < threadCount; ++i)
+	{
+		m_Workers.emplace_back(
+			[this](const std::stop_token& stopToken) { RunWorker(stopToken); });
+	}
+}
+
+TextureLoader::~TextureLoader() noexcept
+{
+	// The wait only checks for a stop when there are no requests left
+	{
+		const std::scoped_lock lock{ m_RequestsMutex };
+		m_Requests.clear();
+	}
+	// Stop them all before joining any, the current loads finish in parallel
+	for (std::jthread& worker : m_Workers)
+	{
+		worker.request_stop();
+	}
+	m_Workers.clear();
+}
+
+std::uint32_t TextureLoader::GetDefaultThreadCount() noexcept
+{
+	return std::max(std::thread::hardware_concurrency(), 2U) - 1U;
+}
+
+void TextureLoader::Load(std::filesystem::path path, const bool srgb)
+{
+	{
+		const std::scoped_lock lock{ m_RequestsMutex };
+		m_Requests.push_back(Request{ .Path = std::move(path), .Srgb = srgb });
+	}
+	m_RequestsAdded.notify_one();
+	++m_PendingCount;
+}
+
+std::vector<LoadedTexture> TextureLoader::TakeCompleted()
+{
+	std::vector<LoadedTexture> completed = m_Completed.TakeAll();
+	m_PendingCount -= completed.size();
+	return completed;
+}
+
+std::vector<LoadedTexture> TextureLoader::WaitForCompleted()
+{
+	if (m_PendingCount == 0U)
+	{
+		return {};
+	}
+	m_Completed.Wait();
+	return TakeCompleted();
+}
+
+void TextureLoader::RunWorker(const std::stop_token& stopToken)
+{
+	CPU_TRACE_THREAD_NAME("TextureLoader");
+	while (true)
+	{
+		Request request{};
+		{
+			std::unique_lock lock{ m_RequestsMutex };
+			if (!m_RequestsAdded.wait(lock, stopToken,
+			                          [this] { return !m_Requests.empty(); }))
+			{
+				return;
+			}
+			request = std::move(m_Requests.front());
+			m_Requests.pop_front();
+		}
+
+		LoadedTexture loaded{ .Path = request.Path };
+		try
+		{
+			CPU_TRACE_SCOPE("Load texture");
+			loaded.Texture = m_Cache->Load(request.Path, request.Srgb);
+		}
+		catch (...)
+		{
+			loaded.Error = std::current_exception();
+		}
+		m_Completed.Push(std::move(loaded));
+	}
+}
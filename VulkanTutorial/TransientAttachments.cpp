@@ -0,0 +1,125 @@
+#include <VulkanTutorial/TransientAttachments.h>
+
+#include <fmt/core.h>
+
+namespace
+{
+bool HasLazilyAllocatedType(
+	const vk::PhysicalDeviceMemoryProperties& memoryProperties,
+	const std::uint32_t typeFilter)
+{
+	constexpr vk::MemoryPropertyFlags LazilyAllocated =
+		vk::MemoryPropertyFlagBits::eDeviceLocal |
+		vk::MemoryPropertyFlagBits::eLazilyAllocated;
+	for (std::uint32_t i{ 0U }; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		if ((typeFilter & (1U << i)) != 0U &&
+		    (memoryProperties.memoryTypes.at(i).propertyFlags & LazilyAllocated) ==
+		        LazilyAllocated)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+} // namespace
+
+TransientAttachments::TransientAttachments(
+	const vk::Device device,
+	const vk::PhysicalDevice physicalDevice,
+	DeviceMemoryAllocator& allocator,
+	const vk::Extent2D extent,
+	const std::uint32_t imageCount,
+	const vk::Format colorFormat,
+	const vk::Format depthStencilFormat,
+	const vk::SampleCountFlagBits samples)
+	: m_Device{ device }
+	, m_Allocator{ &allocator }
+	, m_MemoryProperties{ physicalDevice.getMemoryProperties() }
+	, m_Extent{ extent }
+	, m_Samples{ samples }
+{
+	if (m_Samples != vk::SampleCountFlagBits::e1)
+	{
+		m_Color.reserve(imageCount);
+		for (std::uint32_t i{ 0U }; i < imageCount; ++i)
+		{
+			m_Color.push_back(CreateAttachment(
+				colorFormat, vk::ImageUsageFlagBits::eColorAttachment,
+				vk::ImageAspectFlagBits::eColor));
+		}
+	}
+	m_DepthStencil = CreateAttachment(
+		depthStencilFormat, vk::ImageUsageFlagBits::eDepthStencilAttachment,
+		vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil);
+
+	fmt::println("TransientAttachments: {} at {}x{}, {} of {} lazily allocated",
+	             vk::to_string(m_Samples), m_Extent.width, m_Extent.height,
+	             m_LazilyAllocatedCount, m_Color.size() + 1U);
+}
+
+TransientAttachments::~TransientAttachments() noexcept
+{
+	for (const Attachment& attachment : m_Color)
+	{
+		DestroyAttachment(attachment);
+	}
+	DestroyAttachment(m_DepthStencil);
+}
+
+TransientAttachments::Attachment TransientAttachments::CreateAttachment(
+	const vk::Format format,
+	const vk::ImageUsageFlags usage,
+	const vk::ImageAspectFlags aspect)
+{
+	Attachment attachment{};
+	attachment.Image = m_Device.createImage(vk::ImageCreateInfo{
+		.imageType   = vk::ImageType::e2D,
+		.format      = format,
+		.extent      = vk::Extent3D{ m_Extent.width, m_Extent.height, 1U },
+		.mipLevels   = 1U,
+		.arrayLayers = 1U,
+		.samples     = m_Samples,
+		.tiling      = vk::ImageTiling::eOptimal,
+		// Only ever cleared and resolved or discarded within a render pass
+		.usage         = usage | vk::ImageUsageFlagBits::eTransientAttachment,
+		.sharingMode   = vk::SharingMode::eExclusive,
+		.initialLayout = vk::ImageLayout::eUndefined,
+	});
+
+	const vk::MemoryRequirements memoryRequirements =
+		m_Device.getImageMemoryRequirements(attachment.Image);
+	vk::MemoryPropertyFlags memoryFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal };
+	if (HasLazilyAllocatedType(m_MemoryProperties,
+	                           memoryRequirements.memoryTypeBits))
+	{
+		memoryFlags |= vk::MemoryPropertyFlagBits::eLazilyAllocated;
+		++m_LazilyAllocatedCount;
+	}
+	attachment.Allocation = m_Allocator->Allocate(memoryRequirements, memoryFlags,
+	                                              ResourceTiling::Optimal);
+	m_Device.bindImageMemory(attachment.Image, attachment.Allocation.Memory,
+	                         attachment.Allocation.Offset);
+
+	attachment.View = m_Device.createImageView(vk::ImageViewCreateInfo{
+		.image    = attachment.Image,
+		.viewType = vk::ImageViewType::e2D,
+		.format   = format,
+		.subresourceRange =
+			vk::ImageSubresourceRange{
+				.aspectMask     = aspect,
+				.baseMipLevel   = 0U,
+				.levelCount     = 1U,
+				.baseArrayLayer = 0U,
+				.layerCount     = 1U,
+			},
+	});
+	return attachment;
+}
+
+void TransientAttachments::DestroyAttachment(const Attachment& attachment) noexcept
+{
+	m_Device.destroy(attachment.View);
+	m_Device.destroy(attachment.Image);
+	m_Allocator->Free(attachment.Allocation);
+}
@@ -0,0 +1,535 @@
+#include <VulkanTutorial/UploadContext.h>
+#include <VulkanTutorial/MipmapGenerator.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+// Good enough for every copy command, optimalBufferCopyOffsetAlignment is
+// at most this on all the hardware that matters
+constexpr vk::DeviceSize BufferChunkAlignment = 16U;
+
+vk::CommandPool CreateCommandPool(const vk::Device device,
+                                  const std::uint32_t queueFamilyIndex)
+{
+	return device.createCommandPool(vk::CommandPoolCreateInfo{
+		.flags = vk::CommandPoolCreateFlagBits::eTransient |
+		         vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = queueFamilyIndex,
+	});
+}
+
+vk::CommandBuffer AllocateCommandBuffer(const vk::Device device,
+                                        const vk::CommandPool commandPool)
+{
+	const std::vector<vk::CommandBuffer> commandBuffers =
+		device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+			.commandPool        = commandPool,
+			.level              = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = 1,
+		});
+	assert(commandBuffers.size() == 1);
+	return commandBuffers.at(0);
+}
+} // namespace
+
+UploadContext::UploadContext(const vk::Device device,
+                             const vk::Queue queue,
+                             const std::uint32_t queueFamilyIndex,
+                             const vk::Queue transferQueue,
+                             const std::uint32_t transferQueueFamily,
+                             DeviceMemoryAllocator& allocator,
+                             GpuProfiler* const profiler,
+                             const vk::DeviceSize stagingSize)
+	: m_Device{ device }
+	, m_Queue{ queue }
+	, m_QueueFamily{ queueFamilyIndex }
+	, m_TransferQueue{ transferQueue }
+	, m_TransferQueueFamily{ transferQueueFamily }
+	, m_CommandPool{ CreateCommandPool(device, queueFamilyIndex) }
+	, m_TransferCommandPool{ HasTransferQueue()
+		                         ? CreateCommandPool(device, transferQueueFamily)
+		                         : vk::CommandPool{} }
+	, m_StagingRing{ device, allocator, stagingSize }
+	, m_Profiler{ profiler }
+{
+}
+
+UploadContext::~UploadContext() noexcept
+{
+	// Whoever destroys us is tearing down the destinations too, uploads that
+	// haven't started yet can be dropped
+	m_Pending.clear();
+
+	try
+	{
+		Submit();
+		WaitIdle();
+	}
+	catch (const vk::SystemError&)
+	{
+		// Device lost, nothing left to wait for, resources are freed below
+		for (Batch& batch : m_InFlight)
+		{
+			Retire(batch);
+			m_FreeBatches.push_back(std::move(batch));
+		}
+		m_InFlight.clear();
+	}
+
+	if (m_Recording.has_value())
+	{
+		m_Device.destroy(m_Recording->Fence);
+		m_Device.destroy(m_Recording->TransferDone);
+	}
+	for (const Batch& batch : m_FreeBatches)
+	{
+		m_Device.destroy(batch.Fence);
+		m_Device.destroy(batch.TransferDone);
+	}
+	// Frees all the command buffers allocated from them as well
+	m_Device.destroy(m_CommandPool);
+	m_Device.destroy(m_TransferCommandPool);
+}
+
+UploadId UploadContext::UploadBuffer(const BufferUploadInfo& uploadInfo,
+                                     UploadWriter writer)
+{
+	assert(uploadInfo.Size > 0U && uploadInfo.Size % uploadInfo.Granularity == 0U);
+
+	const UploadId upload = m_NextUpload++;
+	m_Pending.push_back(PendingUpload{
+		.Id     = upload,
+		.Buffer = uploadInfo,
+		.Writer = std::move(writer),
+	});
+	RecordPendingUploads();
+
+	return upload;
+}
+
+UploadId UploadContext::UploadImage(const ImageUploadInfo& uploadInfo,
+                                    UploadWriter writer)
+{
+	assert(uploadInfo.Extent.width > 0U && uploadInfo.Extent.height > 0U);
+	assert(uploadInfo.SourceLevels > 0U &&
+	       uploadInfo.SourceLevels <= uploadInfo.MipLevels);
+	assert(uploadInfo.SourceLevels == uploadInfo.MipLevels ||
+	       (uploadInfo.SourceLevels == 1U && uploadInfo.Mipmaps != nullptr));
+
+	const UploadId upload = m_NextUpload++;
+	m_Pending.push_back(PendingUpload{
+		.Id     = upload,
+		.Image  = uploadInfo,
+		.Writer = std::move(writer),
+	});
+	RecordPendingUploads();
+
+	return upload;
+}
+
+vk::DeviceSize UploadContext::GetBatchBudget() const noexcept
+{
+	// Leave room for the next batch while this one is in flight, otherwise
+	// streaming would serialise on the staging ring
+	const vk::DeviceSize budget = m_StagingRing.GetSize() / 2U;
+	const vk::DeviceSize staged =
+		m_Recording.has_value() ? m_Recording->StagedBytes : 0U;
+	return budget > staged ? budget - staged : 0U;
+}
+
+void UploadContext::RecordPendingUploads()
+{
+	while (!m_Pending.empty())
+	{
+		PendingUpload& upload = m_Pending.front();
+		const bool recorded   = upload.Buffer.has_value()
+		                            ? RecordBufferChunk(upload)
+		                            : RecordImageChunk(upload);
+		if (!recorded)
+		{
+			// Out of staging space, continue in a later batch
+			return;
+		}
+
+		const bool finished =
+			upload.Buffer.has_value()
+				? upload.Progress == upload.Buffer->Size
+				: upload.Level == upload.Image->SourceLevels;
+		if (finished)
+		{
+			m_Recording->FinishedUpload = upload.Id;
+			m_Pending.pop_front();
+		}
+	}
+}
+
+bool UploadContext::RecordBufferChunk(PendingUpload& upload)
+{
+	const BufferUploadInfo& info = *upload.Buffer;
+
+	const vk::DeviceSize available =
+		std::min(GetBatchBudget(),
+		         m_StagingRing.GetLargestFreeRegion(BufferChunkAlignment));
+	vk::DeviceSize chunkSize = std::min(info.Size - upload.Progress, available);
+	chunkSize -= chunkSize % info.Granularity;
+	if (chunkSize == 0U)
+	{
+		return false;
+	}
+
+	const std::optional<StagingRegion> region =
+		m_StagingRing.TryAllocate(chunkSize, BufferChunkAlignment);
+	assert(region.has_value());
+
+	upload.Writer(region->Data, upload.Progress);
+
+	const vk::BufferCopy copy{
+		.srcOffset = region->Offset,
+		.dstOffset = info.DstOffset + upload.Progress,
+		.size      = chunkSize,
+	};
+	upload.Progress += chunkSize;
+	const bool finished = upload.Progress == info.Size;
+
+	if (HasTransferQueue())
+	{
+		// Timestamps are only written on the graphics queue, these copies
+		// aren't profiled
+		const vk::CommandBuffer transferBuffer = GetTransferCommandBuffer();
+		transferBuffer.copyBuffer(region->Buffer, info.DstBuffer, copy);
+		if (finished)
+		{
+			const BufferOwnershipTransfer transfer{
+				.Buffer         = info.DstBuffer,
+				.Offset         = info.DstOffset,
+				.Size           = info.Size,
+				.SrcQueueFamily = m_TransferQueueFamily,
+				.DstQueueFamily = m_QueueFamily,
+			};
+			ReleaseBufferOwnership(transferBuffer, transfer);
+			AcquireBufferOwnership(GetCommandBuffer(), transfer, info.DstStage,
+			                       info.DstAccess);
+			m_Recording->AcquireStages |= info.DstStage;
+		}
+	}
+	else
+	{
+		const vk::CommandBuffer commandBuffer = GetCommandBuffer();
+		const GpuProfileScope profileScope{ m_Recording->ProfileRange,
+			                                "Upload buffers" };
+		commandBuffer.copyBuffer(region->Buffer, info.DstBuffer, copy);
+		if (finished)
+		{
+			BufferUploadBarrier(commandBuffer, info.DstBuffer, info.DstStage,
+			                    info.DstAccess);
+		}
+	}
+	m_Recording->StagedBytes += chunkSize;
+	return true;
+}
+
+bool UploadContext::RecordImageChunk(PendingUpload& upload)
+{
+	const ImageUploadInfo& info = *upload.Image;
+
+	const vk::Extent2D levelExtent = GetMipExtent(info.Extent, upload.Level);
+	const vk::Extent2D block = info.BlockExtent;
+	const std::uint32_t blockColumns =
+		(levelExtent.width + block.width - 1U) / block.width;
+	const std::uint32_t blockRows =
+		(levelExtent.height + block.height - 1U) / block.height;
+
+	const vk::DeviceSize rowPitch = vk::DeviceSize{ blockColumns } * info.TexelSize;
+	const vk::DeviceSize alignment =
+		std::lcm(BufferChunkAlignment, vk::DeviceSize{ info.TexelSize });
+	if (rowPitch > m_StagingRing.GetSize() / 2U)
+	{
+		throw std::runtime_error{ "Image rows don't fit into the staging ring" };
+	}
+
+	const vk::DeviceSize available =
+		std::min(GetBatchBudget(), m_StagingRing.GetLargestFreeRegion(alignment));
+	const vk::DeviceSize rowCount =
+		std::min(vk::DeviceSize{ blockRows } - upload.Progress,
+				 available / rowPitch);
+	if (rowCount == 0U)
+	{
+		return false;
+	}
+
+	const std::optional<StagingRegion> region =
+		m_StagingRing.TryAllocate(rowCount * rowPitch, alignment);
+	assert(region.has_value());
+
+	upload.Writer(region->Data, upload.LevelOffset + upload.Progress * rowPitch);
+
+	const vk::CommandBuffer commandBuffer = GetCommandBuffer();
+	const GpuProfileScope profileScope{ m_Recording->ProfileRange,
+		                                "Upload images" };
+	if (upload.Level == 0U && upload.Progress == 0U)
+	{
+		TransitionImageLayout(commandBuffer, info.DstImage, info.Format,
+							  vk::ImageLayout::eUndefined,
+							  vk::ImageLayout::eTransferDstOptimal, 0U,
+							  info.MipLevels);
+	}
+
+	// The last row of blocks may hang over the edge of the level
+	const auto firstTexelRow =
+		static_cast<std::uint32_t>(upload.Progress) * block.height;
+	const std::uint32_t texelRowCount =
+		std::min(static_cast<std::uint32_t>(rowCount) * block.height,
+				 levelExtent.height - firstTexelRow);
+	const vk::BufferImageCopy copyRegion{
+		.bufferOffset      = region->Offset,
+		.bufferRowLength   = 0U,
+		.bufferImageHeight = 0U,
+		.imageSubresource =
+			vk::ImageSubresourceLayers{
+				.aspectMask     = vk::ImageAspectFlagBits::eColor,
+				.mipLevel       = upload.Level,
+				.baseArrayLayer = 0U,
+				.layerCount     = 1U,
+			},
+		.imageOffset =
+			vk::Offset3D{
+				.x = 0,
+				.y = static_cast<std::int32_t>(firstTexelRow),
+				.z = 0,
+			},
+		.imageExtent =
+			vk::Extent3D{
+				.width  = levelExtent.width,
+				.height = texelRowCount,
+				.depth  = 1U,
+			},
+	};
+	commandBuffer.copyBufferToImage(region->Buffer, info.DstImage,
+									vk::ImageLayout::eTransferDstOptimal,
+									vk::ArrayProxy{ copyRegion });
+	m_Recording->StagedBytes += rowCount * rowPitch;
+	upload.Progress += rowCount;
+
+	if (upload.Progress < blockRows)
+	{
+		return true;
+	}
+	upload.LevelOffset += vk::DeviceSize{ blockRows } * rowPitch;
+	upload.Progress = 0U;
+	++upload.Level;
+
+	if (upload.Level == info.SourceLevels && info.MipLevels > info.SourceLevels)
+	{
+		const GpuProfileScope mipmapScope{ m_Recording->ProfileRange,
+			                               "Generate mipmaps" };
+		DeferUntilComplete(info.Mipmaps->Generate(commandBuffer, info.DstImage,
+		                                          info.Format, info.Extent,
+		                                          info.MipLevels));
+	}
+	else if (upload.Level == info.SourceLevels)
+	{
+		TransitionImageLayout(commandBuffer, info.DstImage, info.Format,
+							  vk::ImageLayout::eTransferDstOptimal,
+							  vk::ImageLayout::eShaderReadOnlyOptimal, 0U,
+							  info.MipLevels);
+	}
+	return true;
+}
+
+vk::CommandBuffer UploadContext::GetCommandBuffer()
+{
+	if (m_Recording.has_value())
+	{
+		return m_Recording->CommandBuffer;
+	}
+
+	Batch& batch = m_Recording.emplace();
+	if (!m_FreeBatches.empty())
+	{
+		batch = std::move(m_FreeBatches.back());
+		m_FreeBatches.pop_back();
+		batch.CommandBuffer.reset(vk::CommandBufferResetFlags{});
+		if (HasTransferQueue())
+		{
+			batch.TransferCommandBuffer.reset(vk::CommandBufferResetFlags{});
+		}
+		m_Device.resetFences(vk::ArrayProxy{ batch.Fence });
+	}
+	else
+	{
+		batch.CommandBuffer = AllocateCommandBuffer(m_Device, m_CommandPool);
+		batch.Fence         = m_Device.createFence(vk::FenceCreateInfo{});
+		if (HasTransferQueue())
+		{
+			batch.TransferCommandBuffer =
+				AllocateCommandBuffer(m_Device, m_TransferCommandPool);
+			batch.TransferDone =
+				m_Device.createSemaphore(vk::SemaphoreCreateInfo{});
+		}
+	}
+	batch.Ticket            = m_NextTicket;
+	batch.FinishedUpload    = m_CompletedUpload;
+	batch.StagedBytes       = 0U;
+	batch.TransferRecording = false;
+	batch.AcquireStages     = vk::PipelineStageFlags{};
+
+	batch.CommandBuffer.begin(vk::CommandBufferBeginInfo{
+		.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+	});
+	batch.ProfileRange = m_Profiler != nullptr
+	                         ? m_Profiler->BeginRange(batch.CommandBuffer)
+	                         : GpuProfileRange{};
+	return batch.CommandBuffer;
+}
+
+vk::CommandBuffer UploadContext::GetTransferCommandBuffer()
+{
+	assert(HasTransferQueue());
+	// The transfer submission belongs to the batch, whose fence is signaled on
+	// the graphics queue
+	static_cast<void>(GetCommandBuffer());
+	Batch& batch = *m_Recording;
+	if (!batch.TransferRecording)
+	{
+		batch.TransferCommandBuffer.begin(vk::CommandBufferBeginInfo{
+			.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+		});
+		batch.TransferRecording = true;
+	}
+	return batch.TransferCommandBuffer;
+}
+
+void UploadContext::DeferUntilComplete(std::function<void()> callback)
+{
+	// Make sure there is a batch to attach the callback to
+	static_cast<void>(GetCommandBuffer());
+	m_Recording->Callbacks.push_back(std::move(callback));
+}
+
+UploadTicket UploadContext::Submit()
+{
+	RecordPendingUploads();
+
+	if (!m_Recording.has_value())
+	{
+		// Nothing pending, the previous ticket is the latest one there is
+		return m_NextTicket - 1U;
+	}
+
+	Batch& batch = *m_Recording;
+	if (batch.TransferRecording)
+	{
+		batch.TransferCommandBuffer.end();
+		m_TransferQueue.submit(vk::ArrayProxy{
+			vk::SubmitInfo{
+				.commandBufferCount   = 1,
+				.pCommandBuffers      = &batch.TransferCommandBuffer,
+				.signalSemaphoreCount = 1,
+				.pSignalSemaphores    = &batch.TransferDone,
+			},
+		});
+	}
+
+	// Copies of an upload that continues in the next batch have nothing to
+	// acquire yet, the fence still has to wait for them
+	const vk::PipelineStageFlags transferWaitStage =
+		batch.AcquireStages ? batch.AcquireStages
+		                    : vk::PipelineStageFlagBits::eAllCommands;
+	batch.CommandBuffer.end();
+	m_Queue.submit(
+		vk::ArrayProxy{
+			vk::SubmitInfo{
+				.waitSemaphoreCount = batch.TransferRecording ? 1U : 0U,
+				.pWaitSemaphores    = &batch.TransferDone,
+				.pWaitDstStageMask  = &transferWaitStage,
+				.commandBufferCount = 1,
+				.pCommandBuffers    = &batch.CommandBuffer,
+			},
+		},
+		batch.Fence);
+	m_StagingRing.Fence(batch.Ticket);
+
+	const UploadTicket ticket = batch.Ticket;
+	m_InFlight.push_back(std::move(batch));
+	m_Recording.reset();
+	++m_NextTicket;
+
+	return ticket;
+}
+
+void UploadContext::Retire(Batch& batch)
+{
+	for (const std::function<void()>& callback : batch.Callbacks)
+	{
+		callback();
+	}
+	batch.Callbacks.clear();
+	if (m_Profiler != nullptr)
+	{
+		m_Profiler->ResolveRange(batch.ProfileRange);
+	}
+	m_CompletedTicket = batch.Ticket;
+	m_CompletedUpload = std::max(m_CompletedUpload, batch.FinishedUpload);
+}
+
+void UploadContext::CollectCompleted()
+{
+	// Every batch signals its fence on the graphics queue, so they finish in
+	// submission order
+	while (!m_InFlight.empty() &&
+	       m_Device.getFenceStatus(m_InFlight.front().Fence) ==
+	           vk::Result::eSuccess)
+	{
+		Retire(m_InFlight.front());
+		m_FreeBatches.push_back(std::move(m_InFlight.front()));
+		m_InFlight.pop_front();
+	}
+	m_StagingRing.Release(m_CompletedTicket);
+}
+
+void UploadContext::Wait(const UploadTicket ticket)
+{
+	if (ticket >= m_NextTicket)
+	{
+		// Still being recorded, it has to be submitted before it can finish
+		Submit();
+	}
+
+	for (const Batch& batch : m_InFlight)
+	{
+		if (batch.Ticket > ticket)
+		{
+			break;
+		}
+		const vk::Result result = m_Device.waitForFences(
+			vk::ArrayProxy{ batch.Fence }, vk::True,
+			std::numeric_limits<std::uint64_t>::max());
+		if (result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error{ "Failed to wait for upload fence" };
+		}
+	}
+	CollectCompleted();
+}
+
+void UploadContext::WaitIdle()
+{
+	if (!m_InFlight.empty())
+	{
+		Wait(m_InFlight.back().Ticket);
+	}
+}
+
+void UploadContext::Flush()
+{
+	while (HasPendingUploads() || m_Recording.has_value())
+	{
+		Submit();
+		WaitIdle();
+	}
+}
@@ -0,0 +1,398 @@
+#include <VulkanTutorial/UpscalePass.h>
+#include <VulkanTutorial/VulkanHelpers.h>
+
+#include <fmt/core.h>
+
+#include <array>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+// Matches the push constants in upscale.frag
+struct UpscalePushConstants
+{
+	std::array<float, 2> UvScale{};
+	std::array<float, 2> UvMax{};
+};
+
+constexpr vk::PushConstantRange UpscalePushConstantRange{
+	.stageFlags = vk::ShaderStageFlagBits::eFragment,
+	.offset     = 0U,
+	.size       = sizeof(UpscalePushConstants),
+};
+} // namespace
+
+UpscalePass::UpscalePass(const vk::Device device,
+                         DeviceMemoryAllocator& allocator,
+                         const vk::PipelineCache pipelineCache,
+                         const vk::ShaderModule vertexShader,
+                         const vk::ShaderModule fragmentShader,
+                         const vk::Format colorFormat,
+                         const vk::ImageLayout finalLayout,
+                         const bool dynamicRendering)
+	: m_Device{ device }
+	, m_Allocator{ &allocator }
+	, m_ColorFormat{ colorFormat }
+	, m_FinalLayout{ finalLayout }
+	, m_DynamicRendering{ dynamicRendering }
+{
+	// Clamped, the unrendered rest of the scene image is never sampled
+	m_Sampler = m_Device.createSampler(vk::SamplerCreateInfo{
+		.magFilter    = vk::Filter::eLinear,
+		.minFilter    = vk::Filter::eLinear,
+		.mipmapMode   = vk::SamplerMipmapMode::eNearest,
+		.addressModeU = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeV = vk::SamplerAddressMode::eClampToEdge,
+		.addressModeW = vk::SamplerAddressMode::eClampToEdge,
+		.maxLod       = 0.F,
+		.borderColor  = vk::BorderColor::eIntOpaqueBlack,
+	});
+
+	const vk::DescriptorSetLayoutBinding sceneBinding{
+		.binding            = 0U,
+		.descriptorType     = vk::DescriptorType::eCombinedImageSampler,
+		.descriptorCount    = 1U,
+		.stageFlags         = vk::ShaderStageFlagBits::eFragment,
+		.pImmutableSamplers = &m_Sampler,
+	};
+	m_DescriptorSetLayout =
+		m_Device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{
+			.bindingCount = 1U,
+			.pBindings    = &sceneBinding,
+		});
+
+	std::tie(m_ColorBlendState, m_PipelineLayout) =
+		CreatePipelineLayoutInfo(m_Device, m_DescriptorSetLayout,
+		                         std::span{ &UpscalePushConstantRange, 1U });
+	if (!m_DynamicRendering)
+	{
+		CreateRenderPass();
+	}
+	m_Pipeline = BuildPipeline(pipelineCache, vertexShader, fragmentShader);
+}
+
+UpscalePass::~UpscalePass() noexcept
+{
+	DestroyImages();
+	m_Device.destroy(m_Pipeline);
+	m_Device.destroy(m_RenderPass);
+	m_Device.destroy(m_PipelineLayout);
+	m_Device.destroy(m_DescriptorSetLayout);
+	m_Device.destroy(m_Sampler);
+}
+
+void UpscalePass::CreateRenderPass()
+{
+	// Every pixel is overwritten, the previous contents aren't loaded
+	const vk::AttachmentDescription colorAttachment{
+		.format         = m_ColorFormat,
+		.samples        = vk::SampleCountFlagBits::e1,
+		.loadOp         = vk::AttachmentLoadOp::eDontCare,
+		.storeOp        = vk::AttachmentStoreOp::eStore,
+		.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
+		.stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
+		.initialLayout  = vk::ImageLayout::eUndefined,
+		.finalLayout    = m_FinalLayout,
+	};
+	constexpr vk::AttachmentReference ColorAttachmentRef{
+		.attachment = 0U,
+		.layout     = vk::ImageLayout::eColorAttachmentOptimal,
+	};
+	const vk::SubpassDescription subpassDescription{
+		.pipelineBindPoint    = vk::PipelineBindPoint::eGraphics,
+		.colorAttachmentCount = 1U,
+		.pColorAttachments    = &ColorAttachmentRef,
+	};
+
+	// The scene's render pass has to be done writing what is sampled here
+	constexpr vk::SubpassDependency Dependency{
+		.srcSubpass    = VK_SUBPASS_EXTERNAL,
+		.dstSubpass    = 0U,
+		.srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		.dstStageMask  = vk::PipelineStageFlagBits::eFragmentShader |
+		                 vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+		.dstAccessMask = vk::AccessFlagBits::eShaderRead |
+		                 vk::AccessFlagBits::eColorAttachmentWrite,
+	};
+
+	m_RenderPass = m_Device.createRenderPass(vk::RenderPassCreateInfo{
+		.attachmentCount = 1U,
+		.pAttachments    = &colorAttachment,
+		.subpassCount    = 1U,
+		.pSubpasses      = &subpassDescription,
+		.dependencyCount = 1U,
+		.pDependencies   = &Dependency,
+	});
+}
+
+vk::Pipeline UpscalePass::BuildPipeline(const vk::PipelineCache pipelineCache,
+                                        const vk::ShaderModule vertexShader,
+                                        const vk::ShaderModule fragmentShader) const
+{
+	const std::array<vk::PipelineShaderStageCreateInfo, 2> shaderInfo{
+		vk::PipelineShaderStageCreateInfo{
+			.stage  = vk::ShaderStageFlagBits::eVertex,
+			.module = vertexShader,
+			.pName  = "main",
+		},
+		vk::PipelineShaderStageCreateInfo{
+			.stage  = vk::ShaderStageFlagBits::eFragment,
+			.module = fragmentShader,
+			.pName  = "main",
+		},
+	};
+
+	constexpr std::array<vk::DynamicState, 2> DynamicStates{
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor,
+	};
+	const vk::PipelineDynamicStateCreateInfo pipelineDynamicState{
+		.dynamicStateCount = static_cast<std::uint32_t>(DynamicStates.size()),
+		.pDynamicStates    = DynamicStates.data(),
+	};
+	// The triangle is generated from the vertex index
+	constexpr vk::PipelineVertexInputStateCreateInfo VertexInputInfo{};
+	constexpr vk::PipelineInputAssemblyStateCreateInfo InputAssemblyInfo{
+		.topology               = vk::PrimitiveTopology::eTriangleList,
+		.primitiveRestartEnable = VK_FALSE,
+	};
+	constexpr vk::PipelineViewportStateCreateInfo DynamicViewportInfo{
+		.viewportCount = 1,
+		.scissorCount  = 1,
+	};
+	constexpr vk::PipelineRasterizationStateCreateInfo RasterizationInfo{
+		.depthClampEnable        = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode             = vk::PolygonMode::eFill,
+		.cullMode                = vk::CullModeFlagBits::eNone,
+		.frontFace               = vk::FrontFace::eCounterClockwise,
+		.depthBiasEnable         = VK_FALSE,
+		.lineWidth               = 1.F,
+	};
+	constexpr vk::PipelineMultisampleStateCreateInfo Multisampling{
+		.rasterizationSamples = vk::SampleCountFlagBits::e1,
+		.sampleShadingEnable  = VK_FALSE,
+		.minSampleShading     = 1.F,
+	};
+
+	const vk::PipelineRenderingCreateInfo renderingInfo{
+		.colorAttachmentCount    = 1U,
+		.pColorAttachmentFormats = &m_ColorFormat,
+	};
+
+	auto [createPipelineResult, pipeline] = m_Device.createGraphicsPipeline(
+		pipelineCache,
+		vk::GraphicsPipelineCreateInfo{
+			.pNext               = m_DynamicRendering ? &renderingInfo : nullptr,
+			.stageCount          = static_cast<std::uint32_t>(shaderInfo.size()),
+			.pStages             = shaderInfo.data(),
+			.pVertexInputState   = &VertexInputInfo,
+			.pInputAssemblyState = &InputAssemblyInfo,
+			.pViewportState      = &DynamicViewportInfo,
+			.pRasterizationState = &RasterizationInfo,
+			.pMultisampleState   = &Multisampling,
+			.pColorBlendState    = &m_ColorBlendState,
+			.pDynamicState       = &pipelineDynamicState,
+			.layout              = m_PipelineLayout,
+			.renderPass          = m_RenderPass,
+			.subpass             = 0,
+			.basePipelineIndex   = -1,
+		});
+	if (createPipelineResult != vk::Result::eSuccess)
+	{
+		throw std::runtime_error{
+			fmt::format("Failed to create upscale pipeline: {}",
+			            vk::to_string(createPipelineResult)),
+		};
+	}
+	return pipeline;
+}
+
+vk::Pipeline UpscalePass::SwapPipeline(const vk::Pipeline pipeline) noexcept
+{
+	return std::exchange(m_Pipeline, pipeline);
+}
+
+void UpscalePass::CreateImages(const vk::Extent2D extent,
+                               const std::span<const vk::ImageView> targetViews)
+{
+	m_Extent = extent;
+	const auto imageCount = static_cast<std::uint32_t>(targetViews.size());
+
+	const vk::DescriptorPoolSize poolSize{
+		.type            = vk::DescriptorType::eCombinedImageSampler,
+		.descriptorCount = imageCount,
+	};
+	m_DescriptorPool = m_Device.createDescriptorPool(vk::DescriptorPoolCreateInfo{
+		.maxSets       = imageCount,
+		.poolSizeCount = 1U,
+		.pPoolSizes    = &poolSize,
+	});
+
+	m_SceneImages.resize(imageCount);
+	for (std::uint32_t i{ 0U }; i < imageCount; ++i)
+	{
+		SceneImage& scene = m_SceneImages.at(i);
+		std::tie(scene.Image, scene.Allocation) = CreateDeviceImage(
+			vk::ImageCreateInfo{
+				.imageType   = vk::ImageType::e2D,
+				.format      = m_ColorFormat,
+				.extent      = vk::Extent3D{ extent.width, extent.height, 1U },
+				.mipLevels   = 1U,
+				.arrayLayers = 1U,
+				.samples     = vk::SampleCountFlagBits::e1,
+				.tiling      = vk::ImageTiling::eOptimal,
+				.usage       = vk::ImageUsageFlagBits::eColorAttachment |
+				               vk::ImageUsageFlagBits::eSampled,
+				.sharingMode   = vk::SharingMode::eExclusive,
+				.initialLayout = vk::ImageLayout::eUndefined,
+			},
+			vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
+			m_Device, *m_Allocator);
+
+		scene.View = m_Device.createImageView(vk::ImageViewCreateInfo{
+			.image    = scene.Image,
+			.viewType = vk::ImageViewType::e2D,
+			.format   = m_ColorFormat,
+			.subresourceRange =
+				vk::ImageSubresourceRange{
+					.aspectMask     = vk::ImageAspectFlagBits::eColor,
+					.baseMipLevel   = 0U,
+					.levelCount     = 1U,
+					.baseArrayLayer = 0U,
+					.layerCount     = 1U,
+				},
+		});
+
+		const std::vector<vk::DescriptorSet> descriptorSets =
+			m_Device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
+				.descriptorPool     = m_DescriptorPool,
+				.descriptorSetCount = 1U,
+				.pSetLayouts        = &m_DescriptorSetLayout,
+			});
+		scene.DescriptorSet = descriptorSets.front();
+		const vk::DescriptorImageInfo imageInfo{
+			.imageView   = scene.View,
+			.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+		};
+		m_Device.updateDescriptorSets(
+			vk::ArrayProxy<const vk::WriteDescriptorSet>{
+				vk::WriteDescriptorSet{
+					.dstSet          = scene.DescriptorSet,
+					.dstBinding      = 0U,
+					.dstArrayElement = 0U,
+					.descriptorCount = 1U,
+					.descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+					.pImageInfo      = &imageInfo,
+				},
+			},
+			vk::ArrayProxy<const vk::CopyDescriptorSet>{});
+
+		if (!m_DynamicRendering)
+		{
+			scene.Framebuffer =
+				m_Device.createFramebuffer(vk::FramebufferCreateInfo{
+					.renderPass      = m_RenderPass,
+					.attachmentCount = 1U,
+					.pAttachments    = &targetViews[i],
+					.width           = extent.width,
+					.height          = extent.height,
+					.layers          = 1U,
+				});
+		}
+	}
+}
+
+void UpscalePass::DestroyImages() noexcept
+{
+	for (const SceneImage& scene : m_SceneImages)
+	{
+		m_Device.destroy(scene.Framebuffer);
+		m_Device.destroy(scene.View);
+		m_Device.destroy(scene.Image);
+		m_Allocator->Free(scene.Allocation);
+	}
+	m_SceneImages.clear();
+	// Frees the descriptor sets as well
+	m_Device.destroy(m_DescriptorPool);
+	m_DescriptorPool = vk::DescriptorPool{};
+}
+
+void UpscalePass::Record(const vk::CommandBuffer commandBuffer,
+                         const std::uint32_t idx,
+                         const vk::Image targetImage,
+                         const vk::ImageView targetView,
+                         const vk::Extent2D sceneExtent) const
+{
+	const SceneImage& scene = m_SceneImages.at(idx);
+	const vk::Rect2D renderArea{ vk::Offset2D{ 0, 0 }, m_Extent };
+	if (m_DynamicRendering)
+	{
+		TransitionImageLayout(commandBuffer, targetImage, m_ColorFormat,
+		                      vk::ImageLayout::eUndefined,
+		                      vk::ImageLayout::eColorAttachmentOptimal);
+		const vk::RenderingAttachmentInfo colorAttachment{
+			.imageView   = targetView,
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+			.loadOp      = vk::AttachmentLoadOp::eDontCare,
+			.storeOp     = vk::AttachmentStoreOp::eStore,
+		};
+		commandBuffer.beginRendering(vk::RenderingInfo{
+			.renderArea           = renderArea,
+			.layerCount           = 1U,
+			.colorAttachmentCount = 1U,
+			.pColorAttachments    = &colorAttachment,
+		});
+	}
+	else
+	{
+		commandBuffer.beginRenderPass(
+			vk::RenderPassBeginInfo{
+				.renderPass  = m_RenderPass,
+				.framebuffer = scene.Framebuffer,
+				.renderArea  = renderArea,
+			},
+			vk::SubpassContents::eInline);
+	}
+
+	const auto width  = static_cast<float>(m_Extent.width);
+	const auto height = static_cast<float>(m_Extent.height);
+	const vk::Viewport viewport{
+		.x        = 0.F,
+		.y        = 0.F,
+		.width    = width,
+		.height   = height,
+		.minDepth = 0.F,
+		.maxDepth = 1.F,
+	};
+	// Half a texel in, so filtering never reaches past the rendered part
+	const auto sceneWidth  = static_cast<float>(sceneExtent.width);
+	const auto sceneHeight = static_cast<float>(sceneExtent.height);
+	const UpscalePushConstants pushConstants{
+		.UvScale = { sceneWidth / width, sceneHeight / height },
+		.UvMax   = { (sceneWidth - 0.5F) / width, (sceneHeight - 0.5F) / height },
+	};
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_Pipeline);
+	commandBuffer.setViewport(0U, vk::ArrayProxy{ viewport });
+	commandBuffer.setScissor(0U, vk::ArrayProxy{ renderArea });
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+	                                 m_PipelineLayout, 0,
+	                                 vk::ArrayProxy{ scene.DescriptorSet },
+	                                 vk::ArrayProxy<const uint32_t>{});
+	commandBuffer.pushConstants(m_PipelineLayout,
+	                            UpscalePushConstantRange.stageFlags, 0U,
+	                            UpscalePushConstantRange.size, &pushConstants);
+	commandBuffer.draw(3U, 1U, 0U, 0U);
+
+	if (!m_DynamicRendering)
+	{
+		commandBuffer.endRenderPass();
+		return;
+	}
+	commandBuffer.endRendering();
+	TransitionImageLayout(commandBuffer, targetImage, m_ColorFormat,
+	                      vk::ImageLayout::eColorAttachmentOptimal, m_FinalLayout);
+}
@@ -1,26 +1,37 @@
 #include <VulkanTutorial/VulkanHelpers.h>
 
+#include <array>
+#include <stdexcept>
+#include <vector>
+
 vk::RenderPass CreateRenderPass(const vk::Device device,
                                 const VkFormat colorFormat,
                                 const VkFormat depthFormat,
-                                const std::uint32_t sampleCount)
+                                const std::uint32_t sampleCount,
+                                const vk::ImageLayout resolveLayout)
 {
+	const auto samples      = static_cast<vk::SampleCountFlagBits>(sampleCount);
+	const bool multisampled = samples != vk::SampleCountFlagBits::e1;
+	const vk::ImageLayout colorFinalLayout =
+		multisampled ? vk::ImageLayout::eColorAttachmentOptimal : resolveLayout;
+
 	const std::array attachments{
-		// Color attachment
+		// Color attachment, only needed until it is resolved when multisampled
 		vk::AttachmentDescription{
 			.format         = static_cast<vk::Format>(colorFormat),
-			.samples        = static_cast<vk::SampleCountFlagBits>(sampleCount),
+			.samples        = samples,
 			.loadOp         = vk::AttachmentLoadOp::eClear,
-			.storeOp        = vk::AttachmentStoreOp::eStore,
+			.storeOp        = multisampled ? vk::AttachmentStoreOp::eDontCare
+			                               : vk::AttachmentStoreOp::eStore,
 			.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
 			.stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
 			.initialLayout  = vk::ImageLayout::eUndefined,
-			.finalLayout    = vk::ImageLayout::eColorAttachmentOptimal,
+			.finalLayout    = colorFinalLayout,
 		},
 		// Depth stencil attachment
 		vk::AttachmentDescription{
 			.format         = static_cast<vk::Format>(depthFormat),
-			.samples        = static_cast<vk::SampleCountFlagBits>(sampleCount),
+			.samples        = samples,
 			.loadOp         = vk::AttachmentLoadOp::eClear,
 			.storeOp        = vk::AttachmentStoreOp::eDontCare,
 			.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
@@ -37,7 +48,7 @@ vk::RenderPass CreateRenderPass(const vk::Device device,
 			.stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
 			.stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
 			.initialLayout  = vk::ImageLayout::eUndefined,
-			.finalLayout    = vk::ImageLayout::ePresentSrcKHR,
+			.finalLayout    = resolveLayout,
 		},
 	};
 
@@ -58,7 +69,8 @@ vk::RenderPass CreateRenderPass(const vk::Device device,
 		.pipelineBindPoint       = vk::PipelineBindPoint::eGraphics,
 		.colorAttachmentCount    = 1U,
 		.pColorAttachments       = &ColorAttachmentRef,
-		.pResolveAttachments     = &ColorAttachmentResolveRef,
+		.pResolveAttachments =
+			multisampled ? &ColorAttachmentResolveRef : nullptr,
 		.pDepthStencilAttachment = &DepthAttachmentRef,
 	};
 
@@ -74,7 +86,8 @@ vk::RenderPass CreateRenderPass(const vk::Device device,
 	};
 
 	return device.createRenderPass(vk::RenderPassCreateInfo{
-		.attachmentCount = static_cast<std::uint32_t>(size(attachments)),
+		// Without multisampling the target's image is the color attachment
+		.attachmentCount = multisampled ? 3U : 2U,
 		.pAttachments    = attachments.data(),
 		.subpassCount    = 1U,
 		.pSubpasses      = &subpassDescription,
@@ -84,8 +97,10 @@ vk::RenderPass CreateRenderPass(const vk::Device device,
 }
 
 std::tuple<vk::PipelineColorBlendStateCreateInfo, vk::PipelineLayout>
-CreatePipelineLayoutInfo(const vk::Device device,
-						 const vk::DescriptorSetLayout descriptorSetLayout)
+CreatePipelineLayoutInfo(
+	const vk::Device device,
+	const vk::DescriptorSetLayout descriptorSetLayout,
+	const std::span<const vk::PushConstantRange> pushConstantRanges)
 {
 	// Band-aid as we need to return address outside of the
 	// function...
@@ -113,6 +128,9 @@ CreatePipelineLayoutInfo(const vk::Device device,
 		device.createPipelineLayout(vk::PipelineLayoutCreateInfo{
 			.setLayoutCount = 1U,
 			.pSetLayouts    = &descriptorSetLayout,
+			.pushConstantRangeCount =
+				static_cast<std::uint32_t>(pushConstantRanges.size()),
+			.pPushConstantRanges = pushConstantRanges.data(),
 		}),
 	};
 }
@@ -136,12 +154,12 @@ std::uint32_t FindMemoryType(const vk::PhysicalDevice physicalDevice,
 	throw std::runtime_error{ "Failed to find suitable memory for buffer" };
 }
 
-std::tuple<vk::Buffer, vk::DeviceMemory> CreateDeviceBuffer(
+std::tuple<vk::Buffer, DeviceAllocation> CreateDeviceBuffer(
     const vk::DeviceSize bufferSize,
     const vk::BufferUsageFlags bufferFlags,
     const vk::MemoryPropertyFlags memoryFlags,
     const vk::Device device,
-    const vk::PhysicalDevice physicalDevie)
+    DeviceMemoryAllocator& allocator)
 {
 	const vk::Buffer deviceBuffer = device.createBuffer(vk::BufferCreateInfo{
 		.size        = bufferSize,
@@ -149,84 +167,174 @@ std::tuple<vk::Buffer, vk::DeviceMemory> CreateDeviceBuffer(
 		.sharingMode = vk::SharingMode::eExclusive,
 	});
 
-	const vk::MemoryRequirements memoryRequirements =
-		device.getBufferMemoryRequirements(deviceBuffer);
+	const DeviceAllocation allocation =
+		allocator.Allocate(device.getBufferMemoryRequirements(deviceBuffer),
+		                   memoryFlags, ResourceTiling::Linear);
+	device.bindBufferMemory(deviceBuffer, allocation.Memory, allocation.Offset);
 
-	const vk::DeviceMemory deviceMemory =
-		device.allocateMemory(vk::MemoryAllocateInfo{
-			.allocationSize  = vk::DeviceSize{ memoryRequirements.size },
-			.memoryTypeIndex = FindMemoryType(physicalDevie, memoryFlags,
-											  memoryRequirements.memoryTypeBits),
-		});
-	device.bindBufferMemory(deviceBuffer, deviceMemory, vk::DeviceSize{ 0 });
+	return std::tuple{ deviceBuffer, allocation };
+}
 
-	return std::tuple{ deviceBuffer, deviceMemory };
+std::tuple<vk::Image, DeviceAllocation> CreateDeviceImage(
+    const vk::ImageCreateInfo& imageCreateInfo,
+    const vk::MemoryPropertyFlags memoryFlags,
+    const vk::Device device,
+    DeviceMemoryAllocator& allocator)
+{
+	const vk::Image deviceImage = device.createImage(imageCreateInfo);
+
+	const ResourceTiling tiling = imageCreateInfo.tiling == vk::ImageTiling::eLinear
+	                                  ? ResourceTiling::Linear
+	                                  : ResourceTiling::Optimal;
+	const DeviceAllocation allocation = allocator.Allocate(
+		device.getImageMemoryRequirements(deviceImage), memoryFlags, tiling);
+	device.bindImageMemory(deviceImage, allocation.Memory, allocation.Offset);
+
+	return std::tuple{ deviceImage, allocation };
+}
+
+vk::SampleCountFlagBits PickSampleCount(const vk::PhysicalDevice physicalDevice)
+{
+	const vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+	const vk::SampleCountFlags supported =
+		limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+	constexpr std::array SampleCounts{
+		vk::SampleCountFlagBits::e16,
+		vk::SampleCountFlagBits::e8,
+		vk::SampleCountFlagBits::e4,
+	};
+	for (const vk::SampleCountFlagBits samples : SampleCounts)
+	{
+		if (supported & samples)
+		{
+			return samples;
+		}
+	}
+	return vk::SampleCountFlagBits::e1;
 }
 
-void CopyBuffer(const vk::Buffer dstBuffer,
+vk::Format PickDepthStencilFormat(const vk::PhysicalDevice physicalDevice)
+{
+	constexpr std::array DepthStencilFormats{
+		vk::Format::eD24UnormS8Uint,
+		vk::Format::eD32SfloatS8Uint,
+		vk::Format::eD16UnormS8Uint,
+	};
+	for (const vk::Format format : DepthStencilFormats)
+	{
+		const vk::FormatFeatureFlags features =
+			physicalDevice.getFormatProperties(format).optimalTilingFeatures;
+		if (features & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+		{
+			return format;
+		}
+	}
+	throw std::runtime_error{ "Device doesn't support any depth stencil format" };
+}
+
+std::optional<std::uint32_t> FindDedicatedQueueFamily(
+	const std::span<const vk::QueueFamilyProperties> queueFamilies,
+	const vk::QueueFlags wanted,
+	const vk::QueueFlags excluded)
+{
+	for (std::uint32_t idx{ 0U }; idx < queueFamilies.size(); ++idx)
+	{
+		const vk::QueueFlags flags = queueFamilies[idx].queueFlags;
+		if ((flags & wanted) == wanted && !(flags & excluded))
+		{
+			return idx;
+		}
+	}
+	return std::nullopt;
+}
+
+void CopyBuffer(const vk::CommandBuffer commandBuffer,
+                const vk::Buffer dstBuffer,
                 const vk::Buffer srcBuffer,
-                const vk::DeviceSize size,
-                const vk::CommandPool commandPool,
-                const vk::Device device,
-                const vk::Queue graphicsQueue)
+                const vk::DeviceSize size)
 {
-	// Create a command buffer to copy buffers around
-	const vk::CommandBuffer commandBuffer =
-		BeginSingleTimeCommands(device, commandPool);
 	commandBuffer.copyBuffer(srcBuffer, dstBuffer,
 							 vk::BufferCopy{
 								 .srcOffset = vk::DeviceSize{ 0 },
 								 .dstOffset = vk::DeviceSize{ 0 },
 								 .size      = vk::DeviceSize{ size },
 							 });
-	EndSingleTimeCommands(commandBuffer, graphicsQueue);
 }
 
-vk::CommandBuffer BeginSingleTimeCommands(const vk::Device device,
-										  const vk::CommandPool commandPool)
+void BufferUploadBarrier(const vk::CommandBuffer commandBuffer,
+                         const vk::Buffer buffer,
+                         const vk::PipelineStageFlags dstStage,
+                         const vk::AccessFlags dstAccess)
 {
-	const std::vector<vk::CommandBuffer> commandBuffers =
-		device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
-			.commandPool        = commandPool,
-			.level              = vk::CommandBufferLevel::ePrimary,
-			.commandBufferCount = 1,
-		});
-
-	assert(commandBuffers.size() == 1);
-	vk::CommandBuffer commandBuffer = commandBuffers.at(0);
-
-	commandBuffer.begin(vk::CommandBufferBeginInfo{
-		.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
-	});
+	const vk::BufferMemoryBarrier barrier{
+		.srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
+		.dstAccessMask       = dstAccess,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer              = buffer,
+		.offset              = vk::DeviceSize{ 0 },
+		.size                = VK_WHOLE_SIZE,
+	};
 
-	return commandBuffer;
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer, dstStage, vk::DependencyFlags{},
+		vk::ArrayProxy<const vk::MemoryBarrier>{},
+		vk::ArrayProxy<const vk::BufferMemoryBarrier>{ barrier },
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{});
 }
 
-void EndSingleTimeCommands(const vk::CommandBuffer commandBuffer,
-						   const vk::Queue queue)
+void ReleaseBufferOwnership(const vk::CommandBuffer commandBuffer,
+                            const BufferOwnershipTransfer& transfer)
 {
-	commandBuffer.end();
+	const vk::BufferMemoryBarrier barrier{
+		.srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
+		.dstAccessMask       = vk::AccessFlags{},
+		.srcQueueFamilyIndex = transfer.SrcQueueFamily,
+		.dstQueueFamilyIndex = transfer.DstQueueFamily,
+		.buffer              = transfer.Buffer,
+		.offset              = transfer.Offset,
+		.size                = transfer.Size,
+	};
 
-	queue.submit(vk::ArrayProxy{
-		vk::SubmitInfo{
-			.commandBufferCount = 1,
-			.pCommandBuffers    = &commandBuffer,
-		},
-	});
-	queue.waitIdle();
+	// The destination scope of a release is ignored
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,
+		vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags{},
+		vk::ArrayProxy<const vk::MemoryBarrier>{},
+		vk::ArrayProxy<const vk::BufferMemoryBarrier>{ barrier },
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{});
+}
+
+void AcquireBufferOwnership(const vk::CommandBuffer commandBuffer,
+                            const BufferOwnershipTransfer& transfer,
+                            const vk::PipelineStageFlags dstStage,
+                            const vk::AccessFlags dstAccess)
+{
+	const vk::BufferMemoryBarrier barrier{
+		.srcAccessMask       = vk::AccessFlags{},
+		.dstAccessMask       = dstAccess,
+		.srcQueueFamilyIndex = transfer.SrcQueueFamily,
+		.dstQueueFamilyIndex = transfer.DstQueueFamily,
+		.buffer              = transfer.Buffer,
+		.offset              = transfer.Offset,
+		.size                = transfer.Size,
+	};
+
+	// Starting at the stage the semaphore waits at chains it after the release
+	commandBuffer.pipelineBarrier(
+		dstStage, dstStage, vk::DependencyFlags{},
+		vk::ArrayProxy<const vk::MemoryBarrier>{},
+		vk::ArrayProxy<const vk::BufferMemoryBarrier>{ barrier },
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{});
 }
 
-void CopyBufferToImage(const vk::Buffer buffer,
+void CopyBufferToImage(const vk::CommandBuffer commandBuffer,
+                       const vk::Buffer buffer,
                        const vk::Image image,
                        const uint32_t width,
-                       const uint32_t height,
-                       const vk::Device device,
-                       const vk::CommandPool commandPool,
-                       const vk::Queue queue)
+                       const uint32_t height)
 {
-	const vk::CommandBuffer commandBuffer =
-		BeginSingleTimeCommands(device, commandPool);
-
 	const vk::BufferImageCopy region{
 		.bufferOffset      = vk::DeviceSize{ 0 },
 		.bufferRowLength   = 0U,
@@ -244,39 +352,34 @@ void CopyBufferToImage(const vk::Buffer buffer,
 	commandBuffer.copyBufferToImage(buffer, image,
 									vk::ImageLayout::eTransferDstOptimal,
 									vk::ArrayProxy{ region });
-
-	EndSingleTimeCommands(commandBuffer, queue);
 }
 
-void TransitionImageLayout(const vk::Image image,
-                           [[maybe_unused]] const vk::Format format,
-                           const vk::ImageLayout oldLayout,
-                           const vk::ImageLayout newLayout,
-                           const vk::Device device,
-                           const vk::CommandPool commandPool,
-                           const vk::Queue workQueue)
+ImageLayoutBarrier MakeImageLayoutBarrier(const vk::Image image,
+                                          const vk::ImageLayout oldLayout,
+                                          const vk::ImageLayout newLayout,
+                                          const std::uint32_t baseMipLevel,
+                                          const std::uint32_t levelCount)
 {
-	const vk::CommandBuffer commandBuffer =
-		BeginSingleTimeCommands(device, commandPool);
-
-	vk::ImageMemoryBarrier barrier{
-		.oldLayout           = oldLayout,
-		.newLayout           = newLayout,
-		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-		.image               = image,
-		.subresourceRange =
-			vk::ImageSubresourceRange{
-				.aspectMask     = vk::ImageAspectFlagBits::eColor,
-				.baseMipLevel   = 0U,
-				.levelCount     = 1U,
-				.baseArrayLayer = 0U,
-				.layerCount     = 1U,
+	ImageLayoutBarrier layoutBarrier{
+		.Barrier =
+			vk::ImageMemoryBarrier{
+				.oldLayout           = oldLayout,
+				.newLayout           = newLayout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image               = image,
+				.subresourceRange =
+					vk::ImageSubresourceRange{
+						.aspectMask     = vk::ImageAspectFlagBits::eColor,
+						.baseMipLevel   = baseMipLevel,
+						.levelCount     = levelCount,
+						.baseArrayLayer = 0U,
+						.layerCount     = 1U,
+					},
 			},
 	};
+	vk::ImageMemoryBarrier& barrier = layoutBarrier.Barrier;
 
-	vk::PipelineStageFlags sourceStage{};
-	vk::PipelineStageFlags destinationStage{};
 	if (oldLayout == vk::ImageLayout::eUndefined &&
 		newLayout == vk::ImageLayout::eTransferDstOptimal)
 	{
@@ -284,29 +387,172 @@ void TransitionImageLayout(const vk::Image image,
 		barrier.dstAccessMask =
 			vk::AccessFlags{ vk::AccessFlagBits::eTransferWrite };
 
-		sourceStage      = vk::PipelineStageFlagBits::eTopOfPipe;
-		destinationStage = vk::PipelineStageFlagBits::eTransfer;
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eTopOfPipe;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eTransfer;
+	}
+	else if (oldLayout == vk::ImageLayout::eTransferDstOptimal &&
+			 newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eTransferWrite };
+		barrier.dstAccessMask = vk::AccessFlags{ vk::AccessFlagBits::eShaderRead };
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eTransfer;
+		// Also read by the compute mipmap generation
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eFragmentShader |
+		                         vk::PipelineStageFlagBits::eComputeShader;
 	}
 	else if (oldLayout == vk::ImageLayout::eTransferDstOptimal &&
+			 newLayout == vk::ImageLayout::eTransferSrcOptimal)
+	{
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eTransferWrite };
+		barrier.dstAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eTransferRead };
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eTransfer;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eTransfer;
+	}
+	else if (oldLayout == vk::ImageLayout::eTransferSrcOptimal &&
 			 newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eTransferRead };
+		barrier.dstAccessMask = vk::AccessFlags{ vk::AccessFlagBits::eShaderRead };
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eTransfer;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eFragmentShader;
+	}
+	else if (oldLayout == vk::ImageLayout::eTransferDstOptimal &&
+			 newLayout == vk::ImageLayout::eGeneral)
 	{
 		barrier.srcAccessMask =
 			vk::AccessFlags{ vk::AccessFlagBits::eTransferWrite };
+		barrier.dstAccessMask = vk::AccessFlags{ vk::AccessFlagBits::eShaderWrite };
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eTransfer;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eComputeShader;
+	}
+	else if (oldLayout == vk::ImageLayout::eGeneral &&
+			 newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		barrier.srcAccessMask = vk::AccessFlags{ vk::AccessFlagBits::eShaderWrite };
+		barrier.dstAccessMask = vk::AccessFlags{ vk::AccessFlagBits::eShaderRead };
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eComputeShader;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eFragmentShader |
+		                         vk::PipelineStageFlagBits::eComputeShader;
+	}
+	// Attachments of dynamic rendering, the previous frame's writes to the
+	// shared depth buffer and to the image have to be finished
+	else if (oldLayout == vk::ImageLayout::eUndefined &&
+			 newLayout == vk::ImageLayout::eColorAttachmentOptimal)
+	{
+		barrier.srcAccessMask = vk::AccessFlags{};
+		barrier.dstAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eColorAttachmentWrite };
+
+		// Scene images were sampled by the previous frame's upscale
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+		                         vk::PipelineStageFlagBits::eFragmentShader;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	}
+	else if (oldLayout == vk::ImageLayout::eColorAttachmentOptimal &&
+			 newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
+	{
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eColorAttachmentWrite };
 		barrier.dstAccessMask = vk::AccessFlags{ vk::AccessFlagBits::eShaderRead };
 
-		sourceStage      = vk::PipelineStageFlagBits::eTransfer;
-		destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eFragmentShader;
+	}
+	else if (oldLayout == vk::ImageLayout::eUndefined &&
+			 newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal)
+	{
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth |
+		                                      vk::ImageAspectFlagBits::eStencil;
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eDepthStencilAttachmentWrite };
+		barrier.dstAccessMask =
+			vk::AccessFlagBits::eDepthStencilAttachmentRead |
+			vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eLateFragmentTests;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eEarlyFragmentTests |
+		                         vk::PipelineStageFlagBits::eLateFragmentTests;
+	}
+	else if (oldLayout == vk::ImageLayout::eColorAttachmentOptimal &&
+			 newLayout == vk::ImageLayout::ePresentSrcKHR)
+	{
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eColorAttachmentWrite };
+		barrier.dstAccessMask = vk::AccessFlags{};
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eBottomOfPipe;
+	}
+	else if (oldLayout == vk::ImageLayout::eColorAttachmentOptimal &&
+			 newLayout == vk::ImageLayout::eTransferSrcOptimal)
+	{
+		barrier.srcAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eColorAttachmentWrite };
+		barrier.dstAccessMask =
+			vk::AccessFlags{ vk::AccessFlagBits::eTransferRead };
+
+		layoutBarrier.SrcStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		layoutBarrier.DstStage = vk::PipelineStageFlagBits::eTransfer;
 	}
 	else
 	{
 		throw std::invalid_argument("unsupported layout transition!");
 	}
 
+	return layoutBarrier;
+}
+
+void TransitionImageLayouts(
+	const vk::CommandBuffer commandBuffer,
+	const std::span<const ImageLayoutBarrier> layoutBarriers)
+{
+	vk::PipelineStageFlags sourceStage{};
+	vk::PipelineStageFlags destinationStage{};
+	std::vector<vk::ImageMemoryBarrier> barriers{};
+	barriers.reserve(layoutBarriers.size());
+	for (const ImageLayoutBarrier& layoutBarrier : layoutBarriers)
+	{
+		sourceStage |= layoutBarrier.SrcStage;
+		destinationStage |= layoutBarrier.DstStage;
+		barriers.push_back(layoutBarrier.Barrier);
+	}
+
 	commandBuffer.pipelineBarrier(
 		sourceStage, destinationStage, vk::DependencyFlags{},
 		vk::ArrayProxy<const vk::MemoryBarrier>{},
 		vk::ArrayProxy<const vk::BufferMemoryBarrier>{},
-		vk::ArrayProxy<const vk::ImageMemoryBarrier>{ barrier });
+		vk::ArrayProxy<const vk::ImageMemoryBarrier>{ barriers });
+}
+
+vk::Extent2D GetMipExtent(const vk::Extent2D extent,
+                          const std::uint32_t level) noexcept
+{
+	return vk::Extent2D{
+		.width  = std::max(extent.width >> level, 1U),
+		.height = std::max(extent.height >> level, 1U),
+	};
+}
 
-	EndSingleTimeCommands(commandBuffer, workQueue);
+void TransitionImageLayout(const vk::CommandBuffer commandBuffer,
+                           const vk::Image image,
+                           [[maybe_unused]] const vk::Format format,
+                           const vk::ImageLayout oldLayout,
+                           const vk::ImageLayout newLayout,
+                           const std::uint32_t baseMipLevel,
+                           const std::uint32_t levelCount)
+{
+	const std::array layoutBarriers{
+		MakeImageLayoutBarrier(image, oldLayout, newLayout, baseMipLevel,
+		                       levelCount),
+	};
+	TransitionImageLayouts(commandBuffer, layoutBarriers);
 }
@@ -1,7 +1,13 @@
 #include <VulkanTutorial/VulkanInstance.h>
+#include <VulkanTutorial/VulkanHelpers.h>
 
+#include <algorithm>
+#include <charconv>
+#include <functional>
 #include <optional>
 #include <set>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <fmt/core.h>
@@ -58,7 +64,8 @@ QueueFamilyIndices FindQueueFamilies(const vk::PhysicalDevice physicalDevice,
 			queueFamilyIndices.GraphicsFamily = idx;
 		}
 
-		if (physicalDevice.getSurfaceSupportKHR(idx, vulkanSurface) == vk::True)
+		if (!vulkanSurface ||
+		    physicalDevice.getSurfaceSupportKHR(idx, vulkanSurface) == vk::True)
 		{
 			queueFamilyIndices.PresentationFamily = idx;
 		}
@@ -73,6 +80,99 @@ QueueFamilyIndices FindQueueFamilies(const vk::PhysicalDevice physicalDevice,
 	return queueFamilyIndices;
 }
 
+// Same features as MainWindow enables for the renderer
+constexpr vk::PhysicalDeviceFeatures RequiredFeatures{
+	.multiDrawIndirect         = vk::True,
+	.drawIndirectFirstInstance = vk::True,
+	.samplerAnisotropy         = vk::True,
+};
+
+bool HasRequiredFeatures(const vk::PhysicalDevice physicalDevice)
+{
+	const vk::PhysicalDeviceFeatures features = physicalDevice.getFeatures();
+	return features.multiDrawIndirect == vk::True &&
+	       features.drawIndirectFirstInstance == vk::True &&
+	       features.samplerAnisotropy == vk::True;
+}
+
+bool SupportsExtensions(const vk::PhysicalDevice physicalDevice,
+                        const std::span<const char* const> deviceExtensions)
+{
+	std::set<std::string, std::less<>> available{};
+	for (const vk::ExtensionProperties& properties :
+	     physicalDevice.enumerateDeviceExtensionProperties())
+	{
+		available.emplace(properties.extensionName.data());
+	}
+	return std::ranges::all_of(
+		deviceExtensions, [&available](const std::string_view extension) {
+			return available.contains(extension);
+		});
+}
+
+// 0 for devices the renderer can't use. The device type decides first, then
+// the size of the largest device local heap
+std::uint64_t ScoreDevice(const vk::PhysicalDevice physicalDevice,
+                          const std::span<const char* const> deviceExtensions,
+                          const vk::SurfaceKHR vulkanSurface)
+{
+	if (!HasRequiredFeatures(physicalDevice) ||
+	    !SupportsExtensions(physicalDevice, deviceExtensions) ||
+	    !FindQueueFamilies(physicalDevice, vulkanSurface).IsComplete())
+	{
+		return 0U;
+	}
+
+	std::uint64_t typeRank{ 1U };
+	switch (physicalDevice.getProperties().deviceType)
+	{
+	case vk::PhysicalDeviceType::eDiscreteGpu:
+		typeRank = 4U;
+		break;
+	case vk::PhysicalDeviceType::eIntegratedGpu:
+		typeRank = 3U;
+		break;
+	case vk::PhysicalDeviceType::eVirtualGpu:
+		typeRank = 2U;
+		break;
+	default:
+		break;
+	}
+
+	const vk::PhysicalDeviceMemoryProperties memoryProperties =
+		physicalDevice.getMemoryProperties();
+	vk::DeviceSize localMemory{ 0U };
+	for (std::uint32_t i{ 0U }; i < memoryProperties.memoryHeapCount; ++i)
+	{
+		const vk::MemoryHeap& heap = memoryProperties.memoryHeaps.at(i);
+		if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+		{
+			localMemory = std::max(localMemory, heap.size);
+		}
+	}
+
+	// Heaps in MiB stay far below the type's bits
+	constexpr std::uint32_t TypeShift = 40U;
+	constexpr vk::DeviceSize Mebibyte = 1024U * 1024U;
+	return (typeRank << TypeShift) + localMemory / Mebibyte;
+}
+
+// An index or a part of the device name
+bool MatchesOverride(const std::uint32_t index,
+                     const std::string_view deviceName,
+                     const std::string_view deviceOverride)
+{
+	std::uint32_t overrideIndex{};
+	const char* const end = deviceOverride.data() + deviceOverride.size();
+	const auto [parsedEnd, error] =
+		std::from_chars(deviceOverride.data(), end, overrideIndex);
+	if (error == std::errc{} && parsedEnd == end)
+	{
+		return overrideIndex == index;
+	}
+	return deviceName.contains(deviceOverride);
+}
+
 } // namespace
 
 VulkanInstance::VulkanInstance(const std::span<const char* const> vulkanLayers,
@@ -119,7 +219,10 @@ VulkanInstance::VulkanInstance(const std::span<const char* const> vulkanLayers,
 
 VulkanInstance::~VulkanInstance() noexcept
 {
-	//m_Device.destroy(m_CommandPool);
+	if (m_Device)
+	{
+		m_Device.destroy(m_CommandPool);
+	}
 	m_Device.destroy();
 	m_VulkanInstance.destroy(m_DebugMessenger);
 	m_VulkanInstance.destroy();
@@ -139,9 +242,67 @@ void VulkanInstance::InitializeDebugMessenger()
 		});
 }
 
+std::uint32_t VulkanInstance::SelectPhysicalDevice(
+	const std::span<const char* const> deviceExtensions,
+	const vk::SurfaceKHR vulkanSurface,
+	const std::string_view deviceOverride) const
+{
+	const std::vector<vk::PhysicalDevice> physicalDevices =
+		m_VulkanInstance.enumeratePhysicalDevices();
+	if (physicalDevices.empty())
+	{
+		throw std::runtime_error{ "Failed to find any vulkan capable device!" };
+	}
+
+	std::optional<std::uint32_t> selected{};
+	std::uint64_t bestScore{ 0U };
+	for (std::uint32_t idx{ 0U }; idx < physicalDevices.size(); ++idx)
+	{
+		const vk::PhysicalDeviceProperties properties =
+			physicalDevices.at(idx).getProperties();
+		const std::string_view deviceName{ properties.deviceName };
+		const std::uint64_t score =
+			ScoreDevice(physicalDevices.at(idx), deviceExtensions, vulkanSurface);
+		fmt::println("Device {}: {} ({}), score {}", idx, deviceName,
+		             vk::to_string(properties.deviceType), score);
+
+		if (!deviceOverride.empty())
+		{
+			if (!selected.has_value() &&
+			    MatchesOverride(idx, deviceName, deviceOverride))
+			{
+				if (score == 0U)
+				{
+					throw std::runtime_error{ fmt::format(
+						"Device {} lacks the required features", deviceName) };
+				}
+				selected = idx;
+			}
+		}
+		else if (score > bestScore)
+		{
+			bestScore = score;
+			selected  = idx;
+		}
+	}
+
+	if (!selected.has_value() && deviceOverride.empty())
+	{
+		throw std::runtime_error{ "No device has the required features" };
+	}
+	if (!selected.has_value())
+	{
+		throw std::runtime_error{
+			fmt::format("Failed to find device '{}'", deviceOverride),
+		};
+	}
+	return *selected;
+}
+
 void VulkanInstance::InitializeDevice(
     const std::span<const char* const> deviceExtensions,
-    const vk::SurfaceKHR vulkanSurface)
+    const vk::SurfaceKHR vulkanSurface,
+    const std::string_view deviceOverride)
 {
 	const std::set<std::string>& supportedExtensions = vk::getDeviceExtensions();
 	for (const char* const deviceExtension : deviceExtensions)
@@ -154,16 +315,10 @@ void VulkanInstance::InitializeDevice(
 		}
 	}
 
-	const std::vector<vk::PhysicalDevice> physicalDevices =
-		m_VulkanInstance.enumeratePhysicalDevices();
-	if (physicalDevices.empty())
-	{
-		throw std::runtime_error{ "Failed to find any vulkan capable device!" };
-	}
-
-	// TODO: make some smarter device selection?
-	constexpr std::size_t DeviceIndex = 0;
-	m_PhyiscalDevice                  = physicalDevices.at(DeviceIndex);
+	const std::uint32_t deviceIndex =
+		SelectPhysicalDevice(deviceExtensions, vulkanSurface, deviceOverride);
+	m_PhyiscalDevice =
+		m_VulkanInstance.enumeratePhysicalDevices().at(deviceIndex);
 
 	const vk::PhysicalDeviceProperties deviceProperties{
 		m_PhyiscalDevice.getProperties()
@@ -171,6 +326,23 @@ void VulkanInstance::InitializeDevice(
 	const std::string_view deviceName{ deviceProperties.deviceName };
 	fmt::print("Using device {}\n", deviceName);
 
+	// Core since 1.3, older devices need the extension enabled as well
+	std::vector<const char*> enabledExtensions(deviceExtensions.begin(),
+	                                           deviceExtensions.end());
+	using DynamicRenderingFeatures = vk::PhysicalDeviceDynamicRenderingFeatures;
+	const auto supportedFeatures =
+		m_PhyiscalDevice
+			.getFeatures2<vk::PhysicalDeviceFeatures2, DynamicRenderingFeatures>();
+	m_DynamicRendering =
+		supportedFeatures.get<DynamicRenderingFeatures>().dynamicRendering ==
+		vk::True;
+	if (m_DynamicRendering && deviceProperties.apiVersion < VK_API_VERSION_1_3)
+	{
+		enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	}
+	fmt::println("Dynamic rendering {}",
+	             m_DynamicRendering ? "enabled" : "not supported");
+
 	const QueueFamilyIndices queueIndices =
 		FindQueueFamilies(m_PhyiscalDevice, vulkanSurface);
 	if (!queueIndices.IsComplete())
@@ -178,29 +350,61 @@ void VulkanInstance::InitializeDevice(
 		throw std::runtime_error{ "Failed to find expected queues on the device!" };
 	}
 
+	// Without dedicated families the graphics queue does all the work
+	const std::vector<vk::QueueFamilyProperties> queueFamilies =
+		m_PhyiscalDevice.getQueueFamilyProperties();
+	m_WorkQueueFamily = queueIndices.GraphicsFamily.value();
+	m_TransferQueueFamily =
+		FindDedicatedQueueFamily(
+			queueFamilies, vk::QueueFlagBits::eTransfer,
+			vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)
+			.value_or(m_WorkQueueFamily);
+	m_ComputeQueueFamily =
+		FindDedicatedQueueFamily(queueFamilies, vk::QueueFlagBits::eCompute,
+		                         vk::QueueFlagBits::eGraphics)
+			.value_or(m_WorkQueueFamily);
+
 	constexpr float QueuePriority{ 1.F };
-	const vk::DeviceQueueCreateInfo deviceQueueCreateInfo{
-		.queueFamilyIndex = queueIndices.GraphicsFamily.value(),
-		.queueCount       = 1,
-		.pQueuePriorities = &QueuePriority
+	const std::set<std::uint32_t> uniqueFamilies{
+		m_WorkQueueFamily, m_TransferQueueFamily, m_ComputeQueueFamily
 	};
+	std::vector<vk::DeviceQueueCreateInfo> deviceQueueCreateInfos{};
+	for (const std::uint32_t family : uniqueFamilies)
+	{
+		deviceQueueCreateInfos.push_back(vk::DeviceQueueCreateInfo{
+			.queueFamilyIndex = family,
+			.queueCount       = 1,
+			.pQueuePriorities = &QueuePriority,
+		});
+	}
 
-	// Device layers are deprecated, only accept extensions
-	constexpr vk::PhysicalDeviceFeatures DeviceFeatures{
-		.samplerAnisotropy = vk::True,
+	DynamicRenderingFeatures dynamicRenderingFeatures{
+		.dynamicRendering = vk::True,
+	};
+	const vk::PhysicalDeviceFeatures2 enabledFeatures{
+		.pNext    = m_DynamicRendering ? &dynamicRenderingFeatures : nullptr,
+		.features = RequiredFeatures,
 	};
-	m_Device    = m_PhyiscalDevice.createDevice(vk::DeviceCreateInfo{
-		   .queueCreateInfoCount = 1,
-		   .pQueueCreateInfos    = &deviceQueueCreateInfo,
-		   .enabledExtensionCount =
-			static_cast<std::uint32_t>(deviceExtensions.size()),
-		   .ppEnabledExtensionNames = deviceExtensions.data(),
-		   .pEnabledFeatures        = &DeviceFeatures });
-	m_WorkQueue = m_Device.getQueue(queueIndices.GraphicsFamily.value(), 0);
+
+	// Device layers are deprecated, only accept extensions
+	m_Device = m_PhyiscalDevice.createDevice(vk::DeviceCreateInfo{
+		.pNext                = &enabledFeatures,
+		.queueCreateInfoCount =
+			static_cast<std::uint32_t>(deviceQueueCreateInfos.size()),
+		.pQueueCreateInfos = deviceQueueCreateInfos.data(),
+		.enabledExtensionCount =
+			static_cast<std::uint32_t>(enabledExtensions.size()),
+		.ppEnabledExtensionNames = enabledExtensions.data(),
+	});
+	m_WorkQueue     = m_Device.getQueue(m_WorkQueueFamily, 0);
+	m_TransferQueue = m_Device.getQueue(m_TransferQueueFamily, 0);
+	m_ComputeQueue  = m_Device.getQueue(m_ComputeQueueFamily, 0);
+	fmt::println("Queue families: graphics {}, transfer {}, compute {}",
+	             m_WorkQueueFamily, m_TransferQueueFamily, m_ComputeQueueFamily);
 
 	m_CommandPool = m_Device.createCommandPool(vk::CommandPoolCreateInfo{
 		.flags            = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-		.queueFamilyIndex = queueIndices.GraphicsFamily.value() });
+		.queueFamilyIndex = m_WorkQueueFamily });
 
-	// VULKAN_HPP_DEFAULT_DISPATCHER.init(m_Device);
+	VULKAN_HPP_DEFAULT_DISPATCHER.init(m_Device);
 }
@@ -1,3 +1,5 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/MipmapGenerator.h>
 #include <VulkanTutorial/Vertex.h>
 #include <VulkanTutorial/VulkanHelpers.h>
 #include <VulkanTutorial/VulkanRenderer.h>
@@ -7,8 +9,16 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <chrono>
 #include <filesystem>
+#include <span>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 // QMatrix4x4 includes a 'flag' which would make copying harder
 
@@ -16,11 +26,27 @@ using MatrixF4 = QGenericMatrix<4, 4, float>;
 
 namespace
 {
-constexpr int MinimumWindowSize = 5;
+constexpr std::uint32_t MinimumWindowSize = 5U;
 
-struct UniformBufferObject
+constexpr vk::ClearValue ClearColor{
+	.color =
+		vk::ClearColorValue{
+			std::array<float, 4>{ 0.0F, 0.0F, 0.0F, 1.0F },
+		},
+};
+constexpr vk::ClearValue ClearDepthStencil{
+	.depthStencil =
+		vk::ClearDepthStencilValue{
+			.depth   = 1.F,
+			.stencil = 0U,
+		},
+};
+// Frames between printing the GPU timings
+constexpr std::uint64_t ProfilerReportInterval = 600U;
+
+// Per frame, model transforms are pushed as ModelPushConstants instead
+struct CameraUniforms
 {
-	MatrixF4 Model;
 	MatrixF4 View;
 	MatrixF4 Perspective;
 
@@ -30,31 +56,36 @@ struct UniformBufferObject
 } // namespace
 
 VulkanRenderer::VulkanRenderer(QVulkanWindow& window,
-                               const bool msaa)
-    : m_Window{ &window }
-    , m_ConcurrentFrameCount{ static_cast<std::uint32_t>(
-	      m_Window->concurrentFrameCount()) }
+                               const WindowDeviceSetup& deviceSetup,
+                               const bool msaa,
+                               const bool gpuCulling,
+                               const std::uint32_t recordingThreads)
+    : m_WindowTarget{ std::in_place, window, deviceSetup }
+    , m_Target{ &*m_WindowTarget }
+    , m_ConcurrentFrameCount{ m_Target->GetConcurrentFrameCount() }
+    , m_Msaa{ msaa }
+    , m_GpuCulling{ gpuCulling }
+    , m_RecordingThreads{ recordingThreads }
 {
-	if (msaa)
-	{
-		const QList<int> counts = m_Window->supportedSampleCounts();
-		qDebug() << "Supported sample counts:" << counts;
+}
 
-		constexpr int StartingSampleCount = 16;
-		for (int samples{ StartingSampleCount }; samples >= 4; samples /= 2)
-		{
-			if (counts.contains(samples))
-			{
-				qDebug() << "Requesting sample count:" << samples;
-				m_Window->setSampleCount(samples);
-				break;
-			}
-		}
-	}
+VulkanRenderer::VulkanRenderer(OffscreenTarget& target,
+                               const bool gpuCulling,
+                               const std::uint32_t recordingThreads)
+    : m_Target{ &target }
+    , m_ConcurrentFrameCount{ m_Target->GetConcurrentFrameCount() }
+    , m_Msaa{ true }
+    , m_GpuCulling{ gpuCulling }
+    , m_RecordingThreads{ recordingThreads }
+    , m_FixedTimeStep{ 1.F / 60.F }
+{
+	static_assert(OffscreenTarget::MaxFrameCount <=
+	              QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT);
 }
 
 vk::ShaderModule VulkanRenderer::CreateShader(const QString& name) const
 {
+	CPU_TRACE_SCOPE("CreateShader");
 	QFile file{ name };
 	if (!file.open(QIODevice::OpenModeFlag::ReadOnly))
 	{
@@ -75,7 +106,7 @@ vk::ShaderModule VulkanRenderer::CreateShader(const QString& name) const
 void VulkanRenderer::CreateDescriptorSetLayout()
 {
 	constexpr std::array<vk::DescriptorSetLayoutBinding, 2> DescriptorSetLayouts{
-		// UniformBufferObject layout
+		// CameraUniforms layout
 		vk::DescriptorSetLayoutBinding{
 			.binding         = 0U,
 			.descriptorType  = vk::DescriptorType::eUniformBuffer,
@@ -99,60 +130,79 @@ void VulkanRenderer::CreateDescriptorSetLayout()
 
 void VulkanRenderer::CreateUniformBuffers()
 {
-	constexpr vk::DeviceSize BufferSize = sizeof(UniformBufferObject);
+	constexpr vk::DeviceSize BufferSize = sizeof(CameraUniforms);
+	// Written by the first UpdateUniformBuffer of each frame
+	m_StaleCameraFrames.fill(true);
 
 	for (std::uint32_t i{ 0 }; i < m_ConcurrentFrameCount; ++i)
 	{
-		vk::DeviceMemory& deviceMemory = m_UniformDeviceMemory.at(i);
-		std::tie(m_UniformBuffers.at(i), deviceMemory) = CreateDeviceBuffer(
+		DeviceAllocation& allocation = m_UniformAllocations.at(i);
+		std::tie(m_UniformBuffers.at(i), allocation) = CreateDeviceBuffer(
 			BufferSize,
 			vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eUniformBuffer },
 			vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible |
 									 vk::MemoryPropertyFlagBits::eHostCoherent },
-			m_Device, m_PhysicalDevice);
+			m_Device, *m_Allocator);
 
-		// Persistent mapping, we won't be unmapping this
-		m_UniformBuffersMappedMemory.at(i) = m_Device.mapMemory(
-			deviceMemory, vk::DeviceSize{ 0 }, BufferSize, vk::MemoryMapFlags{});
+		// Host visible blocks are persistently mapped by the allocator
+		m_UniformBuffersMappedMemory.at(i) = allocation.MappedData;
 	}
 }
 
-void VulkanRenderer::UpdateUniformBuffer(const int idx, const QSize currentSize)
+void VulkanRenderer::UpdateUniformBuffer(const std::uint32_t idx,
+                                         const vk::Extent2D currentSize)
 {
+	CPU_TRACE_SCOPE("UpdateUniformBuffer");
 	using Clock = std::chrono::steady_clock;
 	using FloatDuration =
 	    std::chrono::duration<float, std::chrono::seconds::period>;
 
 	const static Clock::time_point StartTime = Clock::now();
 
-	const Clock::time_point currentTime = Clock::now();
-	const float time = FloatDuration{ currentTime - StartTime }.count() * 36.F;
+	const float seconds =
+		m_FixedTimeStep.has_value()
+			? static_cast<float>(m_FrameNumber) * *m_FixedTimeStep
+			: FloatDuration{ Clock::now() - StartTime }.count();
+	const float time = seconds * 36.F;
 
 	QMatrix4x4 modelMatrix{};
 	constexpr float RotationSpeedDegrees = 90.F;
 	constexpr float RotationSpeed        = qDegreesToRadians(RotationSpeedDegrees);
 	modelMatrix.rotate(time * RotationSpeed, QVector3D{ 0.F, 0.F, 1.F });
+	m_ModelManager.SetModelTransform("VikingRoom", modelMatrix);
+
+	// The view is fixed, so the camera only changes with the target size
+	if (currentSize != m_CameraExtent)
+	{
+		m_CameraExtent = currentSize;
+		m_StaleCameraFrames.fill(true);
+	}
+	if (!m_StaleCameraFrames.at(idx))
+	{
+		return;
+	}
+	m_StaleCameraFrames.at(idx) = false;
 
 	// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
 	QMatrix4x4 viewMatrix{};
 	viewMatrix.lookAt(QVector3D{ 2.F, 2.F, 2.F }, QVector3D{ 0.F, 0.F, 0.F },
 					  QVector3D{ 0.F, 0.F, 1.F });
 
-	const float windowRatio = static_cast<float>(currentSize.width()) /
-							  static_cast<float>(currentSize.height());
+	const float windowRatio = static_cast<float>(currentSize.width) /
+							  static_cast<float>(currentSize.height);
 	QMatrix4x4 perspectiveMatrix{};
 	perspectiveMatrix.perspective(45.F, // This MUST be in degrees, not radians
 								  windowRatio, 0.1F, 10.F);
 	perspectiveMatrix(1, 1) *= -1.F;
 	// NOLINTEND(cppcoreguidelines-avoid-magic-numbers, readability-magic-numbers)
 
-	const UniformBufferObject ubo{ // GenericMatrix has same layout as a plain array
-		                           modelMatrix.toGenericMatrix<4, 4>(),
-		                           viewMatrix.toGenericMatrix<4, 4>(),
-		                           perspectiveMatrix.toGenericMatrix<4, 4>()
+	// GenericMatrix has same layout as a plain array
+	const CameraUniforms camera{
+		.View        = viewMatrix.toGenericMatrix<4, 4>(),
+		.Perspective = perspectiveMatrix.toGenericMatrix<4, 4>(),
 	};
-	std::memcpy(m_UniformBuffersMappedMemory.at(static_cast<std::size_t>(idx)),
-				&ubo, sizeof(UniformBufferObject));
+	std::memcpy(m_UniformBuffersMappedMemory.at(idx), &camera,
+	            sizeof(CameraUniforms));
 }
 
 void VulkanRenderer::CreateDescriptorPool()
@@ -197,11 +247,12 @@ void VulkanRenderer::CreateDescriptorSets()
 	for (std::uint32_t i{ 0U }; i < m_ConcurrentFrameCount; ++i)
 	{
 		const vk::DescriptorBufferInfo bufferInfo{ m_UniformBuffers.at(i), 0,
-			                                       sizeof(UniformBufferObject) };
+			                                       sizeof(CameraUniforms) };
 
+		// Until the texture upload has finished
 		const vk::DescriptorImageInfo imageInfo{
 			.sampler     = m_TextureSampler,
-			.imageView   = m_TextureImageView,
+			.imageView   = m_FallbackImageView,
 			.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
 		};
 
@@ -209,7 +260,7 @@ void VulkanRenderer::CreateDescriptorSets()
 
 		m_Device.updateDescriptorSets(
 			vk::ArrayProxy<const vk::WriteDescriptorSet>{
-				// UniformBufferObject write
+				// CameraUniforms write
 				vk::WriteDescriptorSet{
 					.dstSet          = descriptorSet,
 					.dstBinding      = 0U,
@@ -230,88 +281,127 @@ void VulkanRenderer::CreateDescriptorSets()
 			},
 		    vk::ArrayProxy<const vk::CopyDescriptorSet>{});
 	}
+	m_FallbackFrames.fill(true);
 }
 
-void VulkanRenderer::LoadTextures()
+void VulkanRenderer::BindUploadedTexture(const std::uint32_t idx)
 {
-	// TODO: extract into helper function
-	QImage textureImage{ "./Textures/VikingRoom.png" };
-	assert(textureImage.isNull() == false);
-	textureImage.convertTo(QImage::Format::Format_RGBA8888);
-
-	const auto textureSize =
-	    static_cast<vk::DeviceSize>(textureImage.sizeInBytes());
+	if (!m_FallbackFrames.at(idx) ||
+	    !m_UploadContext->IsUploadComplete(m_TextureUpload))
+	{
+		return;
+	}
+	// The previous submission of this frame has finished, so nothing reads the
+	// descriptor set anymore
+	m_FallbackFrames.at(idx) = false;
+
+	const vk::DescriptorImageInfo imageInfo{
+		.sampler     = m_TextureSampler,
+		.imageView   = m_TextureImageView,
+		.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal
+	};
+	m_Device.updateDescriptorSets(
+		vk::ArrayProxy<const vk::WriteDescriptorSet>{ vk::WriteDescriptorSet{
+			.dstSet          = m_DescriptorSets.at(idx),
+			.dstBinding      = 1U,
+			.dstArrayElement = 0U,
+			.descriptorCount = 1U,
+			.descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+			.pImageInfo      = &imageInfo,
+		} },
+		vk::ArrayProxy<const vk::CopyDescriptorSet>{});
+}
 
-	const auto [stagingBuffer, stagingBufferMemory] = CreateDeviceBuffer(
-	    textureSize, vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eTransferSrc },
-	    vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eHostVisible |
-	                             vk::MemoryPropertyFlagBits::eHostCoherent },
-	    m_Device, m_PhysicalDevice);
+void VulkanRenderer::LoadTextures()
+{
+	CPU_TRACE_SCOPE("LoadTextures");
+	// Each texture starts uploading as soon as it's decoded, while the workers
+	// are still busy with the rest
+	while (m_TextureLoader->GetPendingCount() > 0U)
+	{
+		for (LoadedTexture& loaded : m_TextureLoader->WaitForCompleted())
+		{
+			if (loaded.Error)
+			{
+				std::rethrow_exception(loaded.Error);
+			}
+			UploadTexture(loaded.Texture);
+		}
+	}
+}
 
-	void* const memoryPtr =
-	    m_Device.mapMemory(stagingBufferMemory, vk::DeviceSize{ 0 }, textureSize,
-	                       vk::MemoryMapFlags{});
-	std::memcpy(memoryPtr, static_cast<const void*>(textureImage.constBits()),
-	            textureSize);
-	m_Device.unmapMemory(stagingBufferMemory);
+void VulkanRenderer::UploadTexture(
+	const std::shared_ptr<const TextureData>& texture)
+{
+	// Block-compressed textures come with their mip chain, it can't be
+	// generated for them
+	const bool generateMipmaps =
+		!texture->IsBlockCompressed() && texture->LevelCount == 1U;
+	m_TextureFormat    = texture->Format;
+	m_TextureMipLevels = generateMipmaps
+	                         ? MipmapGenerator::GetMipLevelCount(texture->Extent)
+	                         : texture->LevelCount;
 
 	const vk::ImageCreateInfo imageCreateInfo{
+		.flags     = generateMipmaps
+		                 ? m_MipmapGenerator->GetRequiredFlags(m_TextureFormat)
+		                 : vk::ImageCreateFlags{},
 		.imageType = vk::ImageType::e2D,
-		.format    = vk::Format::eR8G8B8A8Srgb,
+		.format    = m_TextureFormat,
 		.extent =
-			vk::Extent3D{ static_cast<std::uint32_t>(textureImage.width()),
-						  static_cast<std::uint32_t>(textureImage.height()), 1U },
-		.mipLevels   = 1U,
+			vk::Extent3D{ texture->Extent.width, texture->Extent.height, 1U },
+		.mipLevels   = m_TextureMipLevels,
 		.arrayLayers = 1U,
 		.samples     = vk::SampleCountFlagBits::e1,
 		.tiling      = vk::ImageTiling::eOptimal,
-		.usage =
-			vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+		.usage = vk::ImageUsageFlagBits::eTransferDst |
+		         vk::ImageUsageFlagBits::eSampled |
+		         (generateMipmaps
+		              ? m_MipmapGenerator->GetRequiredUsage(m_TextureFormat)
+		              : vk::ImageUsageFlags{}),
 		.sharingMode           = vk::SharingMode::eExclusive,
 		.queueFamilyIndexCount = 0U,
 		.initialLayout         = vk::ImageLayout::eUndefined,
 	};
 
-	m_TextureImage = m_Device.createImage(imageCreateInfo);
-
-	const vk::MemoryRequirements imageRequirements =
-	    m_Device.getImageMemoryRequirements(m_TextureImage);
-	const vk::MemoryAllocateInfo textureAllocationInfo{
-		.allocationSize  = imageRequirements.size,
-		.memoryTypeIndex = FindMemoryType(
-		    m_PhysicalDevice,
-		    vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
-			imageRequirements.memoryTypeBits),
-	};
-	m_TextureImageMemory = m_Device.allocateMemory(textureAllocationInfo);
-	m_Device.bindImageMemory(m_TextureImage, m_TextureImageMemory,
-	                         vk::DeviceSize{ 0 });
-
-	const vk::CommandPool commandPool{ m_Window->graphicsCommandPool() };
-	const vk::Queue queue{ m_Window->graphicsQueue() };
-
-	TransitionImageLayout(
-	    m_TextureImage, vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eUndefined,
-	    vk::ImageLayout::eTransferDstOptimal, m_Device, commandPool, queue);
-	CopyBufferToImage(stagingBuffer, m_TextureImage,
-	                  static_cast<std::uint32_t>(textureImage.width()),
-	                  static_cast<std::uint32_t>(textureImage.height()), m_Device,
-	                  commandPool, queue);
-	TransitionImageLayout(m_TextureImage, vk::Format::eR8G8B8A8Srgb,
-	                      vk::ImageLayout::eTransferDstOptimal,
-	                      vk::ImageLayout::eShaderReadOnlyOptimal, m_Device,
-	                      commandPool, queue);
-
-	m_Device.destroy(stagingBuffer);
-	m_Device.free(stagingBufferMemory);
+	std::tie(m_TextureImage, m_TextureImageAllocation) = CreateDeviceImage(
+		imageCreateInfo,
+		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
+		m_Device, *m_Allocator);
+
+	// The writer shares ownership of the texels, which have to stay alive while
+	// the upload is streamed through the staging ring
+	m_TextureUpload = m_UploadContext->UploadImage(
+		ImageUploadInfo{
+			.DstImage     = m_TextureImage,
+			.Format       = m_TextureFormat,
+			.Extent       = texture->Extent,
+			.TexelSize    = texture->BlockSize,
+			.BlockExtent  = texture->BlockExtent,
+			.SourceLevels = texture->LevelCount,
+			.MipLevels    = m_TextureMipLevels,
+			.Mipmaps      = generateMipmaps ? &*m_MipmapGenerator : nullptr,
+		},
+		[texture](const std::span<std::byte> destination,
+	              const vk::DeviceSize sourceOffset) {
+			const std::span<const std::byte> source = texture->Data;
+			std::ranges::copy(source.subspan(sourceOffset, destination.size()),
+			                  destination.data());
+		});
 }
 
 void VulkanRenderer::CreateTextureImageView()
 {
+	// The image may also have storage usage for the compute mipmaps, which its
+	// sRGB format doesn't support
+	constexpr vk::ImageViewUsageCreateInfo UsageInfo{
+		.usage = vk::ImageUsageFlagBits::eSampled,
+	};
 	m_TextureImageView = m_Device.createImageView(vk::ImageViewCreateInfo{
+		.pNext    = &UsageInfo,
 		.image    = m_TextureImage,
 		.viewType = vk::ImageViewType::e2D,
-		.format   = vk::Format::eR8G8B8A8Srgb,
+		.format   = m_TextureFormat,
 		.components =
 			vk::ComponentMapping{
 				.r = vk::ComponentSwizzle::eIdentity,
@@ -324,7 +414,7 @@ void VulkanRenderer::CreateTextureImageView()
 				.aspectMask =
 					vk::ImageAspectFlags{ vk::ImageAspectFlagBits::eColor },
 				.baseMipLevel   = 0U,
-				.levelCount     = 1U,
+				.levelCount     = m_TextureMipLevels,
 				.baseArrayLayer = 0U,
 				.layerCount     = 1U,
 			},
@@ -333,10 +423,8 @@ void VulkanRenderer::CreateTextureImageView()
 
 void VulkanRenderer::CreateTextureSampler()
 {
-	// TODO: is there a better way to do this???
-	// VulkanCpp constructor just used a reinterpret cast...
-	const auto deviceProperties = std::bit_cast<vk::PhysicalDeviceProperties>(
-		*m_Window->physicalDeviceProperties());
+	const vk::PhysicalDeviceProperties deviceProperties =
+		m_PhysicalDevice.getProperties();
 
 	m_TextureSampler = m_Device.createSampler(vk::SamplerCreateInfo{
 		.magFilter               = vk::Filter::eLinear,
@@ -351,219 +439,646 @@ void VulkanRenderer::CreateTextureSampler()
 		.compareEnable           = VK_FALSE,
 		.compareOp               = vk::CompareOp::eAlways,
 		.minLod                  = 0.F,
-		.maxLod                  = 0.F,
+		.maxLod                  = static_cast<float>(m_TextureMipLevels),
 		.borderColor             = vk::BorderColor::eIntOpaqueBlack,
 		.unnormalizedCoordinates = VK_FALSE,
 	});
 }
 
+void VulkanRenderer::CreateFallbackTexture()
+{
+	constexpr vk::Format FallbackFormat = vk::Format::eR8G8B8A8Unorm;
+	std::tie(m_FallbackImage, m_FallbackImageAllocation) = CreateDeviceImage(
+		vk::ImageCreateInfo{
+			.imageType   = vk::ImageType::e2D,
+			.format      = FallbackFormat,
+			.extent      = vk::Extent3D{ 1U, 1U, 1U },
+			.mipLevels   = 1U,
+			.arrayLayers = 1U,
+			.samples     = vk::SampleCountFlagBits::e1,
+			.tiling      = vk::ImageTiling::eOptimal,
+			.usage       = vk::ImageUsageFlagBits::eTransferDst |
+			               vk::ImageUsageFlagBits::eSampled,
+			.sharingMode   = vk::SharingMode::eExclusive,
+			.initialLayout = vk::ImageLayout::eUndefined,
+		},
+		vk::MemoryPropertyFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal },
+		m_Device, *m_Allocator);
+
+	m_UploadContext->UploadImage(
+		ImageUploadInfo{
+			.DstImage  = m_FallbackImage,
+			.Format    = FallbackFormat,
+			.Extent    = vk::Extent2D{ 1U, 1U },
+			.TexelSize = 4U,
+		},
+		[](const std::span<std::byte> destination, vk::DeviceSize) {
+			std::ranges::fill(destination, std::byte{ 0xFF });
+		});
+	// Nothing else has been uploaded yet, so this only waits for a single texel
+	m_UploadContext->Flush();
+
+	m_FallbackImageView = m_Device.createImageView(vk::ImageViewCreateInfo{
+		.image    = m_FallbackImage,
+		.viewType = vk::ImageViewType::e2D,
+		.format   = FallbackFormat,
+		.subresourceRange =
+			vk::ImageSubresourceRange{
+				.aspectMask =
+					vk::ImageAspectFlags{ vk::ImageAspectFlagBits::eColor },
+				.baseMipLevel   = 0U,
+				.levelCount     = 1U,
+				.baseArrayLayer = 0U,
+				.layerCount     = 1U,
+			},
+	});
+}
+
+void VulkanRenderer::BeginRendering(const vk::CommandBuffer commandBuffer,
+                                    const std::uint32_t imageIdx,
+                                    const vk::Extent2D size,
+                                    const vk::SubpassContents contents) const
+{
+	const vk::Rect2D renderArea{ vk::Offset2D{ 0, 0 }, size };
+	const bool msaa = m_SampleCount > vk::SampleCountFlagBits::e1;
+	if (!m_DynamicRendering)
+	{
+		constexpr std::array<vk::ClearValue, 3> ClearValues{
+			ClearColor,
+			ClearDepthStencil,
+			ClearColor,
+		};
+		commandBuffer.beginRenderPass(
+			vk::RenderPassBeginInfo{
+				.renderPass      = m_RenderPass,
+				.framebuffer     = m_Framebuffers.at(imageIdx),
+				.renderArea      = renderArea,
+				.clearValueCount = msaa ? 3U : 2U,
+				.pClearValues    = ClearValues.data(),
+			},
+			contents);
+		return;
+	}
+
+	// Everything is cleared, so the previous contents can be discarded
+	std::vector<ImageLayoutBarrier> barriers{
+		MakeImageLayoutBarrier(GetSceneImage(imageIdx),
+		                       vk::ImageLayout::eUndefined,
+		                       vk::ImageLayout::eColorAttachmentOptimal),
+		MakeImageLayoutBarrier(m_Attachments->GetDepthStencilImage(),
+		                       vk::ImageLayout::eUndefined,
+		                       vk::ImageLayout::eDepthStencilAttachmentOptimal),
+	};
+	if (msaa)
+	{
+		barriers.push_back(MakeImageLayoutBarrier(
+			m_Attachments->GetColorImage(imageIdx), vk::ImageLayout::eUndefined,
+			vk::ImageLayout::eColorAttachmentOptimal));
+	}
+	TransitionImageLayouts(commandBuffer, barriers);
+
+	constexpr vk::ImageLayout ColorLayout =
+		vk::ImageLayout::eColorAttachmentOptimal;
+	vk::RenderingAttachmentInfo colorAttachment{
+		.imageView   = GetSceneView(imageIdx),
+		.imageLayout = ColorLayout,
+		.loadOp      = vk::AttachmentLoadOp::eClear,
+		.storeOp     = vk::AttachmentStoreOp::eStore,
+		.clearValue  = ClearColor,
+	};
+	// Resolved into the target's image, the samples themselves aren't kept
+	if (msaa)
+	{
+		colorAttachment.resolveMode        = vk::ResolveModeFlagBits::eAverage;
+		colorAttachment.resolveImageView   = colorAttachment.imageView;
+		colorAttachment.resolveImageLayout = ColorLayout;
+		colorAttachment.imageView          = m_Attachments->GetColorView(imageIdx);
+		colorAttachment.storeOp            = vk::AttachmentStoreOp::eDontCare;
+	}
+	const vk::RenderingAttachmentInfo depthStencilAttachment{
+		.imageView   = m_Attachments->GetDepthStencilView(),
+		.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+		.loadOp      = vk::AttachmentLoadOp::eClear,
+		.storeOp     = vk::AttachmentStoreOp::eDontCare,
+		.clearValue  = ClearDepthStencil,
+	};
+
+	const vk::RenderingFlags flags =
+		contents == vk::SubpassContents::eSecondaryCommandBuffers
+			? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers
+			: vk::RenderingFlags{};
+	commandBuffer.beginRendering(vk::RenderingInfo{
+		.flags                = flags,
+		.renderArea           = renderArea,
+		.layerCount           = 1U,
+		.colorAttachmentCount = 1U,
+		.pColorAttachments    = &colorAttachment,
+		.pDepthAttachment     = &depthStencilAttachment,
+		.pStencilAttachment   = &depthStencilAttachment,
+	});
+}
+
+void VulkanRenderer::EndRendering(const vk::CommandBuffer commandBuffer,
+                                  const std::uint32_t imageIdx) const
+{
+	if (!m_DynamicRendering)
+	{
+		commandBuffer.endRenderPass();
+		return;
+	}
+
+	commandBuffer.endRendering();
+	// The render pass did this as its final layout
+	const std::array<ImageLayoutBarrier, 1> barriers{
+		MakeImageLayoutBarrier(GetSceneImage(imageIdx),
+		                       vk::ImageLayout::eColorAttachmentOptimal,
+		                       GetSceneLayout()),
+	};
+	TransitionImageLayouts(commandBuffer, barriers);
+}
+
 void VulkanRenderer::initResources()
 {
-	m_Device         = vk::Device{ m_Window->device() };
-	m_PhysicalDevice = vk::PhysicalDevice{ m_Window->physicalDevice() };
+	CPU_TRACE_SCOPE("initResources");
+	m_Device           = m_Target->GetDevice();
+	m_PhysicalDevice   = m_Target->GetPhysicalDevice();
+	m_DynamicRendering = m_Target->IsDynamicRenderingEnabled();
 
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(m_Device);
 
-	m_ModelManager.SetResouces(m_Device, m_PhysicalDevice,
-	                           m_Window->graphicsCommandPool(),
-	                           m_Window->graphicsQueue());
+	m_Allocator.emplace(m_Device, m_PhysicalDevice);
+	m_PipelineCache.emplace(m_Device, m_PhysicalDevice, "./PipelineCache.bin");
+	m_PipelineLibrary.emplace(m_Device, m_PipelineCache->Get());
+	m_GpuProfiler.emplace(m_Device, m_PhysicalDevice,
+	                      m_Target->GetGraphicsQueueFamily());
+	m_UploadContext.emplace(m_Device, m_Target->GetGraphicsQueue(),
+	                        m_Target->GetGraphicsQueueFamily(),
+	                        m_Target->GetTransferQueue(),
+	                        m_Target->GetTransferQueueFamily(), *m_Allocator,
+	                        &*m_GpuProfiler);
+	CreateFallbackTexture();
+
+	// Decoded in the background while the model loads
+	m_TextureCache.emplace(m_PhysicalDevice);
+	m_TextureLoader.emplace(*m_TextureCache);
+	m_TextureLoader->Load("./Textures/VikingRoom.png", true);
+
+	m_ModelManager.SetResouces(m_Device, *m_Allocator, *m_UploadContext,
+	                           m_ConcurrentFrameCount);
+	// The indirect draw of the GPU culling path is a single command anyway
+	if (m_RecordingThreads > 0U && !m_GpuCulling)
+	{
+		m_ParallelRecorder.emplace(m_Device, m_Target->GetGraphicsQueueFamily(),
+		                           m_ConcurrentFrameCount, m_RecordingThreads);
+	}
 	m_ModelManager.LoadModel("VikingRoom", "./Models/VikingRoom.obj");
+	m_ModelManager.AddInstance("VikingRoom", QMatrix4x4{});
+	if (m_GpuCulling)
+	{
+		const vk::ShaderModule cullShaderModule =
+			CreateShader(QStringLiteral("./Shaders/cull.comp.spv"));
+		m_ModelManager.EnableGpuCulling(cullShaderModule, m_PipelineCache->Get());
+		m_Device.destroy(cullShaderModule);
+	}
+
+	const vk::ShaderModule mipShaderModule =
+		CreateShader(QStringLiteral("./Shaders/mip.comp.spv"));
+	m_MipmapGenerator.emplace(m_Device, m_PhysicalDevice, mipShaderModule,
+	                          m_PipelineCache->Get());
+	m_Device.destroy(mipShaderModule);
+
+	const vk::SampleCountFlagBits maxSamples =
+		m_Msaa ? PickSampleCount(m_PhysicalDevice) : vk::SampleCountFlagBits::e1;
+	m_DepthStencilFormat = PickDepthStencilFormat(m_PhysicalDevice);
+	// Starts out at the highest quality
+	m_SampleCount = maxSamples;
+	if (m_FrameBudget.has_value())
+	{
+		m_QualityGovernor.emplace(*m_FrameBudget, maxSamples);
+		const vk::ShaderModule upscaleVertexShader =
+			CreateShader(QStringLiteral("./Shaders/upscale.vert.spv"));
+		const vk::ShaderModule upscaleFragmentShader =
+			CreateShader(QStringLiteral("./Shaders/upscale.frag.spv"));
+		m_UpscalePass.emplace(m_Device, *m_Allocator, m_PipelineCache->Get(),
+		                      upscaleVertexShader, upscaleFragmentShader,
+		                      m_Target->GetColorFormat(),
+		                      m_Target->GetFinalLayout(), m_DynamicRendering);
+		m_Device.destroy(upscaleVertexShader);
+		m_Device.destroy(upscaleFragmentShader);
+	}
+
+	// Compiled in the background while the textures load
+	CreateDescriptorSetLayout();
+	CreateGraphicsPipelines();
 
 	LoadTextures();
+	// Whatever fit into the staging ring goes out as a single batch, the rest is
+	// streamed in over the next frames while rendering continues
+	m_UploadContext->Submit();
 	CreateTextureImageView();
 	CreateTextureSampler();
 
-	// Shaders
-	const vk::ShaderModule vertexShaderModule =
-		CreateShader(QStringLiteral("./Shaders/vert.spv"));
-	const vk::ShaderModule fragmentShaderModule =
-		CreateShader(QStringLiteral("./Shaders/frag.spv"));
-
-	const std::array<vk::PipelineShaderStageCreateInfo, 2> shaderInfo{
-		// Vertex shader
-		vk::PipelineShaderStageCreateInfo{
-			.stage  = vk::ShaderStageFlagBits::eVertex,
-			.module = vertexShaderModule,
-			.pName  = "main",
-		},
-		// Fragment shader
-		vk::PipelineShaderStageCreateInfo{
-			.stage  = vk::ShaderStageFlagBits::eFragment,
-			.module = fragmentShaderModule,
-			.pName  = "main",
-		},
-	};
+	CreateUniformBuffers();
+	CreateDescriptorPool();
+	CreateDescriptorSets();
+	UseGraphicsVariant();
 
-	constexpr std::array<vk::DynamicState, 2> DynamicStates{
-		vk::DynamicState::eViewport,
-		vk::DynamicState::eScissor,
-	};
-	const vk::PipelineDynamicStateCreateInfo pipelineDynamicState{
-		.flags             = vk::PipelineDynamicStateCreateFlags{},
-		.dynamicStateCount = static_cast<std::uint32_t>(DynamicStates.size()),
-		.pDynamicStates    = DynamicStates.data(),
-	};
+	if (m_ShaderHotReload)
+	{
+		m_ShaderReloader.emplace(m_Device, "./Shaders");
+		for (const auto& [samples, variant] : m_GraphicsVariants)
+		{
+			// After the first compile, so a reload never races it
+			static_cast<void>(m_PipelineLibrary->Get(variant.Id));
+			std::string name = fmt::format("Graphics {}", vk::to_string(samples));
+			const auto build = [this, id = variant.Id] {
+				return m_PipelineLibrary->Build(m_PipelineLibrary->GetState(id));
+			};
+			m_ShaderReloader->Watch(name, { "shader.vert", "shader.frag" }, build);
+			m_ReloadableVariants.emplace(std::move(name), variant.Id);
+		}
+		if (m_UpscalePass.has_value())
+		{
+			m_ShaderReloader->Watch(
+				"Upscale", { "upscale.vert", "upscale.frag" }, [this] {
+					const vk::ShaderModule vertexShader =
+						CreateShader(QStringLiteral("./Shaders/upscale.vert.spv"));
+					const vk::ShaderModule fragmentShader =
+						CreateShader(QStringLiteral("./Shaders/upscale.frag.spv"));
+					const vk::Pipeline pipeline = m_UpscalePass->BuildPipeline(
+						m_PipelineCache->Get(), vertexShader, fragmentShader);
+					m_Device.destroy(vertexShader);
+					m_Device.destroy(fragmentShader);
+					return pipeline;
+				});
+		}
+	}
+}
 
-	constexpr vk::VertexInputBindingDescription VertexBindingDescription =
-		Vertex::GetBindingDescription();
-	constexpr std::array VertexAttributeDescription =
-		Vertex::GetAttributeDescriptions();
-
-	const vk::PipelineVertexInputStateCreateInfo pipelineVertexInputInfo{
-		.vertexBindingDescriptionCount = 1,
-		.pVertexBindingDescriptions    = &VertexBindingDescription,
-		.vertexAttributeDescriptionCount =
-			static_cast<std::uint32_t>(size(VertexAttributeDescription)),
-		.pVertexAttributeDescriptions = VertexAttributeDescription.data(),
-	};
+void VulkanRenderer::CreateGraphicsPipelines()
+{
+	CPU_TRACE_SCOPE("CreateGraphicsPipelines");
+	std::tie(std::ignore, m_PipelineLayout) =
+		CreatePipelineLayoutInfo(m_Device, m_DescriptorSetLayout,
+		                         std::span{ &ModelPushConstantRange, 1U });
+
+	// Every sample count the governor may switch to, so it never compiles any
+	std::vector<vk::SampleCountFlagBits> sampleCounts{ m_SampleCount };
+	if (m_QualityGovernor.has_value())
+	{
+		for (const QualityLevel& level : m_QualityGovernor->GetLevels())
+		{
+			sampleCounts.push_back(level.Samples);
+		}
+	}
+	for (const vk::SampleCountFlagBits samples : sampleCounts)
+	{
+		if (m_GraphicsVariants.contains(samples))
+		{
+			continue;
+		}
+		const vk::RenderPass renderPass =
+			m_DynamicRendering
+				? vk::RenderPass{}
+				: CreateRenderPass(
+					  m_Device, static_cast<VkFormat>(m_Target->GetColorFormat()),
+					  static_cast<VkFormat>(m_DepthStencilFormat),
+					  static_cast<std::uint32_t>(samples), GetSceneLayout());
+		const PipelineLibrary::VariantId id = m_PipelineLibrary->Request(
+			GetGraphicsPipelineState(samples, renderPass));
+		m_GraphicsVariants.emplace(
+			samples, GraphicsVariant{ .RenderPass = renderPass, .Id = id });
+	}
+}
 
-	constexpr vk::PipelineInputAssemblyStateCreateInfo InputAssemblyInfo{
-		.topology               = vk::PrimitiveTopology::eTriangleList,
-		.primitiveRestartEnable = VK_FALSE,
+GraphicsPipelineState VulkanRenderer::GetGraphicsPipelineState(
+	const vk::SampleCountFlagBits samples,
+	const vk::RenderPass renderPass) const
+{
+	constexpr std::array BindingDescriptions{
+		GetBindingDescription<Vertex>(),
+		GetBindingDescription<InstanceData>(),
 	};
-	constexpr vk::PipelineViewportStateCreateInfo DynamicViewportInfo{
-		.viewportCount = 1,
-		.pViewports    = nullptr,
-		.scissorCount  = 1,
-		.pScissors     = nullptr,
+	constexpr std::array AttributeDescriptions = [] {
+		constexpr std::array VertexAttributes = GetAttributeDescriptions<Vertex>();
+		constexpr std::array InstanceAttributes =
+			GetAttributeDescriptions<InstanceData>();
+
+		std::array<vk::VertexInputAttributeDescription,
+		           VertexAttributes.size() + InstanceAttributes.size()>
+			attributes{};
+		const auto instanceBegin =
+			std::ranges::copy(VertexAttributes, attributes.begin()).out;
+		std::ranges::copy(InstanceAttributes, instanceBegin);
+		return attributes;
+	}();
+
+	return GraphicsPipelineState{
+		.VertexShader       = "./Shaders/shader.vert.spv",
+		.FragmentShader     = "./Shaders/shader.frag.spv",
+		.VertexBindings     = { BindingDescriptions.begin(),
+		                        BindingDescriptions.end() },
+		.VertexAttributes   = { AttributeDescriptions.begin(),
+		                        AttributeDescriptions.end() },
+		.Samples            = samples,
+		.CullMode           = vk::CullModeFlagBits::eNone,
+		.Layout             = m_PipelineLayout,
+		.RenderPass         = renderPass,
+		.ColorFormat        = m_Target->GetColorFormat(),
+		.DepthStencilFormat = m_DepthStencilFormat,
 	};
+}
 
-	const auto sampleCount =
-	    static_cast<std::uint32_t>(m_Window->sampleCountFlagBits());
-	const vk::PipelineMultisampleStateCreateInfo multisampling{
-		.rasterizationSamples  = static_cast<vk::SampleCountFlagBits>(sampleCount),
-		.sampleShadingEnable   = VK_FALSE,
-		.minSampleShading      = 1.F,
-		.pSampleMask           = nullptr,
-		.alphaToCoverageEnable = VK_FALSE,
-		.alphaToOneEnable      = VK_FALSE,
-	};
+void VulkanRenderer::UseGraphicsVariant()
+{
+	const GraphicsVariant& variant = m_GraphicsVariants.at(m_SampleCount);
+	m_RenderPass = variant.RenderPass;
+	// Only waits when the variant is still compiling
+	m_GraphicsPipeline = m_PipelineLibrary->Get(variant.Id);
+}
 
-	constexpr vk::PipelineRasterizationStateCreateInfo RasterizationInfo{
-		.depthClampEnable        = VK_FALSE,
-		.rasterizerDiscardEnable = VK_FALSE,
-		.polygonMode             = vk::PolygonMode::eFill,
-		.cullMode                = vk::CullModeFlagBits::eNone,
-		.frontFace               = vk::FrontFace::eCounterClockwise,
-		.depthBiasEnable         = VK_FALSE,
-		.depthBiasConstantFactor = 0.F,
-		.depthBiasClamp          = 0.F,
-		.depthBiasSlopeFactor    = 0.F,
-		.lineWidth               = 1.F,
-	};
+void VulkanRenderer::DestroyGraphicsPipelines() noexcept
+{
+	// The pipelines themselves belong to the library
+	for (const auto& [samples, variant] : m_GraphicsVariants)
+	{
+		m_Device.destroy(variant.RenderPass);
+	}
+	m_GraphicsVariants.clear();
+	m_ReloadableVariants.clear();
+	m_Device.destroy(m_PipelineLayout);
+	m_GraphicsPipeline = vk::Pipeline{};
+	m_PipelineLayout   = vk::PipelineLayout{};
+	m_RenderPass       = vk::RenderPass{};
+}
 
-	/* Skip multisampling setup, it's handled by VulkanWindow? */
-	m_RenderPass = CreateRenderPass(m_Device, m_Window->colorFormat(),
-	                                m_Window->depthStencilFormat(), sampleCount);
+void VulkanRenderer::CreateFramebuffers(const vk::Extent2D size)
+{
+	m_Attachments = std::make_unique<TransientAttachments>(
+		m_Device, m_PhysicalDevice, *m_Allocator, size, m_SwapChainImageCount,
+		m_Target->GetColorFormat(), m_DepthStencilFormat, m_SampleCount);
+	// The views are picked every frame instead of framebuffers
+	if (m_DynamicRendering)
+	{
+		return;
+	}
 
-	CreateDescriptorSetLayout();
-	CreateUniformBuffers();
-	CreateDescriptorPool();
-	CreateDescriptorSets();
+	const bool msaa = m_SampleCount > vk::SampleCountFlagBits::e1;
 
-	constexpr vk::PipelineDepthStencilStateCreateInfo DepthStencil{
-		.depthTestEnable       = vk::True,
-		.depthWriteEnable      = vk::True,
-		.depthCompareOp        = vk::CompareOp::eLess,
-		.depthBoundsTestEnable = VK_FALSE,
-		.stencilTestEnable     = VK_FALSE,
-		.minDepthBounds        = 0.F,
-		.maxDepthBounds        = 1.F,
-	};
+	const vk::ImageView depthImageView = m_Attachments->GetDepthStencilView();
+	for (std::uint32_t i{ 0U }; i < m_SwapChainImageCount; ++i)
+	{
+		// Same order as the attachments of CreateRenderPass
+		const std::array<vk::ImageView, 3> attachmentImageViews =
+			msaa ? std::array{ m_Attachments->GetColorView(i), depthImageView,
+			                   GetSceneView(i) }
+			     : std::array{ GetSceneView(i), depthImageView, vk::ImageView{} };
+
+		m_Framebuffers.at(i) =
+			m_Device.createFramebuffer(vk::FramebufferCreateInfo{
+				.renderPass      = m_RenderPass,
+				.attachmentCount = msaa ? 3U : 2U,
+				.pAttachments    = attachmentImageViews.data(),
+				.width           = size.width,
+				.height          = size.height,
+				.layers          = 1,
+			});
+	}
+}
+
+void VulkanRenderer::DestroyFramebuffers() noexcept
+{
+	for (std::uint32_t i{ 0U }; i < m_SwapChainImageCount; ++i)
+	{
+		m_Device.destroy(m_Framebuffers.at(i));
+	}
+	m_Framebuffers.fill(vk::Framebuffer{});
+	m_Attachments.reset();
+}
+
+void VulkanRenderer::ApplyQualityLevel(const vk::Extent2D size)
+{
+	const vk::SampleCountFlagBits samples = m_QualityGovernor->GetLevel().Samples;
+	// The resolution is only the render area, nothing depends on it
+	if (samples == m_SampleCount)
+	{
+		return;
+	}
+
+	CPU_TRACE_SCOPE("ApplyQualityLevel");
+	// The frames in flight still use the attachments, so they are destroyed once
+	// those have finished. The pipeline for the new sample count was compiled at
+	// startup
+	m_RetiredAttachments.push_back(RetiredAttachments{
+		.FrameNumber  = m_FrameNumber,
+		.Attachments  = std::move(m_Attachments),
+		.Framebuffers = std::exchange(m_Framebuffers, {}),
+	});
+	m_SampleCount = samples;
+	UseGraphicsVariant();
+	CreateFramebuffers(size);
+}
 
-	vk::PipelineColorBlendStateCreateInfo colorBlendCreateInfo{};
-	std::tie(colorBlendCreateInfo, m_PipelineLayout) =
-		CreatePipelineLayoutInfo(m_Device, m_DescriptorSetLayout);
-
-	auto [createPipelineResult, pipeline] = m_Device.createGraphicsPipeline(
-		vk::PipelineCache{},
-		vk::GraphicsPipelineCreateInfo{
-			.stageCount          = static_cast<std::uint32_t>(shaderInfo.size()),
-			.pStages             = shaderInfo.data(),
-			.pVertexInputState   = &pipelineVertexInputInfo,
-			.pInputAssemblyState = &InputAssemblyInfo,
-			.pViewportState      = &DynamicViewportInfo,
-			.pRasterizationState = &RasterizationInfo,
-			.pMultisampleState   = &multisampling,
-			.pDepthStencilState  = &DepthStencil,
-			.pColorBlendState    = &colorBlendCreateInfo,
-			.pDynamicState       = &pipelineDynamicState,
-			.layout              = m_PipelineLayout,
-			.renderPass          = m_RenderPass,
-			.subpass             = 0,
-			.basePipelineIndex   = -1,
+void VulkanRenderer::DestroyRetiredAttachments(const bool deviceIdle) noexcept
+{
+	// Every frame in flight has started after they were swapped out
+	std::erase_if(
+		m_RetiredAttachments,
+		[this, deviceIdle](const RetiredAttachments& retired) {
+			if (!deviceIdle &&
+			    m_FrameNumber < retired.FrameNumber + m_ConcurrentFrameCount)
+			{
+				return false;
+			}
+			for (const vk::Framebuffer framebuffer : retired.Framebuffers)
+			{
+				m_Device.destroy(framebuffer);
+			}
+			return true;
+		});
+}
+
+void VulkanRenderer::SwapReloadedPipelines()
+{
+	if (!m_ShaderReloader.has_value())
+	{
+		return;
+	}
+	// Every frame in flight has started after the pipeline was swapped out
+	std::erase_if(m_RetiredPipelines, [this](const RetiredPipeline& retired) {
+		if (m_FrameNumber < retired.FrameNumber + m_ConcurrentFrameCount)
+		{
+			return false;
+		}
+		m_Device.destroy(retired.Pipeline);
+		return true;
+	});
+
+	for (const ShaderReloader::Reloaded& reloaded :
+	     m_ShaderReloader->TakeReloaded())
+	{
+		vk::Pipeline oldPipeline{};
+		if (reloaded.Name == "Upscale")
+		{
+			oldPipeline = m_UpscalePass->SwapPipeline(reloaded.Pipeline);
+		}
+		else
+		{
+			const PipelineLibrary::VariantId id =
+				m_ReloadableVariants.at(reloaded.Name);
+			oldPipeline = m_PipelineLibrary->Replace(id, reloaded.Pipeline);
+			if (id == m_GraphicsVariants.at(m_SampleCount).Id)
+			{
+				m_GraphicsPipeline = reloaded.Pipeline;
+			}
+		}
+		m_RetiredPipelines.push_back(RetiredPipeline{
+			.FrameNumber = m_FrameNumber,
+			.Pipeline    = oldPipeline,
 		});
+		fmt::println("Reloaded the {} pipeline", reloaded.Name);
+	}
+}
 
-	if (createPipelineResult != vk::Result::eSuccess)
+vk::Extent2D VulkanRenderer::GetRenderExtent(const vk::Extent2D size) const
+{
+	if (!m_QualityGovernor.has_value())
 	{
-		throw std::runtime_error{ fmt::format(
-			"Failed to create graphics pipeline: {}",
-			vk::to_string(createPipelineResult)) };
+		return size;
 	}
+	const float scale = m_QualityGovernor->GetLevel().ResolutionScale;
+	const auto scaled = [scale](const std::uint32_t length) {
+		return std::max(
+			static_cast<std::uint32_t>(static_cast<float>(length) * scale), 1U);
+	};
+	return vk::Extent2D{
+		.width  = scaled(size.width),
+		.height = scaled(size.height),
+	};
+}
 
-	m_GraphicsPipeline = pipeline;
+vk::Image VulkanRenderer::GetSceneImage(const std::uint32_t idx) const
+{
+	return m_UpscalePass.has_value() ? m_UpscalePass->GetSceneImage(idx)
+	                                 : m_Target->GetColorImage(idx);
+}
 
-	m_Device.destroy(vertexShaderModule);
-	m_Device.destroy(fragmentShaderModule);
+vk::ImageView VulkanRenderer::GetSceneView(const std::uint32_t idx) const
+{
+	return m_UpscalePass.has_value() ? m_UpscalePass->GetSceneView(idx)
+	                                 : m_Target->GetColorView(idx);
+}
+
+vk::ImageLayout VulkanRenderer::GetSceneLayout() const
+{
+	// Sampled by the upscale pass, which leaves the target in its final layout
+	return m_UpscalePass.has_value() ? vk::ImageLayout::eShaderReadOnlyOptimal
+	                                 : m_Target->GetFinalLayout();
+}
+
+void VulkanRenderer::SetFrameBudget(const double frameBudget)
+{
+	assert(!m_Device);
+	m_FrameBudget = frameBudget;
+}
+
+void VulkanRenderer::SetFramePacing(const FramePacing& pacing)
+{
+	if (pacing.FramesInFlight > m_ConcurrentFrameCount)
+	{
+		fmt::println(stderr, "The target only has {} frames, {} can't be in flight",
+		             m_ConcurrentFrameCount, pacing.FramesInFlight);
+	}
+	m_DrainQueue = pacing.FramesInFlight > 0U &&
+	               pacing.FramesInFlight < m_ConcurrentFrameCount;
+	m_FrameLimiter.reset();
+	if (pacing.FrameRateLimit > 0U)
+	{
+		m_FrameLimiter.emplace(pacing.FrameRateLimit);
+	}
+}
+
+void VulkanRenderer::EnableShaderHotReload()
+{
+	assert(!m_Device);
+	m_ShaderHotReload = true;
 }
 
 void VulkanRenderer::initSwapChainResources()
 {
-	const QSize size = m_Window->swapChainImageSize();
+	CPU_TRACE_SCOPE("initSwapChainResources");
+	const vk::Extent2D size = m_Target->GetExtent();
 
-	m_SwapChainImageCount = m_Window->swapChainImageCount();
+	m_SwapChainImageCount = m_Target->GetImageCount();
 	// Window has been minimised, using this size for framebuffer is
 	// illegal
 	// + when window will be visible again it should return to
 	// previous size or at least we will get an event about resizing
 	// again
-	if (size.height() < MinimumWindowSize || size.width() < MinimumWindowSize)
+	if (size.height < MinimumWindowSize || size.width < MinimumWindowSize)
 	{
 		return;
 	}
 
 	fmt::print("Creating SwapChainResources for size [{}x{}] and {} images\n",
-	           size.width(), size.height(), m_SwapChainImageCount);
-
-	const vk::ImageView depthImageView{ m_Window->depthStencilImageView() };
-	for (int i{ 0U }; i < m_SwapChainImageCount; ++i)
+	           size.width, size.height, m_SwapChainImageCount);
+	// Full size, the scene is scaled by only rendering to part of them
+	if (m_UpscalePass.has_value())
 	{
-		const vk::ImageView msaaColorImageView{ m_Window->msaaColorImageView(i) };
-		const std::array<vk::ImageView, 3> attachmentImageViews{
-			msaaColorImageView, depthImageView, m_Window->swapChainImageView(i)
-		};
-
-		m_Framebuffers.at(static_cast<std::size_t>(i)) =
-			m_Device.createFramebuffer(vk::FramebufferCreateInfo{
-				.renderPass      = m_RenderPass,
-				.attachmentCount = attachmentImageViews.size(),
-				.pAttachments    = attachmentImageViews.data(),
-				.width           = static_cast<std::uint32_t>(size.width()),
-				.height          = static_cast<std::uint32_t>(size.height()),
-				.layers          = 1,
-			});
+		std::vector<vk::ImageView> targetViews{};
+		targetViews.reserve(m_SwapChainImageCount);
+		for (std::uint32_t i{ 0U }; i < m_SwapChainImageCount; ++i)
+		{
+			targetViews.push_back(m_Target->GetColorView(i));
+		}
+		m_UpscalePass->CreateImages(size, targetViews);
 	}
+	CreateFramebuffers(size);
 }
 
 void VulkanRenderer::releaseSwapChainResources()
 {
 	// TODO: Probably shouldn't be destroyed if window is small...
-	for (int i{ 0U }; i < m_SwapChainImageCount; ++i)
+	DestroyFramebuffers();
+	DestroyRetiredAttachments(true);
+	if (m_UpscalePass.has_value())
 	{
-		m_Device.destroy(m_Framebuffers.at(static_cast<std::size_t>(i)));
+		m_UpscalePass->DestroyImages();
 	}
 }
 
 void VulkanRenderer::releaseResources()
 {
-	m_Device.destroy(m_GraphicsPipeline);
-	m_Device.destroy(m_PipelineLayout);
-	m_Device.destroy(m_RenderPass);
+	// Waits for the pending uploads and releases their staging memory
+	m_UploadContext.reset();
+	m_ParallelRecorder.reset();
+	m_GpuProfiler->PrintStatistics();
+	m_GpuProfiler.reset();
+	m_ProfileRanges.fill(GpuProfileRange{});
+	m_MipmapGenerator.reset();
+	// Waits for textures still being decoded or compressed in the background
+	m_TextureLoader.reset();
+	m_TextureCache.reset();
+
+	// Stops rebuilding first, the pipelines are built from what follows
+	m_ShaderReloader.reset();
+	for (const RetiredPipeline& retired : m_RetiredPipelines)
+	{
+		m_Device.destroy(retired.Pipeline);
+	}
+	m_RetiredPipelines.clear();
+	m_UpscalePass.reset();
+	m_QualityGovernor.reset();
+	// Waits for the variants still compiling
+	m_PipelineLibrary.reset();
+	DestroyGraphicsPipelines();
+	// Written back to disk for the next launch
+	m_PipelineCache.reset();
 
 	for (std::uint32_t i{ 0U }; i < m_ConcurrentFrameCount; ++i)
 	{
 		m_Device.destroy(m_UniformBuffers.at(i));
-		m_Device.freeMemory(m_UniformDeviceMemory.at(i));
+		m_Allocator->Free(m_UniformAllocations.at(i));
 	}
 	m_Device.destroy(m_DescriptorPool);
 	m_Device.destroy(m_DescriptorSetLayout);
@@ -571,102 +1086,167 @@ void VulkanRenderer::releaseResources()
 	m_Device.destroy(m_TextureSampler);
 	m_Device.destroy(m_TextureImageView);
 	m_Device.destroy(m_TextureImage);
-	m_Device.free(m_TextureImageMemory);
+	m_Allocator->Free(m_TextureImageAllocation);
+	m_Device.destroy(m_FallbackImageView);
+	m_Device.destroy(m_FallbackImage);
+	m_Allocator->Free(m_FallbackImageAllocation);
 
 	m_ModelManager.UnloadAllModels();
 
+	m_Allocator->PrintStatistics();
+	m_Allocator.reset();
+
 	m_PhysicalDevice = vk::PhysicalDevice{};
 	m_Device         = vk::Device{};
 }
 
 void VulkanRenderer::startNextFrame()
 {
-	const QSize size = m_Window->swapChainImageSize();
+	CPU_TRACE_SCOPE("startNextFrame");
+	// Both wait before anything is sampled, so the frame shows the latest state
+	if (m_DrainQueue)
+	{
+		CPU_TRACE_SCOPE("Drain queue");
+		m_Target->GetGraphicsQueue().waitIdle();
+	}
+	if (m_FrameLimiter.has_value())
+	{
+		m_FrameLimiter->Wait();
+	}
+	using Clock = std::chrono::steady_clock;
+	// What recording takes, the governor weighs it against the GPU time
+	const Clock::time_point frameStart = Clock::now();
+
+	const vk::Extent2D size = m_Target->GetExtent();
 	// Window not visible, no need to render anything
-	if (size.height() < MinimumWindowSize || size.width() < MinimumWindowSize)
+	if (size.height < MinimumWindowSize || size.width < MinimumWindowSize)
 	{
 		// Tell window we're ready, otherwise we will hang here...
-		m_Window->frameReady();
-		m_Window->requestUpdate();
+		m_Target->FrameReady();
 		return;
 	}
 	// CurrentFrame for buffers
-	const int currentFrame = m_Window->currentFrame();
+	const std::uint32_t currentFrame = m_Target->GetCurrentFrame();
 	// CurrentImageIdx for everything else
-	const int currentImageIdx = m_Window->currentSwapChainImageIndex();
-
-	UpdateUniformBuffer(currentFrame, size);
-
-	const auto sampleCount =
-	    static_cast<vk::SampleCountFlagBits>(m_Window->sampleCountFlagBits());
-
-	constexpr vk::ClearValue ClearColor{
-		.color =
-			vk::ClearColorValue{
-				std::array<float, 4>{ 0.0F, 0.0F, 0.0F, 1.0F },
-			},
-	};
-	constexpr vk::ClearValue ClearDepthStencil{
-		.depthStencil =
-			vk::ClearDepthStencilValue{
-				.depth   = 1.F,
-				.stencil = 0U,
-			},
-	};
-	constexpr std::array<vk::ClearValue, 3> ClearValues{
-		ClearColor,
-		ClearDepthStencil,
-		ClearColor,
-	};
+	const std::uint32_t currentImageIdx = m_Target->GetCurrentImage();
+
+	const vk::CommandBuffer commandBuffer = m_Target->GetCurrentCommandBuffer();
+	// The previous submission of this frame has finished, its timestamps can
+	// be read without waiting
+	GpuProfileRange& profileRange = m_ProfileRanges.at(currentFrame);
+	const std::optional<double> gpuTime = m_GpuProfiler->ResolveRange(profileRange);
+	if (m_QualityGovernor.has_value() && gpuTime.has_value() &&
+	    m_QualityGovernor->AddFrame(m_LastCpuTime, *gpuTime))
+	{
+		ApplyQualityLevel(size);
+	}
+	DestroyRetiredAttachments(false);
+	SwapReloadedPipelines();
+	profileRange = m_GpuProfiler->BeginRange(commandBuffer);
+	const vk::Extent2D renderExtent = GetRenderExtent(size);
 
-	const vk::RenderPassBeginInfo renderPassInfo{
-		.renderPass  = m_RenderPass,
-		.framebuffer = m_Framebuffers.at(static_cast<std::size_t>(currentImageIdx)),
-		.renderArea =
-			vk::Rect2D{
-				vk::Offset2D{ 0, 0 },
-				vk::Extent2D{
-					static_cast<std::uint32_t>(size.width()),
-					static_cast<std::uint32_t>(size.height()),
-				},
-			},
-		.clearValueCount = sampleCount > vk::SampleCountFlagBits::e1 ? 3U : 2U,
-		.pClearValues    = ClearValues.data(),
-	};
+	{
+		CPU_TRACE_SCOPE("Submit uploads");
+		// Reclaim staging space first, so the pending uploads can continue with it
+		m_UploadContext->CollectCompleted();
+		m_UploadContext->Submit();
+	}
+	BindUploadedTexture(currentFrame);
 
-	const vk::CommandBuffer commandBuffer{ m_Window->currentCommandBuffer() };
-	commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
-	                           m_GraphicsPipeline);
+	UpdateUniformBuffer(currentFrame, renderExtent);
+	++m_FrameNumber;
+	if (m_FrameNumber % ProfilerReportInterval == 0U)
+	{
+		m_GpuProfiler->PrintStatistics();
+	}
 
+	if (m_GpuCulling)
+	{
+		m_ModelManager.CullAllModels(commandBuffer, currentFrame,
+		                             m_UniformBuffers.at(currentFrame),
+		                             profileRange);
+	}
 	const vk::Viewport viewport{
 		.x        = 0.F,
 		.y        = 0.F,
-		.width    = static_cast<float>(size.width()),
-		.height   = static_cast<float>(size.height()),
+		.width    = static_cast<float>(renderExtent.width),
+		.height   = static_cast<float>(renderExtent.height),
 		.minDepth = 0.F,
 		.maxDepth = 1.F,
 	};
 	const vk::Rect2D scissor{
 		.offset = vk::Offset2D{ 0, 0 },
-		.extent =
-			vk::Extent2D{
-				static_cast<std::uint32_t>(size.width()),
-				static_cast<std::uint32_t>(size.height()),
-			},
+		.extent = renderExtent,
+	};
+	const vk::DescriptorSet descriptorSet = m_DescriptorSets.at(currentFrame);
+	const auto bindState = [this, &viewport, &scissor,
+	                        descriptorSet](const vk::CommandBuffer buffer) {
+		buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_GraphicsPipeline);
+		buffer.setViewport(0U, vk::ArrayProxy{ viewport });
+		buffer.setScissor(0U, vk::ArrayProxy{ scissor });
+		buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+		                          m_PipelineLayout, 0,
+		                          vk::ArrayProxy{ descriptorSet },
+		                          vk::ArrayProxy<const uint32_t>{});
 	};
-	commandBuffer.setViewport(0U, vk::ArrayProxy{ viewport });
-	commandBuffer.setScissor(0U, vk::ArrayProxy{ scissor });
 
-	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-									 m_PipelineLayout, 0,
-									 vk::ArrayProxy{ m_DescriptorSets.at(
-										 static_cast<std::size_t>(currentFrame)) },
-									 vk::ArrayProxy<const uint32_t>{});
-	m_ModelManager.RenderAllModels(commandBuffer);
+	// Ended right after the render pass, before the frame is submitted
+	std::optional<GpuProfileScope> renderPassScope{ std::in_place, profileRange,
+		                                            "Render pass" };
+	if (m_ParallelRecorder.has_value())
+	{
+		// Nothing but the secondary command buffers may be recorded inside
+		BeginRendering(commandBuffer, currentImageIdx, renderExtent,
+		               vk::SubpassContents::eSecondaryCommandBuffers);
+		const vk::Format colorFormat = m_Target->GetColorFormat();
+		const vk::CommandBufferInheritanceRenderingInfo inheritanceRendering{
+			.colorAttachmentCount    = 1U,
+			.pColorAttachmentFormats = &colorFormat,
+			.depthAttachmentFormat   = m_DepthStencilFormat,
+			.stencilAttachmentFormat = m_DepthStencilFormat,
+			.rasterizationSamples    = m_SampleCount,
+		};
+		const vk::CommandBufferInheritanceInfo inheritance{
+			.pNext       = m_DynamicRendering ? &inheritanceRendering : nullptr,
+			.renderPass  = m_RenderPass,
+			.subpass     = 0U,
+			.framebuffer = m_DynamicRendering
+			                   ? vk::Framebuffer{}
+			                   : m_Framebuffers.at(currentImageIdx),
+		};
+		const std::vector<vk::CommandBuffer> secondaryCommandBuffers =
+			m_ModelManager.RecordAllModels(*m_ParallelRecorder, currentFrame,
+			                               inheritance, m_PipelineLayout,
+			                               bindState);
+		if (!secondaryCommandBuffers.empty())
+		{
+			commandBuffer.executeCommands(secondaryCommandBuffers);
+		}
+	}
+	else
+	{
+		BeginRendering(commandBuffer, currentImageIdx, renderExtent,
+		               vk::SubpassContents::eInline);
+		{
+			const GpuProfileScope bindScope{ profileRange, "Bind state" };
+			bindState(commandBuffer);
+		}
+		m_ModelManager.RenderAllModels(commandBuffer, currentFrame,
+		                               m_PipelineLayout, profileRange);
+	}
+	EndRendering(commandBuffer, currentImageIdx);
+	renderPassScope.reset();
 
-	commandBuffer.endRenderPass();
+	if (m_UpscalePass.has_value())
+	{
+		const GpuProfileScope upscaleScope{ profileRange, "Upscale" };
+		m_UpscalePass->Record(commandBuffer, currentImageIdx,
+		                      m_Target->GetColorImage(currentImageIdx),
+		                      m_Target->GetColorView(currentImageIdx),
+		                      renderExtent);
+	}
 
-	m_Window->frameReady();
-	m_Window->requestUpdate();
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+	m_LastCpuTime      = Milliseconds{ Clock::now() - frameStart }.count();
+	m_Target->FrameReady();
 }
@@ -0,0 +1,108 @@
+#include <VulkanTutorial/WindowTarget.h>
+
+WindowTarget::WindowTarget(QVulkanWindow& window,
+                           const WindowDeviceSetup& deviceSetup)
+	: m_Window{ &window }
+	, m_DeviceSetup{ &deviceSetup }
+{
+}
+
+vk::Device WindowTarget::GetDevice() const
+{
+	return vk::Device{ m_Window->device() };
+}
+
+vk::PhysicalDevice WindowTarget::GetPhysicalDevice() const
+{
+	return vk::PhysicalDevice{ m_Window->physicalDevice() };
+}
+
+vk::Queue WindowTarget::GetGraphicsQueue() const
+{
+	return vk::Queue{ m_Window->graphicsQueue() };
+}
+
+std::uint32_t WindowTarget::GetGraphicsQueueFamily() const
+{
+	return m_Window->graphicsQueueFamilyIndex();
+}
+
+std::uint32_t WindowTarget::GetConcurrentFrameCount() const
+{
+	return static_cast<std::uint32_t>(m_Window->concurrentFrameCount());
+}
+
+vk::Format WindowTarget::GetColorFormat() const
+{
+	return static_cast<vk::Format>(m_Window->colorFormat());
+}
+
+vk::ImageLayout WindowTarget::GetFinalLayout() const
+{
+	return vk::ImageLayout::ePresentSrcKHR;
+}
+
+bool WindowTarget::IsDynamicRenderingEnabled() const
+{
+	return m_DeviceSetup->DynamicRendering;
+}
+
+vk::Queue WindowTarget::GetTransferQueue() const
+{
+	if (!m_DeviceSetup->TransferQueueFamily.has_value())
+	{
+		return GetGraphicsQueue();
+	}
+	return GetDevice().getQueue(*m_DeviceSetup->TransferQueueFamily, 0U);
+}
+
+std::uint32_t WindowTarget::GetTransferQueueFamily() const
+{
+	return m_DeviceSetup->TransferQueueFamily.value_or(GetGraphicsQueueFamily());
+}
+
+vk::Extent2D WindowTarget::GetExtent() const
+{
+	const QSize size = m_Window->swapChainImageSize();
+	return vk::Extent2D{
+		.width  = static_cast<std::uint32_t>(size.width()),
+		.height = static_cast<std::uint32_t>(size.height()),
+	};
+}
+
+std::uint32_t WindowTarget::GetImageCount() const
+{
+	return static_cast<std::uint32_t>(m_Window->swapChainImageCount());
+}
+
+vk::ImageView WindowTarget::GetColorView(const std::uint32_t idx) const
+{
+	return vk::ImageView{ m_Window->swapChainImageView(static_cast<int>(idx)) };
+}
+
+vk::Image WindowTarget::GetColorImage(const std::uint32_t idx) const
+{
+	return vk::Image{ m_Window->swapChainImage(static_cast<int>(idx)) };
+}
+
+std::uint32_t WindowTarget::GetCurrentFrame() const
+{
+	return static_cast<std::uint32_t>(m_Window->currentFrame());
+}
+
+std::uint32_t WindowTarget::GetCurrentImage() const
+{
+	return static_cast<std::uint32_t>(m_Window->currentSwapChainImageIndex());
+}
+
+vk::CommandBuffer WindowTarget::GetCurrentCommandBuffer() const
+{
+	return vk::CommandBuffer{ m_Window->currentCommandBuffer() };
+}
+
+void WindowTarget::FrameReady()
+{
+	// The window submits and presents, then asks for the next frame right away
+	m_Window->frameReady();
+	m_Window->requestUpdate();
+}
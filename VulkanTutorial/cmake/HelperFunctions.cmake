@@ -1,3 +1,4 @@
+# Any extra arguments are passed to glslc, e.g. "-DNAME" to select a variant
 function(add_shader_dependency shaders)
   add_custom_command(
     TARGET VulkanTutorial
@@ -7,14 +8,15 @@ function(add_shader_dependency shaders)
   foreach(shader ${shaders})
     get_filename_component(FILENAME ${shader} NAME_WLE)
     get_filename_component(EXTENSION ${shader} EXT)
-    # Remove the '.', ".frag" => "frag"
-    string(SUBSTRING "${EXTENSION}" 1 -1 EXTENSION)
-    set(OUT_SHADER_FILE "${CMAKE_CURRENT_BINARY_DIR}/Shaders/${EXTENSION}.spv")
+    # "shader.frag" => "shader.frag.spv", several shaders can share a stage
+    set(OUT_SHADER_FILE
+        "${CMAKE_CURRENT_BINARY_DIR}/Shaders/${FILENAME}${EXTENSION}.spv")
     add_custom_command(
       OUTPUT "${OUT_SHADER_FILE}"
       COMMAND
         ${glslc_executable} "--target-env=vulkan1.3"
-        "${CMAKE_CURRENT_SOURCE_DIR}/${shader}" "-O" "-o" "${OUT_SHADER_FILE}"
+        ${ARGN} "${CMAKE_CURRENT_SOURCE_DIR}/${shader}" "-O" "-o"
+        "${OUT_SHADER_FILE}"
       MAIN_DEPENDENCY "${CMAKE_CURRENT_SOURCE_DIR}/${shader}")
     list(APPEND SPV_SHADERS "${OUT_SHADER_FILE}")
   endforeach()
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <VulkanTutorial/Texture.h>
+
+// Encodes a single level RGBA8 texture to BC1 with a full mip chain, which
+// takes 8 bytes per 4x4 block instead of 64. Alpha is dropped, so this is only
+// meant for opaque textures.
+// Blocks are encoded in parallel, with a bounding box fit instead of a least
+// squares one
+[[nodiscard]] TextureData EncodeBc1(const TextureData& image);
+
+[[nodiscard]] bool IsOpaque(const TextureData& image);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Unbounded multi-producer, single-consumer queue without locks. Producers
+// push with a compare-and-swap, the consumer takes everything at once, so
+// neither side ever waits on the other
+template <typename T>
+class [[nodiscard]] CompletionQueue
+{
+public:
+	CompletionQueue() = default;
+	CompletionQueue(const CompletionQueue&)            = delete;
+	CompletionQueue(CompletionQueue&&) noexcept        = delete;
+	CompletionQueue& operator=(const CompletionQueue&) = delete;
+	CompletionQueue& operator=(CompletionQueue&&)      = delete;
+	~CompletionQueue() noexcept
+	{
+		Node* node = m_Head.exchange(nullptr);
+		while (node != nullptr)
+		{
+			const std::unique_ptr<Node> owned{ node };
+			node = owned->Next;
+		}
+	}
+
+	void Push(T value)
+	{
+		auto node = std::make_unique<Node>(Node{
+			.Value = std::move(value),
+			.Next  = m_Head.load(std::memory_order_relaxed),
+		});
+		while (!m_Head.compare_exchange_weak(node->Next, node.get(),
+		                                     std::memory_order_release,
+		                                     std::memory_order_relaxed))
+		{
+		}
+		node.release();
+		m_Head.notify_one();
+	}
+
+	// Oldest first, empty when nothing has been pushed since the last call
+	[[nodiscard]] std::vector<T> TakeAll()
+	{
+		std::vector<T> values{};
+		Node* node = m_Head.exchange(nullptr, std::memory_order_acquire);
+		while (node != nullptr)
+		{
+			const std::unique_ptr<Node> owned{ node };
+			values.push_back(std::move(owned->Value));
+			node = owned->Next;
+		}
+		std::ranges::reverse(values);
+		return values;
+	}
+
+	// Blocks until something has been pushed, only for the consumer
+	void Wait() const noexcept
+	{
+		m_Head.wait(nullptr, std::memory_order_acquire);
+	}
+
+private:
+	struct Node
+	{
+		T Value;
+		Node* Next{ nullptr };
+	};
+
+	std::atomic<Node*> m_Head{ nullptr };
+};
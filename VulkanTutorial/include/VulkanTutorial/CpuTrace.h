@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+
+// Collects CPU scopes for a Chrome trace. Every thread records into a ring
+// buffer of its own, recording takes no locks and overwrites the oldest
+// events once the buffer is full. Scopes are only recorded when built with
+// VULKAN_TUTORIAL_CPU_TRACE, otherwise CPU_TRACE_SCOPE compiles to nothing
+class CpuTrace
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	constexpr static std::size_t EventsPerThread = std::size_t{ 1U } << 16U;
+
+	// Name has to outlive the trace, a string literal
+	static void Record(const char* name,
+	                   Clock::time_point start,
+	                   Clock::time_point end) noexcept;
+	// Shown in the trace instead of the thread's number
+	static void SetThreadName(const char* name);
+
+	// Chrome trace event JSON, which chrome://tracing and Perfetto open.
+	// Threads still recording may lose their oldest events in it
+	static void WriteChromeTrace(const std::filesystem::path& path);
+};
+
+class [[nodiscard]] CpuTraceScope
+{
+public:
+	explicit CpuTraceScope(const char* const name) noexcept
+		: m_Name{ name }
+		, m_Start{ CpuTrace::Clock::now() }
+	{
+	}
+	CpuTraceScope(const CpuTraceScope&)            = delete;
+	CpuTraceScope(CpuTraceScope&&) noexcept        = delete;
+	CpuTraceScope& operator=(const CpuTraceScope&) = delete;
+	CpuTraceScope& operator=(CpuTraceScope&&)      = delete;
+	~CpuTraceScope() noexcept
+	{
+		CpuTrace::Record(m_Name, m_Start, CpuTrace::Clock::now());
+	}
+
+private:
+	const char* m_Name;
+	CpuTrace::Clock::time_point m_Start;
+};
+
+#ifdef VULKAN_TUTORIAL_CPU_TRACE
+#define CPU_TRACE_CONCAT_IMPL(a, b) a##b
+#define CPU_TRACE_CONCAT(a, b) CPU_TRACE_CONCAT_IMPL(a, b)
+// Traces the rest of the enclosing block
+#define CPU_TRACE_SCOPE(name) \
+	const CpuTraceScope CPU_TRACE_CONCAT(cpuTraceScope, __LINE__) { name }
+#define CPU_TRACE_THREAD_NAME(name) CpuTrace::SetThreadName(name)
+#else
+#define CPU_TRACE_SCOPE(name) static_cast<void>(0)
+#define CPU_TRACE_THREAD_NAME(name) static_cast<void>(0)
+#endif
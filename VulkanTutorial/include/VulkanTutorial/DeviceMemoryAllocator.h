@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Buffers and linear images can share blocks, optimal images get their own
+// pools, so bufferImageGranularity never needs to be taken into account
+enum class ResourceTiling : std::uint8_t
+{
+	Linear,
+	Optimal,
+};
+
+struct DeviceAllocation
+{
+	constexpr static std::uint32_t DedicatedBlock =
+		std::numeric_limits<std::uint32_t>::max();
+
+	vk::DeviceMemory Memory;
+	vk::DeviceSize Offset{};
+	vk::DeviceSize Size{};
+	// Only valid for host visible memory, already points at Offset
+	void* MappedData{ nullptr };
+
+	std::uint32_t MemoryTypeIndex{};
+	std::uint32_t BlockIndex{ DedicatedBlock };
+	ResourceTiling Tiling{ ResourceTiling::Linear };
+};
+
+struct DeviceAllocatorStatistics
+{
+	std::uint32_t BlockCount{};
+	std::uint32_t DedicatedAllocationCount{};
+	std::uint32_t SubAllocationCount{};
+	vk::DeviceSize ReservedBytes{};
+	vk::DeviceSize UsedBytes{};
+	vk::DeviceSize LargestFreeRange{};
+};
+
+class [[nodiscard]] DeviceMemoryAllocator
+{
+public:
+	constexpr static vk::DeviceSize DefaultBlockSize =
+		vk::DeviceSize{ 64U } * 1024U * 1024U;
+
+	DeviceMemoryAllocator(vk::Device device,
+	                      vk::PhysicalDevice physicalDevice,
+	                      vk::DeviceSize blockSize = DefaultBlockSize);
+	DeviceMemoryAllocator(const DeviceMemoryAllocator&)            = delete;
+	DeviceMemoryAllocator(DeviceMemoryAllocator&&) noexcept        = delete;
+	DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+	DeviceMemoryAllocator& operator=(DeviceMemoryAllocator&&)      = delete;
+	~DeviceMemoryAllocator() noexcept;
+
+	[[nodiscard]] DeviceAllocation Allocate(
+		const vk::MemoryRequirements& memoryRequirements,
+		vk::MemoryPropertyFlags memoryFlags,
+		ResourceTiling tiling);
+	void Free(const DeviceAllocation& allocation) noexcept;
+
+	[[nodiscard]] DeviceAllocatorStatistics GetStatistics() const;
+	void PrintStatistics() const;
+
+private:
+	struct FreeRange
+	{
+		vk::DeviceSize Offset{};
+		vk::DeviceSize Size{};
+	};
+
+	struct MemoryBlock
+	{
+		vk::DeviceMemory Memory;
+		vk::DeviceSize Size{};
+		void* MappedData{ nullptr };
+		std::uint32_t AllocationCount{};
+		// Sorted by offset, neighbours are merged back on free
+		std::vector<FreeRange> FreeRanges;
+	};
+
+	struct MemoryPool
+	{
+		std::vector<MemoryBlock> Blocks;
+	};
+
+	[[nodiscard]] MemoryPool& GetPool(std::uint32_t memoryTypeIndex,
+	                                  ResourceTiling tiling);
+	[[nodiscard]] vk::DeviceMemory AllocateDeviceMemory(
+		vk::DeviceSize size,
+		std::uint32_t memoryTypeIndex,
+		void** mappedData);
+	[[nodiscard]] static bool TryAllocateFromBlock(
+		MemoryBlock& block,
+		const vk::MemoryRequirements& memoryRequirements,
+		vk::DeviceSize& outOffset);
+
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+	vk::DeviceSize m_BlockSize;
+
+	mutable std::mutex m_Mutex;
+	std::array<std::array<MemoryPool, 2>, VK_MAX_MEMORY_TYPES> m_Pools{};
+	std::uint32_t m_DedicatedAllocationCount{};
+	vk::DeviceSize m_DedicatedBytes{};
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// How far the CPU runs ahead of the GPU and how often it starts a frame.
+// Fewer frames and a limit trade throughput for a lower input latency
+struct FramePacing
+{
+	// Frames recorded before the oldest one has finished on the GPU, the
+	// target's own count when 0
+	std::uint32_t FramesInFlight{ 0U };
+	// Frames per second, not limited when 0
+	std::uint32_t FrameRateLimit{ 0U };
+};
+
+// Sleeps before a frame samples its input rather than after it is submitted,
+// so the time spent waiting for the frame's turn isn't added to its latency
+class [[nodiscard]] FrameLimiter
+{
+public:
+	explicit FrameLimiter(std::uint32_t frameRate);
+
+	// Returns once the next frame is due
+	void Wait();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	Clock::duration m_Interval;
+	Clock::time_point m_NextFrame{};
+};
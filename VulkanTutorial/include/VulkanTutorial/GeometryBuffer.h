@@ -0,0 +1,95 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/UploadContext.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Where the geometry of one model lives in the shared buffers, in elements.
+// Indices are relative to FirstVertex, which is used as the vertexOffset
+struct GeometryRange
+{
+	std::uint32_t FirstVertex{};
+	std::uint32_t VertexCount{};
+	std::uint32_t FirstIndex{};
+	std::uint32_t IndexCount{};
+};
+
+// Stays valid until freed, the range behind it moves when the buffers are
+// compacted
+using GeometryHandle = std::uint32_t;
+
+// Vertices and indices of all the models, appended into one vertex and one
+// index buffer so every draw can share a single bind.
+// Growing or compacting the buffers copies the live ranges into new buffers
+// on the GPU, which waits for the device to go idle. Both are rare, they only
+// happen when models are loaded or unloaded
+class [[nodiscard]] GeometryBuffer
+{
+public:
+	constexpr static std::uint32_t DefaultVertexCapacity = 1U << 20U;
+	constexpr static std::uint32_t DefaultIndexCapacity  = 1U << 22U;
+
+	GeometryBuffer(vk::Device device,
+	               DeviceMemoryAllocator& allocator,
+	               UploadContext& uploadContext,
+	               std::uint32_t vertexCapacity = DefaultVertexCapacity,
+	               std::uint32_t indexCapacity  = DefaultIndexCapacity);
+	GeometryBuffer(const GeometryBuffer&)            = delete;
+	GeometryBuffer(GeometryBuffer&&) noexcept        = delete;
+	GeometryBuffer& operator=(const GeometryBuffer&) = delete;
+	GeometryBuffer& operator=(GeometryBuffer&&)      = delete;
+	~GeometryBuffer() noexcept;
+
+	// The returned range is uninitialized, it's up to the caller to upload it
+	[[nodiscard]] GeometryHandle Allocate(std::uint32_t vertexCount,
+	                                      std::uint32_t indexCount);
+	// The space is reclaimed by the next compaction, which happens once more
+	// than half of the buffers is unused
+	void Free(GeometryHandle handle);
+
+	[[nodiscard]] const GeometryRange& GetRange(GeometryHandle handle) const;
+	[[nodiscard]] vk::Buffer GetVertexBuffer() const noexcept
+	{
+		return m_Vertices.Buffer;
+	}
+	[[nodiscard]] vk::Buffer GetIndexBuffer() const noexcept
+	{
+		return m_Indices.Buffer;
+	}
+	void Bind(vk::CommandBuffer commandBuffer) const;
+
+private:
+	struct SharedBuffer
+	{
+		vk::Buffer Buffer;
+		DeviceAllocation Allocation;
+		std::uint32_t Capacity{};
+		// Elements appended so far, including the freed ones
+		std::uint32_t Used{};
+		std::uint32_t Live{};
+	};
+
+	[[nodiscard]] SharedBuffer CreateSharedBuffer(std::uint32_t capacity,
+	                                              vk::DeviceSize elementSize,
+	                                              vk::BufferUsageFlags usage) const;
+	void DestroySharedBuffer(SharedBuffer& sharedBuffer) noexcept;
+	// Moves all the live ranges to the front of new buffers with the given
+	// capacities
+	void Reallocate(std::uint32_t vertexCapacity, std::uint32_t indexCapacity);
+
+	vk::Device m_Device;
+	DeviceMemoryAllocator* m_Allocator;
+	UploadContext* m_UploadContext;
+
+	SharedBuffer m_Vertices;
+	SharedBuffer m_Indices;
+
+	// Indexed by handle, freed handles are reused
+	std::vector<std::optional<GeometryRange>> m_Ranges;
+	std::vector<GeometryHandle> m_FreeHandles;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+class GpuProfiler;
+
+// Queries reserved for the scopes of one command buffer. Scopes recorded with
+// an empty range are skipped, so profiling can be turned off by passing one
+struct GpuProfileRange
+{
+	GpuProfiler* Profiler{ nullptr };
+	vk::CommandBuffer CommandBuffer;
+	std::uint32_t Index{};
+};
+
+// All durations are in milliseconds
+struct GpuScopeStatistics
+{
+	std::string_view Name;
+	std::size_t SampleCount{};
+	double Minimum{};
+	double Average{};
+	double Percentile99{};
+};
+
+// Measures GPU time of named scopes with timestamp queries. Every command
+// buffer gets its own range of queries, which is only read back once its
+// owner knows the work has finished, so reading never waits for the GPU.
+// Scopes with the same name in one range are added up into a single sample
+class [[nodiscard]] GpuProfiler
+{
+public:
+	constexpr static std::uint32_t MaxRanges = 16U;
+	// Scopes begun after that are skipped, which is reported once
+	constexpr static std::uint32_t MaxScopesPerRange = 128U;
+	// Samples the statistics are taken over, per scope name
+	constexpr static std::size_t HistorySize = 256U;
+
+	GpuProfiler(vk::Device device,
+	            vk::PhysicalDevice physicalDevice,
+	            std::uint32_t queueFamilyIndex);
+	GpuProfiler(const GpuProfiler&)            = delete;
+	GpuProfiler(GpuProfiler&&) noexcept        = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(GpuProfiler&&)      = delete;
+	~GpuProfiler() noexcept;
+
+	// The queue family may not support timestamps, every range is empty then
+	[[nodiscard]] bool IsSupported() const noexcept
+	{
+		return static_cast<bool>(m_QueryPool);
+	}
+
+	// Resets the queries of a free range, has to be recorded outside of a
+	// render pass before any of its scopes. Empty when all ranges are in use
+	[[nodiscard]] GpuProfileRange BeginRange(vk::CommandBuffer commandBuffer);
+	// Only once the command buffer has finished executing, frees the range.
+	// Returns the time from the start of its first scope to the end of the
+	// last one, nothing when the range measured nothing
+	std::optional<double> ResolveRange(const GpuProfileRange& range) noexcept;
+
+	[[nodiscard]] std::vector<GpuScopeStatistics> GetStatistics() const;
+	void PrintStatistics() const;
+
+private:
+	friend class GpuProfileScope;
+
+	constexpr static std::uint32_t NoScope = MaxScopesPerRange;
+
+	struct RangeScopes
+	{
+		// Index into m_Histories for every scope begun in the range
+		std::vector<std::uint32_t> Histories;
+	};
+
+	struct ScopeHistory
+	{
+		std::string_view Name;
+		std::vector<double> Samples;
+		std::size_t NextSample{};
+	};
+
+	[[nodiscard]] std::uint32_t BeginScope(const GpuProfileRange& range,
+	                                       std::string_view name);
+	void EndScope(const GpuProfileRange& range, std::uint32_t scope) noexcept;
+	void AddSample(std::uint32_t history, double milliseconds);
+
+	vk::Device m_Device;
+	vk::QueryPool m_QueryPool;
+	double m_TimestampPeriod{};
+	std::uint64_t m_TimestampMask{};
+
+	std::array<RangeScopes, MaxRanges> m_Ranges{};
+	std::vector<std::uint32_t> m_FreeRanges;
+	// Dropped scopes are only reported once
+	bool m_ReportedFullRange{ false };
+
+	// Keys own the names the histories refer to
+	std::map<std::string, std::uint32_t, std::less<>> m_HistoryIndices;
+	std::vector<ScopeHistory> m_Histories;
+};
+
+// Measures the commands recorded during its lifetime
+class [[nodiscard]] GpuProfileScope
+{
+public:
+	GpuProfileScope(const GpuProfileRange& range, std::string_view name);
+	GpuProfileScope(const GpuProfileScope&)            = delete;
+	GpuProfileScope(GpuProfileScope&&) noexcept        = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(GpuProfileScope&&)      = delete;
+	~GpuProfileScope() noexcept;
+
+private:
+	GpuProfileRange m_Range;
+	std::uint32_t m_Scope{ GpuProfiler::NoScope };
+};
@@ -1,8 +1,16 @@
 #pragma once
 
+#include <VulkanTutorial/FramePacing.h>
+#include <VulkanTutorial/WindowTarget.h>
+
 #include <QObject>
 #include <QVulkanWindow>
 
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <optional>
+
 class [[nodiscard]] MainWindow : public QVulkanWindow
 {
 	// NOLINTBEGIN
@@ -13,4 +21,32 @@ public:
 	explicit MainWindow(QWindow* parent);
 
 	[[nodiscard]] QVulkanWindowRenderer* createRenderer() override;
+
+	// F12 writes the CPU trace recorded so far here
+	void SetTracePath(std::filesystem::path tracePath);
+	// Renderers created afterwards govern their quality to stay within it
+	void SetFrameBudget(std::optional<double> frameBudget);
+	// QVulkanWindow always presents with FIFO and picks its own number of
+	// frames, the renderer can only hold fewer of them in flight
+	void SetFramePacing(const FramePacing& pacing);
+	// Renderers created afterwards reload the shaders when their sources change
+	void SetShaderHotReload(bool hotReload);
+
+protected:
+	void keyPressEvent(QKeyEvent* event) override;
+
+private:
+	// Called by Qt while it creates the device
+	void SetDeviceFeatures(VkPhysicalDeviceFeatures2& features);
+	void AddTransferQueue(QList<VkDeviceQueueCreateInfo>& createInfos);
+
+	std::filesystem::path m_TracePath;
+	std::optional<double> m_FrameBudget;
+	FramePacing m_FramePacing{};
+	bool m_ShaderHotReload{ false };
+	// Chained into the features Qt creates the device with, when supported and
+	// Qt didn't chain the 1.3 core features
+	vk::PhysicalDeviceDynamicRenderingFeatures m_DynamicRenderingFeatures{};
+	// Qt creates the device after the renderer, which reads this afterwards
+	WindowDeviceSetup m_DeviceSetup{};
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <VulkanTutorial/Vertex.h>
+
+#include <QFile>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+
+// Memory mapped binary copy of the final vertex and index arrays of a model,
+// lets warm starts skip the assimp import and post-processing entirely.
+// Entries are keyed by the source path, its modification time, the import
+// flags and the Vertex layout, anything stale is rebuilt
+class [[nodiscard]] MeshCache
+{
+public:
+	using FillFn = std::function<void(std::span<Vertex>, std::span<std::uint32_t>)>;
+
+	// Returns nullptr when there is no valid entry for the model
+	[[nodiscard]] static std::shared_ptr<const MeshCache> Open(
+		const std::filesystem::path& modelPath,
+		std::uint32_t importFlags);
+	// Writes a new entry, filled in place through the mapping, and re-opens it.
+	// Returns nullptr if the cache can't be written
+	[[nodiscard]] static std::shared_ptr<const MeshCache> Create(
+		const std::filesystem::path& modelPath,
+		std::uint32_t importFlags,
+		std::uint32_t vertexCount,
+		std::uint32_t indexCount,
+		const FillFn& fillFn);
+
+	MeshCache(const MeshCache&)            = delete;
+	MeshCache(MeshCache&&) noexcept        = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+	MeshCache& operator=(MeshCache&&)      = delete;
+	~MeshCache() noexcept;
+
+	[[nodiscard]] std::span<const Vertex> GetVertices() const noexcept
+	{
+		return m_Vertices;
+	}
+	[[nodiscard]] std::span<const std::uint32_t> GetIndices() const noexcept
+	{
+		return m_Indices;
+	}
+
+private:
+	explicit MeshCache(const std::filesystem::path& cachePath);
+
+	QFile m_File;
+	std::span<const Vertex> m_Vertices;
+	std::span<const std::uint32_t> m_Indices;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include <vulkan/vulkan.hpp>
+
+// Generates the mip chain of an image whose level 0 has been uploaded.
+// Levels are blitted from the previous one where the format supports linear
+// blits, otherwise a compute shader downsamples them
+class [[nodiscard]] MipmapGenerator
+{
+public:
+	enum class Method
+	{
+		Blit,
+		Compute,
+	};
+
+	MipmapGenerator(vk::Device device,
+	                vk::PhysicalDevice physicalDevice,
+	                vk::ShaderModule mipShader,
+	                vk::PipelineCache pipelineCache);
+	MipmapGenerator(const MipmapGenerator&)            = delete;
+	MipmapGenerator(MipmapGenerator&&) noexcept        = delete;
+	MipmapGenerator& operator=(const MipmapGenerator&) = delete;
+	MipmapGenerator& operator=(MipmapGenerator&&)      = delete;
+	~MipmapGenerator() noexcept;
+
+	[[nodiscard]] static std::uint32_t GetMipLevelCount(
+		vk::Extent2D extent) noexcept;
+
+	// Throws when neither method supports the format
+	[[nodiscard]] Method GetMethod(vk::Format format) const;
+	// Usage and flags the image has to be created with for GetMethod(format)
+	[[nodiscard]] vk::ImageUsageFlags GetRequiredUsage(vk::Format format) const;
+	[[nodiscard]] vk::ImageCreateFlags GetRequiredFlags(vk::Format format) const;
+
+	// Expects every level in TransferDstOptimal and leaves them all in
+	// ShaderReadOnlyOptimal. The returned callback releases the per image
+	// resources and may only run once the commands have finished
+	[[nodiscard]] std::function<void()> Generate(vk::CommandBuffer commandBuffer,
+	                                             vk::Image image,
+	                                             vk::Format format,
+	                                             vk::Extent2D extent,
+	                                             std::uint32_t mipLevels);
+
+private:
+	void GenerateWithBlits(vk::CommandBuffer commandBuffer,
+	                       vk::Image image,
+	                       vk::Extent2D extent,
+	                       std::uint32_t mipLevels) const;
+	[[nodiscard]] std::function<void()> GenerateWithCompute(
+		vk::CommandBuffer commandBuffer,
+		vk::Image image,
+		vk::Format format,
+		vk::Extent2D extent,
+		std::uint32_t mipLevels);
+
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+
+	vk::Sampler m_Sampler;
+	vk::DescriptorSetLayout m_DescriptorSetLayout;
+	vk::PipelineLayout m_PipelineLayout;
+	vk::Pipeline m_Pipeline;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/GeometryBuffer.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+struct Model;
+
+// GPU driven path of the ModelManager. A compute pass frustum culls every
+// instance and writes the draw commands, so the CPU cost per frame no longer
+// depends on how many instances end up visible
+class [[nodiscard]] ModelCuller
+{
+public:
+	ModelCuller(vk::Device device,
+	            DeviceMemoryAllocator& allocator,
+	            std::uint32_t concurrentFrameCount,
+	            vk::ShaderModule cullShader,
+	            vk::PipelineCache pipelineCache);
+	ModelCuller(const ModelCuller&)            = delete;
+	ModelCuller(ModelCuller&&) noexcept        = delete;
+	ModelCuller& operator=(const ModelCuller&) = delete;
+	ModelCuller& operator=(ModelCuller&&)      = delete;
+	~ModelCuller() noexcept;
+
+	// Must be recorded outside of a render pass, uniformBuffer provides the
+	// camera and has to be the one used for drawing
+	void Cull(vk::CommandBuffer commandBuffer,
+	          std::uint32_t frameIndex,
+	          std::span<const Model* const> models,
+	          const GeometryBuffer& geometry,
+	          vk::Buffer uniformBuffer);
+	// Draws the models culled in the same frame with a single indirect draw,
+	// all of them come from the shared geometry buffers
+	void Draw(vk::CommandBuffer commandBuffer,
+	          std::uint32_t frameIndex,
+	          std::span<const Model* const> models,
+	          const GeometryBuffer& geometry) const;
+
+private:
+	struct FrameBuffer
+	{
+		vk::Buffer Buffer;
+		DeviceAllocation Allocation;
+		vk::DeviceSize Size{};
+	};
+
+	struct FrameResources
+	{
+		// Written by the host every frame
+		FrameBuffer DrawCommandTemplates;
+		FrameBuffer BoundingSpheres;
+		FrameBuffer ModelTransforms;
+		FrameBuffer Instances;
+		// Written by the cull pass
+		FrameBuffer DrawCommands;
+		FrameBuffer VisibleInstances;
+
+		vk::DescriptorSet DescriptorSet;
+	};
+
+	void Reserve(FrameBuffer& frameBuffer,
+	             vk::DeviceSize size,
+	             vk::BufferUsageFlags usage,
+	             vk::MemoryPropertyFlags memoryFlags);
+	void Destroy(FrameBuffer& frameBuffer) noexcept;
+
+	vk::Device m_Device;
+	DeviceMemoryAllocator* m_Allocator;
+
+	vk::DescriptorSetLayout m_DescriptorSetLayout;
+	vk::DescriptorPool m_DescriptorPool;
+	vk::PipelineLayout m_PipelineLayout;
+	vk::Pipeline m_Pipeline;
+
+	std::vector<FrameResources> m_Frames;
+};
@@ -1,7 +1,21 @@
 #pragma once
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/GeometryBuffer.h>
+#include <VulkanTutorial/GpuProfiler.h>
+#include <VulkanTutorial/ModelCuller.h>
+#include <VulkanTutorial/ParallelRecorder.h>
+#include <VulkanTutorial/UploadContext.h>
+#include <VulkanTutorial/Vertex.h>
+
+#include <QMatrix4x4>
+#include <QVector4D>
+
 #include <cstdint>
 #include <filesystem>
+#include <optional>
+#include <span>
 #include <string_view>
+#include <vector>
 
 #include <vulkan/vulkan.hpp>
 
@@ -15,12 +29,39 @@ struct Model
 	std::string ModelName;
 
 	std::uint32_t VertexCount{};
-	vk::Buffer VertexBuffer;
-	vk::DeviceMemory VertexBufferMemory;
-
 	std::uint32_t IndexCount{};
-	vk::Buffer IndexBuffer;
-	vk::DeviceMemory IndexBufferMemory;
+	// Shared with every other model, see GeometryBuffer
+	GeometryHandle Geometry{};
+
+	// Buffers can't be used for drawing before this has completed
+	UploadId Upload{};
+
+	// Model space, xyz is the center and w the radius
+	QVector4D BoundingSphere;
+
+	// Applied before the transform of every instance, identity by default
+	QGenericMatrix<4, 4, float> Transform;
+
+	// Drawn once per instance, with a single instanced draw
+	std::vector<InstanceData> Instances;
+};
+
+// Matches PushConstants in shader.vert, pushed once per model
+struct ModelPushConstants
+{
+	QGenericMatrix<4, 4, float> Transform;
+};
+constexpr vk::PushConstantRange ModelPushConstantRange{
+	.stageFlags = vk::ShaderStageFlagBits::eVertex,
+	.offset     = 0U,
+	.size       = sizeof(ModelPushConstants),
+};
+
+// Stays valid until the instances of the model are cleared
+struct ModelInstance
+{
+	std::size_t ModelIndex{};
+	std::size_t InstanceIndex{};
 };
 
 class [[nodiscard]] ModelManager
@@ -34,20 +75,85 @@ public:
 	~ModelManager() noexcept;
 
 	void SetResouces(vk::Device device,
-	                 vk::PhysicalDevice physicalDevice,
-	                 vk::CommandPool commandPool,
-	                 vk::Queue workQueue);
+	                 DeviceMemoryAllocator& allocator,
+	                 UploadContext& uploadContext,
+	                 std::uint32_t concurrentFrameCount);
 
 	void LoadModel(std::string_view modelName,
 	               const std::filesystem::path& modelPath);
-	void RenderAllModels(vk::CommandBuffer commandBuffer) const;
+	// Invalidates the ModelInstance handles of the models loaded after it
+	void UnloadModel(std::string_view modelName);
+	// A loaded model isn't drawn until it has at least one instance
+	ModelInstance AddInstance(std::string_view modelName,
+	                          const QMatrix4x4& transform);
+	void SetInstanceTransform(ModelInstance instance, const QMatrix4x4& transform);
+	void SetModelTransform(std::string_view modelName, const QMatrix4x4& transform);
+	void ClearInstances(std::string_view modelName);
+
+	// Switches to frustum culling and filling the draw commands on the GPU,
+	// CullAllModels has to be recorded before every RenderAllModels from then on
+	void EnableGpuCulling(vk::ShaderModule cullShader,
+	                      vk::PipelineCache pipelineCache);
+	void CullAllModels(vk::CommandBuffer commandBuffer,
+	                   std::uint32_t frameIndex,
+	                   vk::Buffer uniformBuffer,
+	                   const GpuProfileRange& profileRange = {});
+
+	// Instance data is written into the instance buffer of the given frame, it
+	// must not be in use by the GPU anymore. Model transforms are pushed with
+	// the ModelPushConstantRange of pipelineLayout. Every model's draw is timed
+	// separately unless they are drawn indirectly
+	void RenderAllModels(vk::CommandBuffer commandBuffer,
+	                     std::uint32_t frameIndex,
+	                     vk::PipelineLayout pipelineLayout,
+	                     const GpuProfileRange& profileRange = {});
+	// Same as RenderAllModels without GPU culling, but the models are split
+	// across the threads of the recorder. Secondary command buffers inherit no
+	// state, bindStateFn is recorded first into each of them to set it
+	[[nodiscard]] std::vector<vk::CommandBuffer> RecordAllModels(
+		ParallelRecorder& recorder,
+		std::uint32_t frameIndex,
+		const vk::CommandBufferInheritanceInfo& inheritance,
+		vk::PipelineLayout pipelineLayout,
+		const ParallelRecorder::RecordFn& bindStateFn);
 	void UnloadAllModels();
 
 private:
+	struct InstanceBuffer
+	{
+		vk::Buffer Buffer;
+		DeviceAllocation Allocation;
+		std::size_t Capacity{};
+	};
+
+	[[nodiscard]] Model& FindModel(std::string_view modelName);
+	[[nodiscard]] std::vector<const Model*> GetDrawableModels() const;
+	void ReserveInstances(InstanceBuffer& instanceBuffer,
+	                      std::size_t instanceCount);
+	// Instance buffer of the frame with room for all the models, empty if they
+	// have no instances
+	[[nodiscard]] std::span<InstanceData> MapInstances(
+		std::uint32_t frameIndex,
+		std::span<const Model* const> models);
+	// Safe to call from several threads at once for different models
+	void DrawModels(vk::CommandBuffer commandBuffer,
+	                std::uint32_t frameIndex,
+	                vk::PipelineLayout pipelineLayout,
+	                std::span<const Model* const> models,
+	                std::span<InstanceData> instanceData,
+	                std::uint32_t firstInstance,
+	                const GpuProfileRange& profileRange) const;
+
 	vk::Device m_Device;
-	vk::PhysicalDevice m_PhysicalDevice;
-	vk::CommandPool m_CommandPool;
-	vk::Queue m_WorkQueue;
+	DeviceMemoryAllocator* m_Allocator{ nullptr };
+	UploadContext* m_UploadContext{ nullptr };
 
+	std::optional<GeometryBuffer> m_Geometry;
 	std::vector<Model> m_LoadedModels;
+	std::vector<InstanceBuffer> m_InstanceBuffers;
+	std::uint32_t m_ConcurrentFrameCount{};
+
+	std::optional<ModelCuller> m_Culler;
+	// Models culled for each frame, drawn in the same order
+	std::vector<std::vector<const Model*>> m_CulledModels;
 };
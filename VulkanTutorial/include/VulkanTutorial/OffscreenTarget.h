@@ -0,0 +1,103 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/RenderTarget.h>
+
+#include <QImage>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+class VulkanInstance;
+
+// Renders into images of its own, with its own command buffers and fences, so
+// frames are driven by a plain loop of BeginFrame and the renderer. Needs no
+// surface or display and runs on software drivers such as lavapipe
+class [[nodiscard]] OffscreenTarget final : public RenderTarget
+{
+public:
+	constexpr static std::uint32_t DefaultFrameCount = 2U;
+	constexpr static std::uint32_t MaxFrameCount     = 3U;
+	constexpr static vk::Format ColorFormat          = vk::Format::eR8G8B8A8Unorm;
+
+	// The device of the instance has to be initialized already. Throws for
+	// more than MaxFrameCount frames in flight
+	OffscreenTarget(const VulkanInstance& instance,
+	                vk::Extent2D extent,
+	                std::uint32_t frameCount = DefaultFrameCount);
+	OffscreenTarget(const OffscreenTarget&)                = delete;
+	OffscreenTarget(OffscreenTarget&&) noexcept            = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&)     = delete;
+	OffscreenTarget& operator=(OffscreenTarget&&) noexcept = delete;
+	~OffscreenTarget() noexcept final;
+
+	// Waits until the previous submission of the frame has finished, then
+	// starts recording its command buffer
+	void BeginFrame();
+	void WaitIdle() const;
+	// Reads back the last submitted image, waits for it to be rendered
+	[[nodiscard]] QImage Capture();
+
+	[[nodiscard]] vk::Device GetDevice() const final;
+	[[nodiscard]] vk::PhysicalDevice GetPhysicalDevice() const final;
+	[[nodiscard]] vk::Queue GetGraphicsQueue() const final;
+	[[nodiscard]] std::uint32_t GetGraphicsQueueFamily() const final;
+	[[nodiscard]] std::uint32_t GetConcurrentFrameCount() const final;
+	[[nodiscard]] vk::Format GetColorFormat() const final;
+	[[nodiscard]] vk::ImageLayout GetFinalLayout() const final;
+	[[nodiscard]] bool IsDynamicRenderingEnabled() const final;
+	[[nodiscard]] vk::Queue GetTransferQueue() const final;
+	[[nodiscard]] std::uint32_t GetTransferQueueFamily() const final;
+
+	[[nodiscard]] vk::Extent2D GetExtent() const final;
+	[[nodiscard]] std::uint32_t GetImageCount() const final;
+	[[nodiscard]] vk::ImageView GetColorView(std::uint32_t idx) const final;
+	[[nodiscard]] vk::Image GetColorImage(std::uint32_t idx) const final;
+
+	[[nodiscard]] std::uint32_t GetCurrentFrame() const final;
+	[[nodiscard]] std::uint32_t GetCurrentImage() const final;
+	[[nodiscard]] vk::CommandBuffer GetCurrentCommandBuffer() const final;
+	// Submits the frame without waiting for it
+	void FrameReady() final;
+
+private:
+	struct Attachment
+	{
+		vk::Image Image;
+		DeviceAllocation Allocation;
+		vk::ImageView View;
+	};
+
+	// Every frame renders into its own image, so they can be in flight together
+	struct Frame
+	{
+		Attachment Color;
+		vk::CommandBuffer CommandBuffer;
+		vk::Fence Fence;
+	};
+
+	[[nodiscard]] Attachment CreateAttachment(vk::Format format,
+	                                          vk::SampleCountFlagBits samples,
+	                                          vk::ImageUsageFlags usage,
+	                                          vk::ImageAspectFlags aspect);
+	void DestroyAttachment(const Attachment& attachment) noexcept;
+
+	vk::Device m_Device;
+	vk::PhysicalDevice m_PhysicalDevice;
+	vk::Queue m_Queue;
+	std::uint32_t m_QueueFamily;
+	vk::Queue m_TransferQueue;
+	std::uint32_t m_TransferQueueFamily;
+	bool m_DynamicRendering;
+	vk::Extent2D m_Extent;
+
+	DeviceMemoryAllocator m_Allocator;
+	vk::CommandPool m_CommandPool;
+	std::vector<Frame> m_Frames;
+
+	std::uint32_t m_CurrentFrame{ 0U };
+	std::optional<std::uint32_t> m_LastSubmittedFrame;
+};
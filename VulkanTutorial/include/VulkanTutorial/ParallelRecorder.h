@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Records secondary command buffers on a pool of worker threads. Every worker
+// allocates from command pools of its own, one per frame, which are reset when
+// the frame is recorded again
+class [[nodiscard]] ParallelRecorder
+{
+public:
+	using RecordFn = std::function<void(vk::CommandBuffer)>;
+
+	ParallelRecorder(vk::Device device,
+	                 std::uint32_t queueFamilyIndex,
+	                 std::uint32_t concurrentFrameCount,
+	                 std::uint32_t threadCount);
+	ParallelRecorder(const ParallelRecorder&)            = delete;
+	ParallelRecorder(ParallelRecorder&&) noexcept        = delete;
+	ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+	ParallelRecorder& operator=(ParallelRecorder&&)      = delete;
+	// None of the command buffers may be in use by the GPU anymore
+	~ParallelRecorder() noexcept;
+
+	[[nodiscard]] std::uint32_t GetThreadCount() const noexcept
+	{
+		return static_cast<std::uint32_t>(m_Workers.size());
+	}
+
+	// Records every job into a secondary command buffer of its own, continuing
+	// the render pass of inheritance, and blocks until all of them are done.
+	// Only once per frame, after the previous use of the frame has finished
+	[[nodiscard]] std::vector<vk::CommandBuffer> Record(
+		std::uint32_t frameIndex,
+		const vk::CommandBufferInheritanceInfo& inheritance,
+		std::span<const RecordFn> jobs);
+
+private:
+	struct ThreadFrame
+	{
+		vk::CommandPool CommandPool;
+		// Reused after the pool is reset
+		std::vector<vk::CommandBuffer> CommandBuffers;
+		std::size_t UsedCount{};
+	};
+
+	struct Batch
+	{
+		std::uint32_t FrameIndex{};
+		const vk::CommandBufferInheritanceInfo* Inheritance{ nullptr };
+		std::span<const RecordFn> Jobs;
+		std::span<vk::CommandBuffer> CommandBuffers;
+	};
+
+	void RunWorker(const std::stop_token& stopToken, std::uint32_t workerIndex);
+	void RecordJobs(std::uint32_t workerIndex);
+	[[nodiscard]] vk::CommandBuffer Allocate(ThreadFrame& threadFrame);
+
+	vk::Device m_Device;
+	// Indexed by worker, then by frame
+	std::vector<std::vector<ThreadFrame>> m_ThreadFrames;
+
+	std::mutex m_Mutex;
+	std::condition_variable_any m_BatchStarted;
+	std::condition_variable m_BatchFinished;
+	// Bumped for every batch, the workers wait for it to change
+	std::uint64_t m_Generation{ 0U };
+	Batch m_Batch{};
+	std::uint32_t m_BusyWorkers{ 0U };
+	std::exception_ptr m_Error{};
+
+	// Last, so the workers are stopped before anything they use is destroyed
+	std::vector<std::jthread> m_Workers;
+};
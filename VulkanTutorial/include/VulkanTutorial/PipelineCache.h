@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+
+#include <vulkan/vulkan.hpp>
+
+// vk::PipelineCache persisted between runs, so pipelines compiled by a
+// previous launch don't have to be compiled again.
+// The file is only used when it was written for the same device and driver,
+// drivers don't reliably reject cache data made by something else
+class [[nodiscard]] PipelineCache
+{
+public:
+	PipelineCache(vk::Device device,
+	              vk::PhysicalDevice physicalDevice,
+	              std::filesystem::path cachePath);
+	PipelineCache(const PipelineCache&)            = delete;
+	PipelineCache(PipelineCache&&) noexcept        = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+	PipelineCache& operator=(PipelineCache&&)      = delete;
+	// Saves the cache before destroying it
+	~PipelineCache() noexcept;
+
+	[[nodiscard]] vk::PipelineCache Get() const noexcept
+	{
+		return m_PipelineCache;
+	}
+	// Replaces the file atomically, a crash never leaves a partial cache behind
+	void Save() const;
+
+private:
+	vk::Device m_Device;
+	vk::PhysicalDeviceProperties m_DeviceProperties;
+	std::filesystem::path m_CachePath;
+	vk::PipelineCache m_PipelineCache;
+};
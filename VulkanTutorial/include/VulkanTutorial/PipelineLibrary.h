@@ -0,0 +1,118 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Everything a graphics pipeline variant is built from, equal states share one
+// pipeline. Viewport and scissor are always dynamic, and there is a single
+// color attachment
+struct GraphicsPipelineState
+{
+	// SPIR-V files, read whenever the pipeline is built
+	std::filesystem::path VertexShader;
+	std::filesystem::path FragmentShader;
+	std::vector<vk::VertexInputBindingDescription> VertexBindings;
+	std::vector<vk::VertexInputAttributeDescription> VertexAttributes;
+	vk::SampleCountFlagBits Samples{ vk::SampleCountFlagBits::e1 };
+	vk::CullModeFlags CullMode{};
+	vk::FrontFace FrontFace{ vk::FrontFace::eCounterClockwise };
+	bool DepthTest{ true };
+	bool DepthWrite{ true };
+	vk::CompareOp DepthCompareOp{ vk::CompareOp::eLess };
+	vk::PipelineColorBlendAttachmentState Blend{
+		.blendEnable    = vk::False,
+		.colorWriteMask = vk::ColorComponentFlagBits::eR |
+		                  vk::ColorComponentFlagBits::eG |
+		                  vk::ColorComponentFlagBits::eB |
+		                  vk::ColorComponentFlagBits::eA,
+	};
+	// Values of constant_id 0, 1, ... in both stages
+	std::vector<std::uint32_t> SpecializationConstants;
+	vk::PipelineLayout Layout;
+	// Without one, rendered with dynamic rendering into these formats
+	vk::RenderPass RenderPass;
+	vk::Format ColorFormat{};
+	vk::Format DepthStencilFormat{};
+
+	[[nodiscard]] bool operator==(const GraphicsPipelineState&) const = default;
+};
+
+struct GraphicsPipelineStateHash
+{
+	[[nodiscard]] std::size_t operator()(
+		const GraphicsPipelineState& state) const noexcept;
+};
+
+// Owns every pipeline variant the renderer may switch between. Requested
+// variants are compiled on a pool of worker threads while the caller carries
+// on, so compiling many of them at startup takes about as long as the slowest
+// one. Requesting a state again returns the same variant
+class [[nodiscard]] PipelineLibrary
+{
+public:
+	// Index of a variant, valid as long as the library
+	using VariantId = std::size_t;
+
+	PipelineLibrary(vk::Device device,
+	                vk::PipelineCache pipelineCache,
+	                std::uint32_t threadCount = GetDefaultThreadCount());
+	PipelineLibrary(const PipelineLibrary&)            = delete;
+	PipelineLibrary(PipelineLibrary&&) noexcept        = delete;
+	PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+	PipelineLibrary& operator=(PipelineLibrary&&)      = delete;
+	// Waits for the compiling variants and destroys all of them
+	~PipelineLibrary() noexcept;
+
+	// Never blocks, compilation starts on the workers
+	[[nodiscard]] VariantId Request(const GraphicsPipelineState& state);
+	// Blocks until the variant is compiled, rethrows when that failed
+	[[nodiscard]] vk::Pipeline Get(VariantId id);
+	[[nodiscard]] GraphicsPipelineState GetState(VariantId id) const;
+	// Takes ownership of a pipeline built from the variant's state, such as a
+	// reloaded one. The previous pipeline is returned to be destroyed once no
+	// frame uses it
+	[[nodiscard]] vk::Pipeline Replace(VariantId id, vk::Pipeline pipeline);
+
+	// Creates a pipeline the caller owns, from any thread
+	[[nodiscard]] vk::Pipeline Build(const GraphicsPipelineState& state) const;
+
+	// One thread is left for the render thread
+	[[nodiscard]] static std::uint32_t GetDefaultThreadCount() noexcept;
+
+private:
+	struct Variant
+	{
+		GraphicsPipelineState State;
+		vk::Pipeline Pipeline;
+		bool Compiled{ false };
+		// Set instead of Pipeline when compiling failed
+		std::exception_ptr Error{};
+	};
+
+	void RunWorker(const std::stop_token& stopToken);
+
+	vk::Device m_Device;
+	vk::PipelineCache m_PipelineCache;
+
+	mutable std::mutex m_Mutex;
+	std::condition_variable_any m_VariantsRequested;
+	std::condition_variable m_VariantCompiled;
+	std::deque<Variant> m_Variants;
+	std::unordered_map<GraphicsPipelineState, VariantId, GraphicsPipelineStateHash>
+		m_VariantIds;
+	std::deque<VariantId> m_Pending;
+
+	// Last, so the workers are stopped before anything they use is destroyed
+	std::vector<std::jthread> m_Workers;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+struct QualityLevel
+{
+	vk::SampleCountFlagBits Samples{ vk::SampleCountFlagBits::e1 };
+	// Of the target's size in both directions
+	float ResolutionScale{ 1.F };
+};
+
+// Holds the frame time within a budget by stepping through quality levels,
+// first dropping MSAA samples and then resolution, and back up in reverse.
+// Decisions are made over whole windows of frames, and there is a gap
+// between the times that lower and raise the quality, so it settles instead
+// of oscillating between two levels. All times are in milliseconds
+class [[nodiscard]] QualityGovernor
+{
+public:
+	// Frames a decision is made over, also longer than any change takes to show
+	// up in the GPU timings
+	constexpr static std::uint32_t WindowSize = 30U;
+	// Quality drops above the budget times this, and only when GPU bound
+	constexpr static double DowngradeThreshold = 0.95;
+	// Quality is raised below the budget times this...
+	constexpr static double UpgradeThreshold = 0.7;
+	// ...once that many windows in a row were below it
+	constexpr static std::uint32_t UpgradeWindows = 3U;
+
+	// Starts at the highest level
+	QualityGovernor(double frameBudget, vk::SampleCountFlagBits maxSamples);
+
+	// Returns whether the level changed
+	bool AddFrame(double cpuTime, double gpuTime);
+
+	[[nodiscard]] const QualityLevel& GetLevel() const noexcept
+	{
+		return m_Levels.at(m_Level);
+	}
+	// Every level it may pick, from the highest quality to the lowest
+	[[nodiscard]] const std::vector<QualityLevel>& GetLevels() const noexcept
+	{
+		return m_Levels;
+	}
+
+private:
+	double m_FrameBudget;
+	// From the highest quality to the lowest
+	std::vector<QualityLevel> m_Levels;
+	std::size_t m_Level{ 0U };
+
+	std::uint32_t m_WindowFrames{ 0U };
+	double m_WindowCpuTime{ 0.0 };
+	double m_WindowGpuTime{ 0.0 };
+	std::uint32_t m_FastWindows{ 0U };
+};
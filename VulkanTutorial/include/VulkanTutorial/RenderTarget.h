@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+
+// Everything the renderer needs from what it draws into, either the swapchain
+// of a window or images rendered offscreen. The multisampled and depth stencil
+// attachments belong to the renderer, targets only have the final images
+class [[nodiscard]] RenderTarget
+{
+public:
+	RenderTarget()                                   = default;
+	RenderTarget(const RenderTarget&)                = delete;
+	RenderTarget(RenderTarget&&) noexcept            = delete;
+	RenderTarget& operator=(const RenderTarget&)     = delete;
+	RenderTarget& operator=(RenderTarget&&) noexcept = delete;
+	virtual ~RenderTarget() noexcept                 = default;
+
+	[[nodiscard]] virtual vk::Device GetDevice() const                  = 0;
+	[[nodiscard]] virtual vk::PhysicalDevice GetPhysicalDevice() const  = 0;
+	[[nodiscard]] virtual vk::Queue GetGraphicsQueue() const            = 0;
+	[[nodiscard]] virtual std::uint32_t GetGraphicsQueueFamily() const  = 0;
+	[[nodiscard]] virtual std::uint32_t GetConcurrentFrameCount() const = 0;
+	[[nodiscard]] virtual vk::Format GetColorFormat() const             = 0;
+	// Layout the resolved image is left in by the render pass
+	[[nodiscard]] virtual vk::ImageLayout GetFinalLayout() const = 0;
+	// Whether the device was created with VK_KHR_dynamic_rendering
+	[[nodiscard]] virtual bool IsDynamicRenderingEnabled() const = 0;
+	// Same as the graphics queue when the device has no transfer only family
+	[[nodiscard]] virtual vk::Queue GetTransferQueue() const           = 0;
+	[[nodiscard]] virtual std::uint32_t GetTransferQueueFamily() const = 0;
+
+	[[nodiscard]] virtual vk::Extent2D GetExtent() const                      = 0;
+	[[nodiscard]] virtual std::uint32_t GetImageCount() const                 = 0;
+	[[nodiscard]] virtual vk::ImageView GetColorView(std::uint32_t idx) const = 0;
+	// Only needed for the layout transitions of dynamic rendering
+	[[nodiscard]] virtual vk::Image GetColorImage(std::uint32_t idx) const = 0;
+
+	// Only valid while a frame is being recorded
+	[[nodiscard]] virtual std::uint32_t GetCurrentFrame() const             = 0;
+	[[nodiscard]] virtual std::uint32_t GetCurrentImage() const             = 0;
+	[[nodiscard]] virtual vk::CommandBuffer GetCurrentCommandBuffer() const = 0;
+	// The current command buffer is recorded and can be submitted
+	virtual void FrameReady() = 0;
+};
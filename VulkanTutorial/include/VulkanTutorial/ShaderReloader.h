@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Development mode for shaders: watches their GLSL sources, compiles the
+// changed ones to SPIR-V with glslc and rebuilds the pipelines using them, all
+// on a worker thread. Rebuilt pipelines are only handed out by TakeReloaded,
+// so they are swapped in between frames without the renderer stalling.
+// Needs a build with VULKAN_TUTORIAL_SHADER_HOT_RELOAD, which knows where the
+// sources and glslc are
+class [[nodiscard]] ShaderReloader
+{
+public:
+	// Creates the pipeline from the SPIR-V files as they are now, called on the
+	// worker thread. Throws on failure, the previous pipeline stays in use then
+	using BuildFn = std::function<vk::Pipeline()>;
+
+	struct Reloaded
+	{
+		std::string Name;
+		vk::Pipeline Pipeline;
+	};
+
+	constexpr static std::chrono::milliseconds PollInterval{ 250 };
+
+	// The SPIR-V files are replaced in outputDirectory, where they are loaded
+	// from. Throws when built without VULKAN_TUTORIAL_SHADER_HOT_RELOAD
+	ShaderReloader(vk::Device device, std::filesystem::path outputDirectory);
+	ShaderReloader(const ShaderReloader&)            = delete;
+	ShaderReloader(ShaderReloader&&) noexcept        = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(ShaderReloader&&)      = delete;
+	// Stops the worker and destroys the pipelines that were never taken
+	~ShaderReloader() noexcept;
+
+	// Rebuilds the pipeline whenever one of the shaders, file names like
+	// "shader.frag", has been compiled again
+	void Watch(std::string name, std::vector<std::string> shaders, BuildFn build);
+
+	// Pipelines rebuilt since the last call, the caller owns them now
+	[[nodiscard]] std::vector<Reloaded> TakeReloaded();
+
+private:
+	struct WatchedPipeline
+	{
+		std::string Name;
+		std::vector<std::string> Shaders;
+		BuildFn Build;
+	};
+
+	void Run(const std::stop_token& stopToken);
+	// Returns the shaders that were compiled successfully
+	[[nodiscard]] std::vector<std::string> CompileChanged();
+	[[nodiscard]] bool Compile(const std::string& shader) const;
+	void Rebuild(const std::vector<std::string>& compiledShaders);
+
+	vk::Device m_Device;
+	std::filesystem::path m_SourceDirectory;
+	std::filesystem::path m_OutputDirectory;
+
+	std::mutex m_Mutex;
+	std::condition_variable_any m_StopRequested;
+	std::vector<WatchedPipeline> m_Watched;
+	// Last seen modification time of every watched source
+	std::map<std::string, std::filesystem::file_time_type> m_SourceTimes;
+	std::vector<Reloaded> m_Reloaded;
+
+	// Last, so it stops before anything it uses is destroyed
+	std::jthread m_Worker;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+
+#include <vulkan/vulkan.hpp>
+
+struct StagingRegion
+{
+	vk::Buffer Buffer;
+	vk::DeviceSize Offset{};
+	std::span<std::byte> Data;
+};
+
+// Fixed size, persistently mapped host visible buffer handed out front to back.
+// Space is reclaimed in the order it was fenced, once the GPU is done with it
+class [[nodiscard]] StagingRing
+{
+public:
+	constexpr static vk::DeviceSize DefaultSize =
+		vk::DeviceSize{ 32U } * 1024U * 1024U;
+
+	StagingRing(vk::Device device,
+	            DeviceMemoryAllocator& allocator,
+	            vk::DeviceSize size = DefaultSize);
+	StagingRing(const StagingRing&)            = delete;
+	StagingRing(StagingRing&&) noexcept        = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+	StagingRing& operator=(StagingRing&&)      = delete;
+	~StagingRing() noexcept;
+
+	[[nodiscard]] std::optional<StagingRegion> TryAllocate(
+		vk::DeviceSize size,
+		vk::DeviceSize alignment);
+	// Biggest region TryAllocate would currently succeed with
+	[[nodiscard]] vk::DeviceSize GetLargestFreeRegion(
+		vk::DeviceSize alignment) const;
+
+	// Everything allocated since the previous call is in use until fenceValue
+	// gets passed to Release
+	void Fence(std::uint64_t fenceValue);
+	void Release(std::uint64_t completedFenceValue);
+
+	[[nodiscard]] constexpr vk::DeviceSize GetSize() const noexcept
+	{
+		return m_Size;
+	}
+
+private:
+	struct FencedRange
+	{
+		std::uint64_t FenceValue{};
+		vk::DeviceSize End{};
+		vk::DeviceSize Bytes{};
+	};
+
+	vk::Device m_Device;
+	DeviceMemoryAllocator* m_Allocator;
+	vk::DeviceSize m_Size;
+
+	vk::Buffer m_Buffer;
+	DeviceAllocation m_Allocation;
+
+	vk::DeviceSize m_Head{};
+	vk::DeviceSize m_Tail{};
+	// Includes alignment padding and space skipped when wrapping around
+	vk::DeviceSize m_UsedBytes{};
+	vk::DeviceSize m_UnfencedBytes{};
+	std::deque<FencedRange> m_FencedRanges;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Texel data of a 2D texture as it is uploaded, either uncompressed texels
+// or the blocks of a block-compressed format
+struct TextureData
+{
+	vk::Format Format{};
+	vk::Extent2D Extent;
+	vk::Extent2D BlockExtent{ .width = 1U, .height = 1U };
+	std::uint32_t BlockSize{};
+	std::uint32_t LevelCount{ 1U };
+	// Levels are tightly packed, starting with level 0
+	std::vector<std::byte> Data{};
+
+	[[nodiscard]] bool IsBlockCompressed() const noexcept
+	{
+		return BlockExtent.width > 1U || BlockExtent.height > 1U;
+	}
+	[[nodiscard]] vk::DeviceSize GetLevelSize(std::uint32_t level) const noexcept;
+	[[nodiscard]] std::span<const std::byte> GetLevel(std::uint32_t level) const;
+};
+
+// Decodes an image file with Qt into a single RGBA8 level
+[[nodiscard]] TextureData LoadImageFile(const std::filesystem::path& path,
+                                        bool srgb);
+
+// Only uncompressed RGBA8 and the BC1 and BC7 formats are supported,
+// supercompressed files are rejected
+[[nodiscard]] TextureData LoadKtx2(const std::filesystem::path& path);
+// Replaces the file atomically, only block-compressed textures can be saved
+void SaveKtx2(const std::filesystem::path& path, const TextureData& texture);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <VulkanTutorial/Texture.h>
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Loads textures in the smallest format the device can sample.
+// KTX2 files are used as they are. Other images are compressed to BC1 on a
+// worker thread the first time they are seen, the result is written next to
+// the source and used instead of it from then on. Load may be called from
+// several threads at once
+class [[nodiscard]] TextureCache
+{
+public:
+	explicit TextureCache(vk::PhysicalDevice physicalDevice);
+	TextureCache(const TextureCache&)            = delete;
+	TextureCache(TextureCache&&) noexcept        = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+	TextureCache& operator=(TextureCache&&)      = delete;
+	// Waits for the encoders still running
+	~TextureCache() noexcept;
+
+	// Returns the uncompressed image while its compressed version isn't ready
+	[[nodiscard]] std::shared_ptr<const TextureData> Load(
+		const std::filesystem::path& path,
+		bool srgb);
+
+	[[nodiscard]] static std::filesystem::path GetCachePath(
+		const std::filesystem::path& path);
+
+private:
+	[[nodiscard]] bool IsSupported(vk::Format format) const;
+
+	vk::PhysicalDevice m_PhysicalDevice;
+	std::mutex m_EncodersMutex;
+	std::vector<std::future<void>> m_Encoders;
+};
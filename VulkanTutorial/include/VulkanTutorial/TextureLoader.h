@@ -0,0 +1,77 @@
+#pragma once
+
+#include <VulkanTutorial/CompletionQueue.h>
+#include <VulkanTutorial/Texture.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+class TextureCache;
+
+struct LoadedTexture
+{
+	std::filesystem::path Path;
+	std::shared_ptr<const TextureData> Texture{};
+	// Set instead of Texture when loading failed
+	std::exception_ptr Error{};
+};
+
+// Decodes textures on a pool of worker threads. Requests and results are
+// owned by a single thread, typically the render thread, which picks up the
+// finished textures without ever blocking the workers
+class [[nodiscard]] TextureLoader
+{
+public:
+	explicit TextureLoader(TextureCache& cache,
+	                       std::uint32_t threadCount = GetDefaultThreadCount());
+	TextureLoader(const TextureLoader&)            = delete;
+	TextureLoader(TextureLoader&&) noexcept        = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+	TextureLoader& operator=(TextureLoader&&)      = delete;
+	// Drops the requests no worker has started yet
+	~TextureLoader() noexcept;
+
+	void Load(std::filesystem::path path, bool srgb);
+	// Requested but not yet returned by TakeCompleted or WaitForCompleted
+	[[nodiscard]] std::size_t GetPendingCount() const noexcept
+	{
+		return m_PendingCount;
+	}
+
+	// Never blocks
+	[[nodiscard]] std::vector<LoadedTexture> TakeCompleted();
+	// Blocks until at least one texture is done, unless nothing is pending
+	[[nodiscard]] std::vector<LoadedTexture> WaitForCompleted();
+
+	// One thread is left for the render thread
+	[[nodiscard]] static std::uint32_t GetDefaultThreadCount() noexcept;
+
+private:
+	struct Request
+	{
+		std::filesystem::path Path;
+		bool Srgb{};
+	};
+
+	void RunWorker(const std::stop_token& stopToken);
+
+	TextureCache* m_Cache;
+
+	std::mutex m_RequestsMutex;
+	std::condition_variable_any m_RequestsAdded;
+	std::deque<Request> m_Requests;
+
+	CompletionQueue<LoadedTexture> m_Completed;
+	std::size_t m_PendingCount{ 0U };
+
+	// Last, so the workers are stopped before anything they use is destroyed
+	std::vector<std::jthread> m_Workers;
+};
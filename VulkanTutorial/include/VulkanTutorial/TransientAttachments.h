@@ -0,0 +1,73 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// The renderer's multisampled color and depth stencil attachments. Their
+// contents are never stored, so they are transient attachments in lazily
+// allocated memory where the device has it, which tilers never back with
+// actual memory
+class [[nodiscard]] TransientAttachments
+{
+public:
+	// One multisampled color image per target image, none without
+	// multisampling. The depth stencil image is shared by all of them
+	TransientAttachments(vk::Device device,
+	                     vk::PhysicalDevice physicalDevice,
+	                     DeviceMemoryAllocator& allocator,
+	                     vk::Extent2D extent,
+	                     std::uint32_t imageCount,
+	                     vk::Format colorFormat,
+	                     vk::Format depthStencilFormat,
+	                     vk::SampleCountFlagBits samples);
+	TransientAttachments(const TransientAttachments&)            = delete;
+	TransientAttachments(TransientAttachments&&) noexcept        = delete;
+	TransientAttachments& operator=(const TransientAttachments&) = delete;
+	TransientAttachments& operator=(TransientAttachments&&)      = delete;
+	// None of the images may be in use by the GPU anymore
+	~TransientAttachments() noexcept;
+
+	[[nodiscard]] vk::ImageView GetColorView(std::uint32_t idx) const
+	{
+		return m_Color.at(idx).View;
+	}
+	[[nodiscard]] vk::Image GetColorImage(std::uint32_t idx) const
+	{
+		return m_Color.at(idx).Image;
+	}
+	[[nodiscard]] vk::ImageView GetDepthStencilView() const noexcept
+	{
+		return m_DepthStencil.View;
+	}
+	[[nodiscard]] vk::Image GetDepthStencilImage() const noexcept
+	{
+		return m_DepthStencil.Image;
+	}
+
+private:
+	struct Attachment
+	{
+		vk::Image Image;
+		DeviceAllocation Allocation;
+		vk::ImageView View;
+	};
+
+	[[nodiscard]] Attachment CreateAttachment(vk::Format format,
+	                                          vk::ImageUsageFlags usage,
+	                                          vk::ImageAspectFlags aspect);
+	void DestroyAttachment(const Attachment& attachment) noexcept;
+
+	vk::Device m_Device;
+	DeviceMemoryAllocator* m_Allocator;
+	vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+	vk::Extent2D m_Extent;
+	vk::SampleCountFlagBits m_Samples;
+
+	std::vector<Attachment> m_Color;
+	Attachment m_DepthStencil;
+	std::uint32_t m_LazilyAllocatedCount{ 0U };
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/GpuProfiler.h>
+#include <VulkanTutorial/StagingRing.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+class MipmapGenerator;
+
+// Monotonic id of a submitted batch, completion is reported in order
+using UploadTicket = std::uint64_t;
+// Monotonic id of a single buffer or image upload, which may be spread over
+// several batches when it doesn't fit in the staging ring at once
+using UploadId = std::uint64_t;
+
+// Fills destination with the source bytes starting at sourceOffset, called
+// once per chunk so it has to own (or keep alive) whatever it reads from
+using UploadWriter = std::function<void(std::span<std::byte> destination,
+                                        vk::DeviceSize sourceOffset)>;
+
+struct BufferUploadInfo
+{
+	vk::Buffer DstBuffer;
+	vk::DeviceSize DstOffset{};
+	vk::DeviceSize Size{};
+	// Chunks are only split at multiples of this, lets writers work per element
+	vk::DeviceSize Granularity{ 1U };
+
+	vk::PipelineStageFlags DstStage;
+	vk::AccessFlags DstAccess;
+};
+
+struct ImageUploadInfo
+{
+	vk::Image DstImage;
+	vk::Format Format{};
+	vk::Extent2D Extent;
+	// Size of a texel block, which is a single texel for uncompressed formats.
+	// Source rows of blocks are tightly packed, chunks always contain whole rows
+	std::uint32_t TexelSize{};
+	vk::Extent2D BlockExtent{ .width = 1U, .height = 1U };
+	// Levels provided by the writer, packed one after the other from level 0.
+	// When there are fewer than MipLevels the rest are generated from level 0
+	std::uint32_t SourceLevels{ 1U };
+	std::uint32_t MipLevels{ 1U };
+	// Has to outlive the upload when MipLevels > SourceLevels
+	MipmapGenerator* Mipmaps{ nullptr };
+};
+
+// Records copies and barriers of many uploads into one command buffer and
+// submits them together, completion is tracked with a fence per batch instead
+// of waiting for the whole queue to go idle.
+// Source data goes through a persistently mapped StagingRing, uploads that
+// don't fit are split into chunks and continued in the following batches.
+// Buffer copies run on the transfer queue when it has its own family and are
+// handed over to the graphics queue with queue family ownership transfers.
+// Images stay on the graphics queue, their mipmaps are generated there
+class [[nodiscard]] UploadContext
+{
+public:
+	// Pass the graphics queue as the transfer queue to do everything on it
+	UploadContext(vk::Device device,
+	              vk::Queue queue,
+	              std::uint32_t queueFamilyIndex,
+	              vk::Queue transferQueue,
+	              std::uint32_t transferQueueFamily,
+	              DeviceMemoryAllocator& allocator,
+	              GpuProfiler* profiler      = nullptr,
+	              vk::DeviceSize stagingSize = StagingRing::DefaultSize);
+	UploadContext(const UploadContext&)            = delete;
+	UploadContext(UploadContext&&) noexcept        = delete;
+	UploadContext& operator=(const UploadContext&) = delete;
+	UploadContext& operator=(UploadContext&&)      = delete;
+	~UploadContext() noexcept;
+
+	UploadId UploadBuffer(const BufferUploadInfo& uploadInfo, UploadWriter writer);
+	UploadId UploadImage(const ImageUploadInfo& uploadInfo, UploadWriter writer);
+	[[nodiscard]] constexpr bool IsUploadComplete(
+		const UploadId upload) const noexcept
+	{
+		return upload <= m_CompletedUpload;
+	}
+	[[nodiscard]] bool HasPendingUploads() const noexcept
+	{
+		return !m_Pending.empty();
+	}
+
+	// Graphics queue command buffer of the batch currently being recorded,
+	// begun lazily
+	[[nodiscard]] vk::CommandBuffer GetCommandBuffer();
+	// Ticket the batch currently being recorded will complete with
+	[[nodiscard]] constexpr UploadTicket GetRecordingTicket() const noexcept
+	{
+		return m_NextTicket;
+	}
+	// Executed once the batch currently being recorded has finished on the GPU,
+	// meant for releasing resources the recorded commands still use
+	void DeferUntilComplete(std::function<void()> callback);
+
+	// Records as many pending chunks as the staging ring has room for, then
+	// submits the batch. Does nothing if nothing has been recorded
+	UploadTicket Submit();
+
+	[[nodiscard]] constexpr bool IsComplete(
+		const UploadTicket ticket) const noexcept
+	{
+		return ticket <= m_CompletedTicket;
+	}
+	// Polls the in-flight fences, recycles finished batches, reclaims their
+	// staging space and runs their deferred callbacks, never blocks
+	void CollectCompleted();
+	void Wait(UploadTicket ticket);
+	void WaitIdle();
+	// Blocks until every upload made so far, including the ones still waiting
+	// for staging space, has finished
+	void Flush();
+
+private:
+	struct Batch
+	{
+		vk::CommandBuffer CommandBuffer;
+		vk::Fence Fence;
+		// Only with a dedicated transfer queue, the graphics submission waits
+		// for the semaphore its submission signals
+		vk::CommandBuffer TransferCommandBuffer;
+		vk::Semaphore TransferDone;
+		bool TransferRecording{ false };
+		// Stages of the ownership acquires recorded on the graphics queue
+		vk::PipelineStageFlags AcquireStages;
+		UploadTicket Ticket{};
+		// Newest upload whose last chunk is part of this batch
+		UploadId FinishedUpload{};
+		vk::DeviceSize StagedBytes{};
+		std::vector<std::function<void()>> Callbacks;
+		GpuProfileRange ProfileRange;
+	};
+
+	struct PendingUpload
+	{
+		UploadId Id{};
+		std::optional<BufferUploadInfo> Buffer;
+		std::optional<ImageUploadInfo> Image;
+		UploadWriter Writer;
+		// Bytes for buffers, block rows of the current level for images
+		vk::DeviceSize Progress{};
+		std::uint32_t Level{};
+		// Source bytes of the levels already uploaded
+		vk::DeviceSize LevelOffset{};
+	};
+
+	void RecordPendingUploads();
+	[[nodiscard]] bool RecordBufferChunk(PendingUpload& upload);
+	[[nodiscard]] bool RecordImageChunk(PendingUpload& upload);
+	[[nodiscard]] vk::DeviceSize GetBatchBudget() const noexcept;
+	[[nodiscard]] vk::CommandBuffer GetTransferCommandBuffer();
+	[[nodiscard]] constexpr bool HasTransferQueue() const noexcept
+	{
+		return m_TransferQueueFamily != m_QueueFamily;
+	}
+	void Retire(Batch& batch);
+
+	vk::Device m_Device;
+	vk::Queue m_Queue;
+	std::uint32_t m_QueueFamily;
+	vk::Queue m_TransferQueue;
+	std::uint32_t m_TransferQueueFamily;
+	vk::CommandPool m_CommandPool;
+	// Null without a dedicated transfer queue
+	vk::CommandPool m_TransferCommandPool;
+	StagingRing m_StagingRing;
+	// Optional, times the copies of every batch
+	GpuProfiler* m_Profiler;
+
+	std::optional<Batch> m_Recording;
+	std::deque<Batch> m_InFlight;
+	std::vector<Batch> m_FreeBatches;
+
+	std::deque<PendingUpload> m_Pending;
+
+	UploadTicket m_NextTicket{ 1U };
+	UploadTicket m_CompletedTicket{ 0U };
+	UploadId m_NextUpload{ 1U };
+	UploadId m_CompletedUpload{ 0U };
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+// Scales the scene up to the target with a bilinear filtered fullscreen
+// triangle. The scene is drawn into the top left corner of a full size image,
+// so changing its resolution doesn't recreate anything
+class [[nodiscard]] UpscalePass
+{
+public:
+	// Leaves the target's images in finalLayout, without a render pass with
+	// dynamicRendering
+	UpscalePass(vk::Device device,
+	            DeviceMemoryAllocator& allocator,
+	            vk::PipelineCache pipelineCache,
+	            vk::ShaderModule vertexShader,
+	            vk::ShaderModule fragmentShader,
+	            vk::Format colorFormat,
+	            vk::ImageLayout finalLayout,
+	            bool dynamicRendering);
+	UpscalePass(const UpscalePass&)            = delete;
+	UpscalePass(UpscalePass&&) noexcept        = delete;
+	UpscalePass& operator=(const UpscalePass&) = delete;
+	UpscalePass& operator=(UpscalePass&&)      = delete;
+	~UpscalePass() noexcept;
+
+	// One scene image per target image, recreated with the swap chain
+	void CreateImages(vk::Extent2D extent,
+	                  std::span<const vk::ImageView> targetViews);
+	void DestroyImages() noexcept;
+
+	// Rendered into in ColorAttachmentOptimal, and expected to be left in
+	// ShaderReadOnlyOptimal
+	[[nodiscard]] vk::Image GetSceneImage(std::uint32_t idx) const
+	{
+		return m_SceneImages.at(idx).Image;
+	}
+	[[nodiscard]] vk::ImageView GetSceneView(std::uint32_t idx) const
+	{
+		return m_SceneImages.at(idx).View;
+	}
+
+	// With other shaders, thread safe. The result is swapped in by SwapPipeline
+	[[nodiscard]] vk::Pipeline BuildPipeline(vk::PipelineCache pipelineCache,
+	                                         vk::ShaderModule vertexShader,
+	                                         vk::ShaderModule fragmentShader) const;
+	// Returns the previous pipeline, which frames in flight may still use
+	[[nodiscard]] vk::Pipeline SwapPipeline(vk::Pipeline pipeline) noexcept;
+
+	// Outside of any render pass, sceneExtent is the part of the scene image
+	// that was rendered to
+	void Record(vk::CommandBuffer commandBuffer,
+	            std::uint32_t idx,
+	            vk::Image targetImage,
+	            vk::ImageView targetView,
+	            vk::Extent2D sceneExtent) const;
+
+private:
+	struct SceneImage
+	{
+		vk::Image Image;
+		DeviceAllocation Allocation;
+		vk::ImageView View;
+		vk::DescriptorSet DescriptorSet;
+		// Only without dynamic rendering
+		vk::Framebuffer Framebuffer;
+	};
+
+	void CreateRenderPass();
+
+	vk::Device m_Device;
+	DeviceMemoryAllocator* m_Allocator;
+	vk::Format m_ColorFormat;
+	vk::ImageLayout m_FinalLayout;
+	bool m_DynamicRendering;
+
+	vk::Sampler m_Sampler;
+	vk::DescriptorSetLayout m_DescriptorSetLayout;
+	vk::PipelineColorBlendStateCreateInfo m_ColorBlendState;
+	vk::PipelineLayout m_PipelineLayout;
+	vk::RenderPass m_RenderPass;
+	vk::Pipeline m_Pipeline;
+
+	vk::Extent2D m_Extent{};
+	vk::DescriptorPool m_DescriptorPool;
+	std::vector<SceneImage> m_SceneImages;
+};
@@ -1,59 +1,213 @@
 #pragma once
+#include <QFloat16>
+#include <QGenericMatrix>
 #include <QVector2D>
 #include <QVector3D>
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 
 #include <vulkan/vulkan.hpp>
 
-struct Vertex
+// Shader locations are shared by all the layouts, attributes a layout doesn't
+// have simply aren't declared by the matching shader variant
+enum class VertexLocation : std::uint32_t
+{
+	Position          = 0U,
+	Color             = 1U,
+	TextureCoordinate = 2U,
+	// A matrix takes up one location per column, 3 to 6
+	InstanceTransform = 3U,
+};
+
+struct VertexAttribute
+{
+	VertexLocation Location{};
+	vk::Format Format{};
+	std::uint32_t Offset{};
+};
+
+// Vertex input state of a layout, generated from its attribute list
+template <typename Layout>
+[[nodiscard]] consteval vk::VertexInputBindingDescription
+GetBindingDescription() noexcept
+{
+	constexpr vk::VertexInputBindingDescription BindingDescription{
+		.binding   = Layout::Binding,
+		.stride    = sizeof(Layout),
+		.inputRate = Layout::InputRate,
+	};
+
+	return BindingDescription;
+}
+
+template <typename Layout>
+[[nodiscard]] consteval auto GetAttributeDescriptions() noexcept
+{
+	constexpr std::array Attributes = Layout::GetAttributes();
+
+	std::array<vk::VertexInputAttributeDescription, Attributes.size()>
+		attributeDescriptions{};
+	constexpr auto ToDescription = [](const VertexAttribute& attribute) {
+		return vk::VertexInputAttributeDescription{
+			.location = static_cast<std::uint32_t>(attribute.Location),
+			.binding  = Layout::Binding,
+			.format   = attribute.Format,
+			.offset   = attribute.Offset,
+		};
+	};
+	std::ranges::transform(Attributes, attributeDescriptions.begin(),
+	                       ToDescription);
+
+	return attributeDescriptions;
+}
+
+// 32 bytes per vertex
+struct FullPrecisionVertex
 {
 	QVector3D Position;
 	QVector3D Color;
 	QVector2D TextureCoordinate;
 
+	constexpr static std::uint32_t Binding         = 0U;
+	constexpr static vk::VertexInputRate InputRate = vk::VertexInputRate::eVertex;
+
 	static_assert(sizeof(QVector2D) == sizeof(std::array<float, 2>));
 	static_assert(sizeof(QVector3D) == sizeof(std::array<float, 3>));
 
-	[[nodiscard]] consteval static vk::VertexInputBindingDescription
-	GetBindingDescription() noexcept
+	[[nodiscard]] static FullPrecisionVertex Create(
+		const QVector3D& position,
+		const QVector2D& textureCoordinate)
+	{
+		return FullPrecisionVertex{
+			.Position          = position,
+			.Color             = { 1.F, 1.F, 1.F },
+			.TextureCoordinate = textureCoordinate,
+		};
+	}
+
+	[[nodiscard]] QVector3D GetPosition() const noexcept
+	{
+		return Position;
+	}
+
+	[[nodiscard]] consteval static auto GetAttributes() noexcept
+	{
+		return std::array{
+			VertexAttribute{
+				.Location = VertexLocation::Position,
+				.Format   = vk::Format::eR32G32B32Sfloat,
+				.Offset   = offsetof(FullPrecisionVertex, Position),
+			},
+			VertexAttribute{
+				.Location = VertexLocation::Color,
+				.Format   = vk::Format::eR32G32B32Sfloat,
+				.Offset   = offsetof(FullPrecisionVertex, Color),
+			},
+			VertexAttribute{
+				.Location = VertexLocation::TextureCoordinate,
+				.Format   = vk::Format::eR32G32Sfloat,
+				.Offset   = offsetof(FullPrecisionVertex, TextureCoordinate),
+			},
+		};
+	}
+};
+
+// 12 bytes per vertex, half float positions and unorm16 texture coordinates.
+// Color was always white anyway and is left out, the shader variant built with
+// COMPACT_VERTEX substitutes it
+struct CompactVertex
+{
+	// 3 component 16 bit formats are barely supported as vertex input, the
+	// 4th component is padding
+	std::array<qfloat16, 4> Position;
+	std::array<std::uint16_t, 2> TextureCoordinate;
+
+	constexpr static std::uint32_t Binding         = 0U;
+	constexpr static vk::VertexInputRate InputRate = vk::VertexInputRate::eVertex;
+
+	[[nodiscard]] static CompactVertex Create(const QVector3D& position,
+	                                          const QVector2D& textureCoordinate)
 	{
-		constexpr vk::VertexInputBindingDescription BindingDescription{
-			.binding   = 0U,
-			.stride    = sizeof(Vertex),
-			.inputRate = vk::VertexInputRate::eVertex
+		constexpr auto ToUnorm16 = [](const float value) {
+			constexpr float Scale = std::numeric_limits<std::uint16_t>::max();
+			return static_cast<std::uint16_t>(
+				std::lround(std::clamp(value, 0.F, 1.F) * Scale));
+		};
+
+		return CompactVertex{
+			.Position          = { qfloat16{ position.x() },
+			                       qfloat16{ position.y() },
+			                       qfloat16{ position.z() },
+			                       qfloat16{ 1.F } },
+			.TextureCoordinate = { ToUnorm16(textureCoordinate.x()),
+			                       ToUnorm16(textureCoordinate.y()) },
 		};
+	}
 
-		return BindingDescription;
+	[[nodiscard]] QVector3D GetPosition() const noexcept
+	{
+		return QVector3D{ static_cast<float>(Position[0]),
+			              static_cast<float>(Position[1]),
+			              static_cast<float>(Position[2]) };
 	}
 
-	[[nodiscard]] consteval static auto GetAttributeDescriptions() noexcept
+	[[nodiscard]] consteval static auto GetAttributes() noexcept
 	{
-		constexpr std::array<vk::VertexInputAttributeDescription, 3>
-			AttributeDescriptions{
-			    // Position description
-				vk::VertexInputAttributeDescription{
-					.location = 0,
-					.binding  = 0,
-					.format   = vk::Format::eR32G32B32Sfloat,
-					.offset   = offsetof(Vertex, Position),
-				},
-			    // Color description
-			    vk::VertexInputAttributeDescription{
-					.location = 1,
-					.binding  = 0,
-					.format   = vk::Format::eR32G32B32Sfloat,
-					.offset   = offsetof(Vertex, Color),
-				},
-			    // Texture description
-			    vk::VertexInputAttributeDescription{
-					.location = 2,
-					.binding  = 0,
-					.format   = vk::Format::eR32G32Sfloat,
-					.offset   = offsetof(Vertex, TextureCoordinate),
-				},
-		    };
-
-		return AttributeDescriptions;
+		return std::array{
+			VertexAttribute{
+				.Location = VertexLocation::Position,
+				.Format   = vk::Format::eR16G16B16A16Sfloat,
+				.Offset   = offsetof(CompactVertex, Position),
+			},
+			VertexAttribute{
+				.Location = VertexLocation::TextureCoordinate,
+				.Format   = vk::Format::eR16G16Unorm,
+				.Offset   = offsetof(CompactVertex, TextureCoordinate),
+			},
+		};
 	}
 };
+static_assert(sizeof(CompactVertex) == 12U);
+
+// Per instance data, streamed from the second binding
+struct InstanceData
+{
+	// Column major, same as the matrices in the uniform buffer
+	QGenericMatrix<4, 4, float> Transform;
+
+	static_assert(sizeof(QGenericMatrix<4, 4, float>) ==
+	              sizeof(std::array<float, 16>));
+
+	constexpr static std::uint32_t Binding         = 1U;
+	constexpr static vk::VertexInputRate InputRate = vk::VertexInputRate::eInstance;
+
+	[[nodiscard]] consteval static auto GetAttributes() noexcept
+	{
+		constexpr auto TransformOffset =
+			static_cast<std::uint32_t>(offsetof(InstanceData, Transform));
+		constexpr std::uint32_t ColumnSize = sizeof(std::array<float, 4>);
+		constexpr auto FirstLocation =
+			static_cast<std::uint32_t>(VertexLocation::InstanceTransform);
+		constexpr auto Column = [](const std::uint32_t column) {
+			return VertexAttribute{
+				.Location = static_cast<VertexLocation>(FirstLocation + column),
+				.Format = vk::Format::eR32G32B32A32Sfloat,
+				.Offset = TransformOffset + column * ColumnSize,
+			};
+		};
+
+		return std::array{ Column(0U), Column(1U), Column(2U), Column(3U) };
+	}
+};
+
+// Must match the shader variant, see VULKAN_TUTORIAL_COMPACT_VERTICES
+#ifdef VULKAN_TUTORIAL_COMPACT_VERTICES
+using Vertex = CompactVertex;
+#else
+using Vertex = FullPrecisionVertex;
+#endif
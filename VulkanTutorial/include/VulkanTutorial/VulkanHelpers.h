@@ -1,6 +1,10 @@
 #pragma once
 
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+
 #include <cstdint>
+#include <optional>
+#include <span>
 
 #include <vulkan/vulkan.hpp>
 
@@ -10,48 +14,113 @@
 [[nodiscard]] vk::RenderPass CreateRenderPass(vk::Device device,
                                               VkFormat colorFormat,
                                               VkFormat depthFormat,
-                                              std::uint32_t sampleCount);
+                                              std::uint32_t sampleCount,
+                                              vk::ImageLayout resolveLayout);
 
 [[nodiscard]] std::tuple<vk::PipelineColorBlendStateCreateInfo, vk::PipelineLayout>
-CreatePipelineLayoutInfo(vk::Device device,
-                         vk::DescriptorSetLayout descriptorSetLayout);
+CreatePipelineLayoutInfo(
+	vk::Device device,
+	vk::DescriptorSetLayout descriptorSetLayout,
+	std::span<const vk::PushConstantRange> pushConstantRanges = {});
 
 [[nodiscard]] std::uint32_t FindMemoryType(vk::PhysicalDevice physicalDevice,
                                            vk::MemoryPropertyFlags memoryProperties,
                                            std::uint32_t typeFilter);
 
-[[nodiscard]] std::tuple<vk::Buffer, vk::DeviceMemory> CreateDeviceBuffer(
+[[nodiscard]] std::tuple<vk::Buffer, DeviceAllocation> CreateDeviceBuffer(
     vk::DeviceSize bufferSize,
     vk::BufferUsageFlags bufferFlags,
     vk::MemoryPropertyFlags memoryFlags,
     vk::Device device,
-    vk::PhysicalDevice physicalDevie);
+    DeviceMemoryAllocator& allocator);
+
+[[nodiscard]] std::tuple<vk::Image, DeviceAllocation> CreateDeviceImage(
+    const vk::ImageCreateInfo& imageCreateInfo,
+    vk::MemoryPropertyFlags memoryFlags,
+    vk::Device device,
+    DeviceMemoryAllocator& allocator);
+
+// Highest of 16x, 8x and 4x that color and depth attachments both support,
+// 1x without any of them
+[[nodiscard]] vk::SampleCountFlagBits PickSampleCount(
+	vk::PhysicalDevice physicalDevice);
+// Always with a stencil aspect
+[[nodiscard]] vk::Format PickDepthStencilFormat(vk::PhysicalDevice physicalDevice);
+
+// First family with all the wanted and none of the excluded flags. Families
+// that can't do graphics run their work next to the graphics queue
+[[nodiscard]] std::optional<std::uint32_t> FindDedicatedQueueFamily(
+	std::span<const vk::QueueFamilyProperties> queueFamilies,
+	vk::QueueFlags wanted,
+	vk::QueueFlags excluded);
 
-void CopyBuffer(vk::Buffer dstBuffer,
+// Upload helpers only record into the given command buffer, submission and
+// synchronisation with the host is up to the UploadContext owning it
+
+void CopyBuffer(vk::CommandBuffer commandBuffer,
+                vk::Buffer dstBuffer,
                 vk::Buffer srcBuffer,
-                vk::DeviceSize size,
-                vk::CommandPool commandPool,
-                vk::Device device,
-                vk::Queue graphicsQueue);
+                vk::DeviceSize size);
 
-[[nodiscard]] vk::CommandBuffer BeginSingleTimeCommands(
-    vk::Device device,
-    vk::CommandPool commandPool);
+// Makes transfer writes to the buffer visible to the given consumer stages
+void BufferUploadBarrier(vk::CommandBuffer commandBuffer,
+                         vk::Buffer buffer,
+                         vk::PipelineStageFlags dstStage,
+                         vk::AccessFlags dstAccess);
+
+// Range of an exclusive buffer handed from the family that wrote it to the one
+// that reads it
+struct BufferOwnershipTransfer
+{
+	vk::Buffer Buffer;
+	vk::DeviceSize Offset{};
+	vk::DeviceSize Size{};
+	std::uint32_t SrcQueueFamily{};
+	std::uint32_t DstQueueFamily{};
+};
+
+// Recorded on the queue that copied into the range
+void ReleaseBufferOwnership(vk::CommandBuffer commandBuffer,
+                            const BufferOwnershipTransfer& transfer);
+// Recorded on the reading queue, whose submission has to wait for the release
+// with a semaphore at dstStage
+void AcquireBufferOwnership(vk::CommandBuffer commandBuffer,
+                            const BufferOwnershipTransfer& transfer,
+                            vk::PipelineStageFlags dstStage,
+                            vk::AccessFlags dstAccess);
+
+struct ImageLayoutBarrier
+{
+	vk::ImageMemoryBarrier Barrier;
+	vk::PipelineStageFlags SrcStage;
+	vk::PipelineStageFlags DstStage;
+};
+
+// Throws for transitions that aren't used anywhere
+[[nodiscard]] ImageLayoutBarrier MakeImageLayoutBarrier(
+	vk::Image image,
+	vk::ImageLayout oldLayout,
+	vk::ImageLayout newLayout,
+	std::uint32_t baseMipLevel = 0U,
+	std::uint32_t levelCount   = 1U);
+// Records all the transitions with a single barrier
+void TransitionImageLayouts(vk::CommandBuffer commandBuffer,
+                            std::span<const ImageLayoutBarrier> layoutBarriers);
 
-void EndSingleTimeCommands(vk::CommandBuffer commandBuffer, vk::Queue queue);
+// Extent of a mip level, never smaller than 1x1
+[[nodiscard]] vk::Extent2D GetMipExtent(vk::Extent2D extent,
+                                        std::uint32_t level) noexcept;
 
-void TransitionImageLayout(vk::Image image,
+void TransitionImageLayout(vk::CommandBuffer commandBuffer,
+                           vk::Image image,
                            vk::Format format,
                            vk::ImageLayout oldLayout,
                            vk::ImageLayout newLayout,
-                           vk::Device device,
-                           vk::CommandPool commandPool,
-                           vk::Queue workQueue);
+                           std::uint32_t baseMipLevel = 0U,
+                           std::uint32_t levelCount   = 1U);
 
-void CopyBufferToImage(vk::Buffer buffer,
+void CopyBufferToImage(vk::CommandBuffer commandBuffer,
+                       vk::Buffer buffer,
                        vk::Image image,
                        uint32_t width,
-                       uint32_t height,
-                       vk::Device device,
-                       vk::CommandPool commandPool,
-                       vk::Queue queue);
+                       uint32_t height);
@@ -2,7 +2,9 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <cstdint>
 #include <span>
+#include <string_view>
 
 class [[nodiscard]] VulkanInstance
 {
@@ -18,8 +20,20 @@ public:
 
 	void InitializeDebugMessenger();
 
+	// Index of the best device for the renderer, preferring discrete GPUs and
+	// then more video memory. deviceOverride picks one by index or by part of
+	// its name instead. Without a surface presentation isn't checked
+	[[nodiscard]] std::uint32_t SelectPhysicalDevice(
+		std::span<const char* const> deviceExtensions,
+		vk::SurfaceKHR vulkanSurface,
+		std::string_view deviceOverride = {}) const;
+
+	// Without a surface only a graphics queue is needed, for offscreen rendering.
+	// Dedicated transfer and compute queues are created when the device has them,
+	// and dynamic rendering is enabled when it is supported
 	void InitializeDevice(std::span<const char* const> deviceExtensions,
-						  vk::SurfaceKHR vulkanSurface);
+						  vk::SurfaceKHR vulkanSurface,
+						  std::string_view deviceOverride = {});
 
 	[[nodiscard]] constexpr vk::Instance GetVulkanInstance() const noexcept
 	{
@@ -47,6 +61,39 @@ public:
 		return m_WorkQueue;
 	}
 
+	[[nodiscard]] constexpr std::uint32_t GetWorkQueueFamily() const noexcept
+	{
+		return m_WorkQueueFamily;
+	}
+
+	// Same as the work queue when the device has no transfer only family
+	[[nodiscard]] constexpr vk::Queue GetTransferQueue() const noexcept
+	{
+		return m_TransferQueue;
+	}
+
+	[[nodiscard]] constexpr std::uint32_t GetTransferQueueFamily() const noexcept
+	{
+		return m_TransferQueueFamily;
+	}
+
+	// Same as the work queue when the device has no compute family without
+	// graphics
+	[[nodiscard]] constexpr vk::Queue GetComputeQueue() const noexcept
+	{
+		return m_ComputeQueue;
+	}
+
+	[[nodiscard]] constexpr std::uint32_t GetComputeQueueFamily() const noexcept
+	{
+		return m_ComputeQueueFamily;
+	}
+
+	[[nodiscard]] constexpr bool IsDynamicRenderingEnabled() const noexcept
+	{
+		return m_DynamicRendering;
+	}
+
 	[[nodiscard]] constexpr vk::CommandPool GetCommandPool() const noexcept {
 		return m_CommandPool;
 	}
@@ -59,5 +106,11 @@ private:
 	vk::PhysicalDevice m_PhyiscalDevice;
 	vk::Device m_Device;
 	vk::Queue m_WorkQueue;
+	std::uint32_t m_WorkQueueFamily{};
+	vk::Queue m_TransferQueue;
+	std::uint32_t m_TransferQueueFamily{};
+	vk::Queue m_ComputeQueue;
+	std::uint32_t m_ComputeQueueFamily{};
+	bool m_DynamicRendering{ false };
 	vk::CommandPool m_CommandPool;
 };
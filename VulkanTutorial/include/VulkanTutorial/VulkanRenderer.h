@@ -2,22 +2,67 @@
 
 #include <QVulkanWindowRenderer>
 
+#include <VulkanTutorial/DeviceMemoryAllocator.h>
+#include <VulkanTutorial/FramePacing.h>
+#include <VulkanTutorial/GpuProfiler.h>
+#include <VulkanTutorial/MipmapGenerator.h>
 #include <VulkanTutorial/ModelManager.h>
+#include <VulkanTutorial/OffscreenTarget.h>
+#include <VulkanTutorial/ParallelRecorder.h>
+#include <VulkanTutorial/PipelineCache.h>
+#include <VulkanTutorial/PipelineLibrary.h>
+#include <VulkanTutorial/QualityGovernor.h>
+#include <VulkanTutorial/RenderTarget.h>
+#include <VulkanTutorial/ShaderReloader.h>
+#include <VulkanTutorial/TextureCache.h>
+#include <VulkanTutorial/TextureLoader.h>
+#include <VulkanTutorial/TransientAttachments.h>
+#include <VulkanTutorial/UploadContext.h>
+#include <VulkanTutorial/UpscalePass.h>
+#include <VulkanTutorial/WindowTarget.h>
 
 #include <array>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include <vulkan/vulkan.hpp>
 
 class [[nodiscard]] VulkanRenderer final : public QVulkanWindowRenderer
 {
 public:
-	explicit VulkanRenderer(QVulkanWindow& window, bool msaa = false);
+	// With recordingThreads the draws are recorded into secondary command
+	// buffers on that many threads, unless culling on the GPU.
+	// deviceSetup is read once the window has created its device
+	explicit VulkanRenderer(QVulkanWindow& window,
+	                        const WindowDeviceSetup& deviceSetup,
+	                        bool msaa                      = false,
+	                        bool gpuCulling                = false,
+	                        std::uint32_t recordingThreads = 0U);
+	// Driven by calling startNextFrame after OffscreenTarget::BeginFrame, the
+	// animation advances by a fixed step per frame so captures are repeatable
+	explicit VulkanRenderer(OffscreenTarget& target,
+	                        bool gpuCulling                = false,
+	                        std::uint32_t recordingThreads = 0U);
 	VulkanRenderer(const VulkanRenderer&)                = delete;
 	VulkanRenderer(VulkanRenderer&&) noexcept            = delete;
 	VulkanRenderer& operator=(const VulkanRenderer&)     = delete;
 	VulkanRenderer& operator=(VulkanRenderer&&) noexcept = delete;
 	~VulkanRenderer() noexcept final                     = default;
 
+	// Milliseconds per frame the quality governor keeps the GPU within, by
+	// lowering the MSAA samples and then the resolution. Only before
+	// initResources
+	void SetFrameBudget(double frameBudget);
+	// Fewer frames in flight than the target has drain the queue before every
+	// frame, the target can't be asked for more
+	void SetFramePacing(const FramePacing& pacing);
+	// Recompiles the shaders when their sources change and swaps the rebuilt
+	// pipelines in between frames. Only before initResources
+	void EnableShaderHotReload();
+
 	void initResources() override;
 	void initSwapChainResources() override;
 	void releaseSwapChainResources() override;
@@ -28,25 +73,109 @@ private:
 	[[nodiscard]] vk::ShaderModule CreateShader(const QString& name) const;
 	void CreateDescriptorSetLayout();
 	void CreateUniformBuffers();
-	void UpdateUniformBuffer(int idx, QSize currentSize);
+	void UpdateUniformBuffer(std::uint32_t idx, vk::Extent2D currentSize);
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
 	void LoadTextures();
+	void UploadTexture(const std::shared_ptr<const TextureData>& texture);
 	void CreateTextureImageView();
 	void CreateTextureSampler();
+	// Single white texel, resident before the first frame
+	void CreateFallbackTexture();
+	// Points the frame's descriptor set at the texture once its upload is done
+	void BindUploadedTexture(std::uint32_t idx);
+	// Begins the render pass, or with dynamic rendering draws straight into the
+	// target's images, so nothing depends on the swap chain size
+	void BeginRendering(vk::CommandBuffer commandBuffer,
+	                    std::uint32_t imageIdx,
+	                    vk::Extent2D size,
+	                    vk::SubpassContents contents) const;
+	void EndRendering(vk::CommandBuffer commandBuffer,
+	                  std::uint32_t imageIdx) const;
+	// Requests a variant, and a render pass without dynamic rendering, for every
+	// sample count that can be used
+	void CreateGraphicsPipelines();
+	void DestroyGraphicsPipelines() noexcept;
+	[[nodiscard]] GraphicsPipelineState GetGraphicsPipelineState(
+		vk::SampleCountFlagBits samples,
+		vk::RenderPass renderPass) const;
+	// Switches to the variant of the current sample count
+	void UseGraphicsVariant();
+	// Old pipelines are destroyed once no frame in flight uses them
+	void SwapReloadedPipelines();
+	// The attachments, and the framebuffers without dynamic rendering
+	void CreateFramebuffers(vk::Extent2D size);
+	void DestroyFramebuffers() noexcept;
+	// Only a new sample count recreates anything, the old attachments are
+	// retired instead of waiting for the frames in flight
+	void ApplyQualityLevel(vk::Extent2D size);
+	// Those no frame in flight uses anymore, or all of them once the device idles
+	void DestroyRetiredAttachments(bool deviceIdle) noexcept;
+	// Part of the target the scene is drawn to, smaller with the governor
+	[[nodiscard]] vk::Extent2D GetRenderExtent(vk::Extent2D size) const;
+	// The upscale pass's image when there is one, otherwise the target's
+	[[nodiscard]] vk::Image GetSceneImage(std::uint32_t idx) const;
+	[[nodiscard]] vk::ImageView GetSceneView(std::uint32_t idx) const;
+	[[nodiscard]] vk::ImageLayout GetSceneLayout() const;
 
 private:
 	template <typename T>
 	using FrameArray = std::array<T, QVulkanWindow::MAX_CONCURRENT_FRAME_COUNT>;
 
-	QVulkanWindow* const m_Window{ nullptr };
+	// Only set when rendering into a window
+	std::optional<WindowTarget> m_WindowTarget;
+	RenderTarget* const m_Target{ nullptr };
 	// The value is constant for the entire lifetime of the
-	// QVulkanWindow, we can make it const
+	// target, we can make it const
 	const std::uint32_t m_ConcurrentFrameCount;
-	int m_SwapChainImageCount{};
+	// The headless renderer always multisamples, so captures match the window
+	const bool m_Msaa;
+	// Frustum culling and draw commands are generated by a compute pass
+	const bool m_GpuCulling;
+	const std::uint32_t m_RecordingThreads;
+	// Without a render pass or framebuffers. Only known once the device exists
+	bool m_DynamicRendering{ false };
+	// Seconds per frame, otherwise the animation follows the clock
+	const std::optional<float> m_FixedTimeStep;
+	std::uint64_t m_FrameNumber{ 0U };
+	std::uint32_t m_SwapChainImageCount{};
 
 	vk::Device m_Device;
 	vk::PhysicalDevice m_PhysicalDevice;
+	// Optional only to tie its lifetime to init/releaseResources
+	std::optional<DeviceMemoryAllocator> m_Allocator;
+	std::optional<UploadContext> m_UploadContext;
+	std::optional<PipelineCache> m_PipelineCache;
+	std::optional<PipelineLibrary> m_PipelineLibrary;
+	std::optional<MipmapGenerator> m_MipmapGenerator;
+	std::optional<TextureCache> m_TextureCache;
+	std::optional<TextureLoader> m_TextureLoader;
+	std::optional<GpuProfiler> m_GpuProfiler;
+	std::optional<ParallelRecorder> m_ParallelRecorder;
+	// Timestamps of each frame, read back when the frame comes around again
+	FrameArray<GpuProfileRange> m_ProfileRanges{};
+	std::optional<double> m_FrameBudget;
+	std::optional<QualityGovernor> m_QualityGovernor;
+	std::optional<UpscalePass> m_UpscalePass;
+	// Recording the previous frame took this many milliseconds
+	double m_LastCpuTime{ 0.0 };
+	std::optional<FrameLimiter> m_FrameLimiter;
+	// The previous frames have to finish before the next samples its input
+	bool m_DrainQueue{ false };
+	vk::SampleCountFlagBits m_SampleCount{ vk::SampleCountFlagBits::e1 };
+	vk::Format m_DepthStencilFormat{};
+	// Recreated with the swap chain, owned through a pointer so retired ones can
+	// outlive it
+	std::unique_ptr<TransientAttachments> m_Attachments;
+	struct GraphicsVariant
+	{
+		// Only without dynamic rendering
+		vk::RenderPass RenderPass;
+		PipelineLibrary::VariantId Id{};
+	};
+
+	std::map<vk::SampleCountFlagBits, GraphicsVariant> m_GraphicsVariants;
+	// Those of the current sample count
 	vk::RenderPass m_RenderPass;
 	vk::PipelineLayout m_PipelineLayout;
 	vk::Pipeline m_GraphicsPipeline;
@@ -54,21 +183,52 @@ private:
 
 	vk::DescriptorSetLayout m_DescriptorSetLayout;
 	FrameArray<vk::Buffer> m_UniformBuffers{};
-	FrameArray<vk::DeviceMemory> m_UniformDeviceMemory{};
+	FrameArray<DeviceAllocation> m_UniformAllocations{};
 	FrameArray<void*> m_UniformBuffersMappedMemory{};
+	// Frames whose camera uniforms still have to be rewritten
+	FrameArray<bool> m_StaleCameraFrames{};
+	vk::Extent2D m_CameraExtent{};
 
 	vk::DescriptorPool m_DescriptorPool;
 	FrameArray<vk::DescriptorSet> m_DescriptorSets{};
 
 	vk::Image m_TextureImage;
-	vk::DeviceMemory m_TextureImageMemory;
+	DeviceAllocation m_TextureImageAllocation;
+	vk::Format m_TextureFormat{};
+	std::uint32_t m_TextureMipLevels{ 1U };
+	UploadId m_TextureUpload{};
 	vk::ImageView m_TextureImageView;
 	vk::Sampler m_TextureSampler;
-
-	vk::Image m_DepthImage;
-	vk::DeviceMemory m_DepthImageMemory;
-	vk::ImageView m_DepthImageView;
+	// Sampled instead while the texture is still being uploaded
+	vk::Image m_FallbackImage;
+	DeviceAllocation m_FallbackImageAllocation;
+	vk::ImageView m_FallbackImageView;
+	// Frames whose descriptor set still points at the fallback
+	FrameArray<bool> m_FallbackFrames{};
 
 	ModelManager m_ModelManager;
 	std::vector<Model> m_Models;
+
+	struct RetiredPipeline
+	{
+		// Frame that last used it
+		std::uint64_t FrameNumber{};
+		vk::Pipeline Pipeline;
+	};
+
+	struct RetiredAttachments
+	{
+		// Frame that last used them
+		std::uint64_t FrameNumber{};
+		std::unique_ptr<TransientAttachments> Attachments;
+		FrameArray<vk::Framebuffer> Framebuffers{};
+	};
+
+	std::vector<RetiredAttachments> m_RetiredAttachments;
+
+	bool m_ShaderHotReload{ false };
+	std::optional<ShaderReloader> m_ShaderReloader;
+	// By the name they are watched under
+	std::map<std::string, PipelineLibrary::VariantId> m_ReloadableVariants;
+	std::vector<RetiredPipeline> m_RetiredPipelines;
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <VulkanTutorial/RenderTarget.h>
+
+#include <QVulkanWindow>
+
+#include <cstdint>
+#include <optional>
+
+// Filled in by the window while Qt creates its device, which only happens after
+// the renderer and its target have been created
+struct WindowDeviceSetup
+{
+	bool DynamicRendering{ false };
+	// Not set when the device has no transfer only family
+	std::optional<std::uint32_t> TransferQueueFamily;
+};
+
+// Renders into the swapchain of a QVulkanWindow, which owns the command
+// buffers and drives the frames
+class [[nodiscard]] WindowTarget final : public RenderTarget
+{
+public:
+	// deviceSetup has to outlive the target
+	WindowTarget(QVulkanWindow& window, const WindowDeviceSetup& deviceSetup);
+	WindowTarget(const WindowTarget&)                = delete;
+	WindowTarget(WindowTarget&&) noexcept            = delete;
+	WindowTarget& operator=(const WindowTarget&)     = delete;
+	WindowTarget& operator=(WindowTarget&&) noexcept = delete;
+	~WindowTarget() noexcept final                   = default;
+
+	[[nodiscard]] vk::Device GetDevice() const final;
+	[[nodiscard]] vk::PhysicalDevice GetPhysicalDevice() const final;
+	[[nodiscard]] vk::Queue GetGraphicsQueue() const final;
+	[[nodiscard]] std::uint32_t GetGraphicsQueueFamily() const final;
+	[[nodiscard]] std::uint32_t GetConcurrentFrameCount() const final;
+	[[nodiscard]] vk::Format GetColorFormat() const final;
+	[[nodiscard]] vk::ImageLayout GetFinalLayout() const final;
+	[[nodiscard]] bool IsDynamicRenderingEnabled() const final;
+	[[nodiscard]] vk::Queue GetTransferQueue() const final;
+	[[nodiscard]] std::uint32_t GetTransferQueueFamily() const final;
+
+	[[nodiscard]] vk::Extent2D GetExtent() const final;
+	[[nodiscard]] std::uint32_t GetImageCount() const final;
+	[[nodiscard]] vk::ImageView GetColorView(std::uint32_t idx) const final;
+	[[nodiscard]] vk::Image GetColorImage(std::uint32_t idx) const final;
+
+	[[nodiscard]] std::uint32_t GetCurrentFrame() const final;
+	[[nodiscard]] std::uint32_t GetCurrentImage() const final;
+	[[nodiscard]] vk::CommandBuffer GetCurrentCommandBuffer() const final;
+	void FrameReady() final;
+
+private:
+	QVulkanWindow* m_Window;
+	const WindowDeviceSetup* m_DeviceSetup;
+};
@@ -1,10 +1,25 @@
+#include <VulkanTutorial/CpuTrace.h>
+#include <VulkanTutorial/FramePacing.h>
 #include <VulkanTutorial/MainWindow.h>
+#include <VulkanTutorial/OffscreenTarget.h>
 #include <VulkanTutorial/VulkanInstance.h>
+#include <VulkanTutorial/VulkanRenderer.h>
 
 #include <QApplication>
 #include <QByteArray>
 #include <QByteArrayList>
 
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
 namespace
 {
 // NOLINTBEGIN(cert-err58-cpp)
@@ -28,8 +43,42 @@ const QByteArrayList VulkanExtensions{
 	VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
 #endif
 };
+
+// No surface, so it also runs without a display server
+const QByteArrayList HeadlessVulkanExtensions{
+	"VK_KHR_portability_enumeration",
+#ifndef NDEBUG
+	VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+#endif
+};
 // NOLINTEND(cert-err58-cpp)
 
+// QVulkanWindow enables it on the device it creates
+constexpr std::array<const char*, 1> WindowDeviceExtensions{
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+};
+
+constexpr std::string_view HeadlessOption = "--headless";
+constexpr std::string_view SizeOption     = "--size";
+constexpr std::string_view CaptureOption  = "--capture";
+constexpr std::string_view TraceOption    = "--trace";
+constexpr std::string_view ThreadsOption  = "--record-threads";
+constexpr std::string_view DeviceOption   = "--device";
+constexpr std::string_view BudgetOption   = "--frame-budget";
+constexpr std::string_view InFlightOption = "--frames-in-flight";
+constexpr std::string_view MaxFpsOption   = "--max-fps";
+constexpr std::string_view ReloadOption   = "--hot-reload";
+
+struct HeadlessOptions
+{
+	std::uint32_t FrameCount{ 600U };
+	vk::Extent2D Extent{ 800U, 800U };
+	// The last frame is saved here when set
+	std::string_view CapturePath{};
+	// Skips GPU culling and records the draws on this many threads when set
+	std::uint32_t RecordingThreads{ 0U };
+};
+
 // QByteArrayList can't be cast to a const char* :(
 // sizeof(QByteArray) == 24, we need conversions when passing to vulkan
 std::vector<const char*> ToVector(const QByteArrayList& list)
@@ -43,10 +92,257 @@ std::vector<const char*> ToVector(const QByteArrayList& list)
 
 	return outVector;
 }
+
+// Value of "--option=value", nothing for other arguments
+std::optional<std::string_view> GetOptionValue(const std::string_view argument,
+                                               const std::string_view option)
+{
+	if (!argument.starts_with(option) ||
+	    !argument.substr(option.size()).starts_with('='))
+	{
+		return std::nullopt;
+	}
+	return argument.substr(option.size() + 1U);
+}
+
+std::uint32_t ParseCount(const std::string_view text)
+{
+	std::uint32_t value{};
+	const char* const end = text.data() + text.size();
+	const auto [parsedEnd, error] = std::from_chars(text.data(), end, value);
+	if (error != std::errc{} || parsedEnd != end || value == 0U)
+	{
+		throw std::runtime_error{
+			fmt::format("Invalid argument value '{}'", text),
+		};
+	}
+	return value;
+}
+
+// Value of the last "--option=value" argument, empty without one
+std::string_view FindOptionValue(const std::span<char* const> arguments,
+                                 const std::string_view option)
+{
+	std::string_view value{};
+	for (const std::string_view argument : arguments.subspan(1U))
+	{
+		value = GetOptionValue(argument, option).value_or(value);
+	}
+	return value;
+}
+
+// --trace=file.json, in both modes
+std::filesystem::path ParseTracePath(const std::span<char* const> arguments)
+{
+	const std::filesystem::path tracePath{
+		FindOptionValue(arguments, TraceOption),
+	};
+#ifndef VULKAN_TUTORIAL_CPU_TRACE
+	if (!tracePath.empty())
+	{
+		fmt::println(stderr,
+		             "Built without VULKAN_TUTORIAL_CPU_TRACE, {} will be empty",
+		             tracePath.string());
+	}
+#endif
+	return tracePath;
+}
+
+// --frame-budget=milliseconds, in both modes
+std::optional<double> ParseFrameBudget(const std::span<char* const> arguments)
+{
+	const std::string_view text = FindOptionValue(arguments, BudgetOption);
+	if (text.empty())
+	{
+		return std::nullopt;
+	}
+	double frameBudget{};
+	const char* const end = text.data() + text.size();
+	const auto [parsedEnd, error] = std::from_chars(text.data(), end, frameBudget);
+	if (error != std::errc{} || parsedEnd != end || !(frameBudget > 0.0))
+	{
+		throw std::runtime_error{
+			fmt::format("Invalid frame budget '{}'", text),
+		};
+	}
+	return frameBudget;
+}
+
+// [--frames-in-flight=N] [--max-fps=N], in both modes
+FramePacing ParseFramePacing(const std::span<char* const> arguments)
+{
+	FramePacing pacing{};
+	if (const std::string_view frames = FindOptionValue(arguments, InFlightOption);
+	    !frames.empty())
+	{
+		pacing.FramesInFlight = ParseCount(frames);
+	}
+	if (const std::string_view rate = FindOptionValue(arguments, MaxFpsOption);
+	    !rate.empty())
+	{
+		pacing.FrameRateLimit = ParseCount(rate);
+	}
+	return pacing;
+}
+
+// --hot-reload, only in the window
+bool ParseShaderHotReload(const std::span<char* const> arguments)
+{
+	const bool hotReload = std::ranges::any_of(
+		arguments.subspan(1U),
+		[](const std::string_view argument) { return argument == ReloadOption; });
+#ifndef VULKAN_TUTORIAL_SHADER_HOT_RELOAD
+	if (hotReload)
+	{
+		fmt::println(stderr, "Built without VULKAN_TUTORIAL_SHADER_HOT_RELOAD, "
+		                     "shaders won't be reloaded");
+	}
+	return false;
+#else
+	return hotReload;
+#endif
+}
+
+void WriteTrace(const std::filesystem::path& tracePath)
+{
+	if (tracePath.empty())
+	{
+		return;
+	}
+	try
+	{
+		CpuTrace::WriteChromeTrace(tracePath);
+		fmt::println("CPU trace written to {}", tracePath.string());
+	}
+	catch (const std::exception& e)
+	{
+		fmt::println(stderr, "Failed to write CPU trace: {}", e.what());
+	}
+}
+
+// --headless[=frames] [--size=WIDTHxHEIGHT] [--capture=file.png]
+// [--record-threads=N]
+HeadlessOptions ParseHeadlessOptions(const std::span<char* const> arguments)
+{
+	HeadlessOptions options{};
+	for (const std::string_view argument : arguments.subspan(1U))
+	{
+		if (const auto frames = GetOptionValue(argument, HeadlessOption))
+		{
+			options.FrameCount = ParseCount(*frames);
+		}
+		else if (const auto size = GetOptionValue(argument, SizeOption))
+		{
+			const std::size_t separator = size->find('x');
+			if (separator == std::string_view::npos)
+			{
+				throw std::runtime_error{ "Size has to be given as WIDTHxHEIGHT" };
+			}
+			options.Extent = vk::Extent2D{
+				.width  = ParseCount(size->substr(0U, separator)),
+				.height = ParseCount(size->substr(separator + 1U)),
+			};
+		}
+		else if (const auto path = GetOptionValue(argument, CaptureOption))
+		{
+			options.CapturePath = *path;
+		}
+		else if (const auto threads = GetOptionValue(argument, ThreadsOption))
+		{
+			options.RecordingThreads = ParseCount(*threads);
+		}
+	}
+	return options;
+}
+
+// Renders a fixed number of frames into offscreen images as fast as possible,
+// for benchmarks and regression captures on machines without a display
+int RunHeadless(const HeadlessOptions& options,
+                const std::string_view deviceOverride,
+                const std::optional<double> frameBudget,
+                const FramePacing& pacing)
+{
+	VulkanInstance vulkan{ ToVector(VulkanLayers),
+		                   ToVector(HeadlessVulkanExtensions) };
+#ifndef NDEBUG
+	vulkan.InitializeDebugMessenger();
+#endif
+	vulkan.InitializeDevice({}, vk::SurfaceKHR{}, deviceOverride);
+
+	const bool gpuCulling = options.RecordingThreads == 0U;
+	// Headless frames are never waited for by a display, only the GPU
+	OffscreenTarget target{ vulkan, options.Extent,
+		                    pacing.FramesInFlight > 0U
+		                        ? pacing.FramesInFlight
+		                        : OffscreenTarget::DefaultFrameCount };
+	VulkanRenderer renderer{ target, gpuCulling, options.RecordingThreads };
+	if (frameBudget.has_value())
+	{
+		renderer.SetFrameBudget(*frameBudget);
+	}
+	renderer.SetFramePacing(pacing);
+	renderer.initResources();
+	renderer.initSwapChainResources();
+
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+	for (std::uint32_t frame{ 0U }; frame < options.FrameCount; ++frame)
+	{
+		target.BeginFrame();
+		renderer.startNextFrame();
+	}
+	target.WaitIdle();
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	fmt::println("Rendered {} frames of {}x{} in {:.3f}s, {:.1f} frames per second",
+	             options.FrameCount, options.Extent.width, options.Extent.height,
+	             elapsed.count(), options.FrameCount / elapsed.count());
+
+	if (!options.CapturePath.empty())
+	{
+		const QString path = QString::fromUtf8(options.CapturePath);
+		if (!target.Capture().save(path))
+		{
+			throw std::runtime_error{ fmt::format("Failed to save capture to {}",
+			                                      options.CapturePath) };
+		}
+	}
+
+	renderer.releaseSwapChainResources();
+	renderer.releaseResources();
+	return 0;
+}
 } // namespace
 
 int main(int argc, char** argv)
 {
+	const std::span<char* const> arguments{ argv, static_cast<std::size_t>(argc) };
+	const bool headless =
+		std::ranges::any_of(arguments, [](const std::string_view argument) {
+			return argument == HeadlessOption ||
+			       GetOptionValue(argument, HeadlessOption).has_value();
+		});
+	const std::filesystem::path tracePath = ParseTracePath(arguments);
+	// --device=index or --device=name, in both modes
+	const std::string_view deviceOverride =
+		FindOptionValue(arguments, DeviceOption);
+	CPU_TRACE_THREAD_NAME("Main");
+	if (headless)
+	{
+		int headlessReturnCode = -1;
+		try
+		{
+			headlessReturnCode = RunHeadless(
+				ParseHeadlessOptions(arguments), deviceOverride,
+				ParseFrameBudget(arguments), ParseFramePacing(arguments));
+		}
+		catch (const std::exception& e)
+		{
+			fmt::println(stderr, "Fatal error: {}", e.what());
+		}
+		WriteTrace(tracePath);
+		return headlessReturnCode;
+	}
+
 	const QGuiApplication app{ argc, argv };
 	QVulkanInstance qtVulkanInstance{};
 
@@ -76,12 +372,34 @@ int main(int argc, char** argv)
 			<< "Failed to create Vulkan instance:" << qtVulkanInstance.errorCode();
 		return -1;
 	}
-	const int returnCode = [&qtVulkanInstance] {
+	const int returnCode = [&qtVulkanInstance, &vulkanInstance, &tracePath,
+	                        &arguments, deviceOverride] {
 		try
 		{
 			constexpr QSize StartingWindowSize{ 800, 800 };
 			MainWindow window{};
 			window.setVulkanInstance(&qtVulkanInstance);
+			// Both enumerate the devices of the same instance in the same order.
+			// The surface exists once the platform window does, so only devices
+			// that can present to it are picked. Qt creates its device later,
+			// when the window is first exposed
+			if (vulkanInstance.has_value())
+			{
+				window.create();
+				const vk::SurfaceKHR surface{ QVulkanInstance::surfaceForWindow(
+					&window) };
+				if (!surface)
+				{
+					throw std::runtime_error{ "The window has no surface" };
+				}
+				window.setPhysicalDeviceIndex(
+					static_cast<int>(vulkanInstance->SelectPhysicalDevice(
+						WindowDeviceExtensions, surface, deviceOverride)));
+			}
+			window.SetTracePath(tracePath);
+			window.SetFrameBudget(ParseFrameBudget(arguments));
+			window.SetFramePacing(ParseFramePacing(arguments));
+			window.SetShaderHotReload(ParseShaderHotReload(arguments));
 			window.resize(StartingWindowSize);
 			window.show();
 			window.setVisibility(QWindow::Visibility::Windowed);
@@ -105,5 +423,7 @@ int main(int argc, char** argv)
 	// QVulkanInstance doesn't destroy VulkanInstance it does not own
 	vulkanInstance.reset();
 
+	WriteTrace(tracePath);
+
 	return returnCode;
 }